@@ -0,0 +1,120 @@
+/**
+ * @file bitset.h
+ * @author dromniscience (you@domain.com)
+ * @brief Kernels on blocks and arrays of bits
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief A 256-bit block split into eight 32-bit words
+ *
+ * @details A flowkey sets or tests one bit in each of the first `k` words, the
+ * `i`-th of which is picked by the top 5 bits of `h * SplitBlockSalt[i]`. All
+ * `k` bits are thus derived from a single 32-bit hashed value `h`, and fall
+ * into a single cache line if the block is aligned.
+ *
+ * @see J. Putze, P. Sanders, J. Singler, Cache-, Hash- and Space-Efficient
+ * Bloom Filters, WEA 2007.
+ */
+struct alignas(32) SplitBlock {
+  /// # words in a block, thus the most bits a flowkey may take
+  static constexpr int32_t words = 8;
+  uint32_t word[words];
+};
+
+/**
+ * @brief Odd multipliers picking a bit in each word of a SplitBlock
+ *
+ */
+inline constexpr uint32_t SplitBlockSalt[SplitBlock::words] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+/**
+ * @brief Set the `k` bits that `h` picks in a block
+ *
+ * @details Bits are set by AVX2 if the CPU supports it, and one by one
+ * otherwise.
+ *
+ * @param block the block
+ * @param h     hashed value of a flowkey
+ * @param k     # bits to set, in `[1, 8]`
+ */
+void SplitBlockSet(SplitBlock &block, uint32_t h, int32_t k);
+
+/**
+ * @brief Whether all the `k` bits that `h` picks in a block are set
+ *
+ * @details Bits are tested by a single AVX2 comparison of the whole block if
+ * the CPU supports it, and one by one otherwise.
+ *
+ * @param block the block
+ * @param h     hashed value of a flowkey
+ * @param k     # bits to test, in `[1, 8]`
+ */
+bool SplitBlockTest(const SplitBlock &block, uint32_t h, int32_t k);
+
+/**
+ * @brief `dst[i] |= src[i]` for `i` in `[0, n)`
+ *
+ * @details Words are combined by AVX2 if the CPU supports it, and one by one
+ * otherwise.
+ *
+ * @param dst words to be combined into
+ * @param src words to combine
+ * @param n   number of words
+ */
+void BitwiseOr(uint64_t *dst, const uint64_t *src, size_t n);
+
+/**
+ * @brief `dst[i] &= src[i]` for `i` in `[0, n)`
+ *
+ * @details Words are combined by AVX2 if the CPU supports it, and one by one
+ * otherwise.
+ *
+ * @param dst words to be combined into
+ * @param src words to combine
+ * @param n   number of words
+ */
+void BitwiseAnd(uint64_t *dst, const uint64_t *src, size_t n);
+
+/**
+ * @brief # bits set in `src[0]`, ..., `src[n - 1]`
+ *
+ * @details Bits are counted by AVX2 nibble look-ups if the CPU supports it,
+ * and word by word otherwise.
+ *
+ * @see W. Muła, N. Kurz, D. Lemire, Faster Population Counts Using AVX2
+ * Instructions, The Computer Journal, 2018.
+ */
+size_t PopCount(const uint64_t *src, size_t n);
+
+/**
+ * @brief Bytes of padding that should follow an array of packed nibbles
+ *
+ */
+inline constexpr size_t NibblePadding = 3;
+
+/**
+ * @brief Whether none of the `k` nibbles at `idx` in a packed array is zero
+ *
+ * @details Nibble `i` is the low half of byte `i / 2` if `i` is even, and the
+ * high half otherwise. If the CPU supports AVX2 and there are at least 6
+ * nibbles, they are gathered 8 at a time and compared against zero at once.
+ * Otherwise they are read one by one, still with no branch on their values.
+ *
+ * @param arr packed nibbles, followed by NibblePadding bytes, as the gather
+ * reads 32 bits from the byte of each nibble
+ * @param idx indices of nibbles, which may repeat
+ * @param k   # nibbles
+ */
+bool NibbleAllNonZero(const uint8_t *arr, const int32_t *idx, int32_t k);
+
+} // namespace OmniSketch::Sketch
@@ -0,0 +1,563 @@
+/**
+ * @file counter.h
+ * @author dromniscience (you@domain.com)
+ * @brief Arrays of narrow saturating counters and of atomic counters
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include "snapshot.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief Minimum of `base[pos[0]]`, ..., `base[pos[n - 1]]`
+ *
+ * @details Counters are fetched by AVX2 gathers if the CPU supports them, and
+ * one by one otherwise. For 8-bit and 16-bit counters, a gather reads 32 bits
+ * from where a counter starts, so up to 3 bytes past the last counter of
+ * `base` should be readable.
+ *
+ * @param base  counters
+ * @param pos   positions of counters
+ * @param n     number of positions, should be positive
+ */
+uint8_t GatherMin(const uint8_t *base, const int32_t *pos, int32_t n);
+/// @overload
+int8_t GatherMin(const int8_t *base, const int32_t *pos, int32_t n);
+/// @overload
+uint16_t GatherMin(const uint16_t *base, const int32_t *pos, int32_t n);
+/// @overload
+int16_t GatherMin(const int16_t *base, const int32_t *pos, int32_t n);
+/// @overload
+uint32_t GatherMin(const uint32_t *base, const int32_t *pos, int32_t n);
+/// @overload
+int32_t GatherMin(const int32_t *base, const int32_t *pos, int32_t n);
+
+/**
+ * @brief `dst[i] += src[i]` for `i` in `[0, n)`, saturating at the bounds of
+ * the type
+ *
+ * @details Counters are added by AVX2 if the CPU supports it, and one by one
+ * otherwise.
+ *
+ * @param dst counters to be added to
+ * @param src counters to add
+ * @param n   number of counters
+ */
+void SaturatingAdd(uint8_t *dst, const uint8_t *src, size_t n);
+/// @overload
+void SaturatingAdd(int8_t *dst, const int8_t *src, size_t n);
+/// @overload
+void SaturatingAdd(uint16_t *dst, const uint16_t *src, size_t n);
+/// @overload
+void SaturatingAdd(int16_t *dst, const int16_t *src, size_t n);
+/// @overload
+void SaturatingAdd(uint32_t *dst, const uint32_t *src, size_t n);
+/// @overload
+void SaturatingAdd(int32_t *dst, const int32_t *src, size_t n);
+
+/**
+ * @brief `dst[i] -= src[i]` for `i` in `[0, n)`, saturating at the bounds of
+ * the type
+ *
+ * @details Counters are subtracted by AVX2 if the CPU supports it, and one by
+ * one otherwise.
+ *
+ * @param dst counters to be subtracted from
+ * @param src counters to subtract
+ * @param n   number of counters
+ */
+void SaturatingSub(uint8_t *dst, const uint8_t *src, size_t n);
+/// @overload
+void SaturatingSub(int8_t *dst, const int8_t *src, size_t n);
+/// @overload
+void SaturatingSub(uint16_t *dst, const uint16_t *src, size_t n);
+/// @overload
+void SaturatingSub(int16_t *dst, const int16_t *src, size_t n);
+/// @overload
+void SaturatingSub(uint32_t *dst, const uint32_t *src, size_t n);
+/// @overload
+void SaturatingSub(int32_t *dst, const int32_t *src, size_t n);
+
+/**
+ * @brief Whether values of type `T` can be held in counters of `counter_t`
+ *
+ * @details Either `counter_t` is `T`, or it is an integer strictly narrower
+ * than `T` whose range lies in that of `T`. An unsigned `counter_t` may hold
+ * a signed `T`, saturating at zero, unless counters go below zero in the
+ * normal course, as those of Count Sketch do.
+ *
+ * @tparam T          type of values
+ * @tparam counter_t  type of counters
+ * @tparam turnstile  whether counters go below zero in the normal course, thus
+ * should be signed if `T` is
+ */
+template <typename T, typename counter_t, bool turnstile = false>
+constexpr bool IsValidCounter() {
+  if constexpr (std::is_same_v<T, counter_t>) {
+    return true;
+  } else {
+    return std::is_integral_v<T> && std::is_integral_v<counter_t> &&
+           sizeof(counter_t) < sizeof(T) &&
+           (std::is_signed_v<T> || std::is_unsigned_v<counter_t>) &&
+           (!turnstile || std::is_signed_v<T> == std::is_signed_v<counter_t>);
+  }
+}
+
+/**
+ * @brief A `depth * width` array of counters, possibly narrower than the
+ * values they hold
+ *
+ * @details If `counter_t` is `T`, this is a plain array. Otherwise counters
+ * saturate at the bounds of `counter_t`, so that a sketch may spend 1/2/4
+ * bytes per counter instead of `sizeof(T)` without wrapping around. With
+ * escalation enabled, whatever exceeds a saturated counter is kept in a side
+ * table of `T`, so no value is ever lost; only saturated counters pay for a
+ * look-up into it. Unsigned counters of a signed `T` saturate at zero as well,
+ * so the values below zero they are left with go to the side table too, at
+ * the cost of a look-up for every zero counter.
+ *
+ * @tparam T          type of values, i.e., the counter type of the sketch
+ * @tparam counter_t  type of counters actually stored
+ */
+template <typename T, typename counter_t = T> class CounterArray {
+  /// whether counters saturate
+  static constexpr bool narrow = !std::is_same_v<T, counter_t>;
+  static_assert(IsValidCounter<T, counter_t>(),
+                "counter_t should be an integer narrower than T");
+  /// whether GatherMin() applies
+  static constexpr bool gatherable =
+      std::is_integral_v<counter_t> && sizeof(counter_t) <= 4;
+  /// bounds of counters
+  static constexpr counter_t hi = std::numeric_limits<counter_t>::max();
+  static constexpr counter_t lo = std::numeric_limits<counter_t>::lowest();
+
+  /// counters of a gather may read past the end by this many
+  static constexpr int32_t pad =
+      gatherable ? static_cast<int32_t>(4 / sizeof(counter_t)) - 1 : 0;
+
+  const int32_t depth;
+  const int32_t width;
+  const bool escalate;
+  counter_t *counter;
+  /// value minus counter, for saturated counters only
+  std::unordered_map<int32_t, T> overflow;
+  /// keeps counters mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
+
+  CounterArray(const CounterArray &) = delete;
+  CounterArray(CounterArray &&) = delete;
+  CounterArray &operator=(CounterArray) = delete;
+
+  /**
+   * @brief Whether a counter sits at a bound, with possibly more to it in the
+   * side table
+   *
+   */
+  bool saturated(const counter_t c) const {
+    return c == hi ||
+           ((std::is_signed_v<counter_t> || std::is_signed_v<T>) && c == lo);
+  }
+  /**
+   * @brief Add or subtract another array counter by counter
+   * @details Arrays without side tables are combined by whole rows at a time.
+   *
+   */
+  template <bool add> void combine(const CounterArray &other) {
+    const size_t n = static_cast<size_t>(depth) * width;
+    if (escalate || other.escalate) {
+      for (int32_t i = 0; i < depth; ++i) {
+        for (int32_t j = 0; j < width; ++j) {
+          set(i, j, add ? get(i, j) + other.get(i, j)
+                        : get(i, j) - other.get(i, j));
+        }
+      }
+    } else if constexpr (narrow) {
+      if constexpr (add) {
+        SaturatingAdd(counter, other.counter, n);
+      } else {
+        SaturatingSub(counter, other.counter, n);
+      }
+    } else {
+      for (size_t i = 0; i < n; ++i) {
+        counter[i] = add ? counter[i] + other.counter[i]
+                         : counter[i] - other.counter[i];
+      }
+    }
+  }
+
+public:
+  /**
+   * @brief Construct a zero-initialized array
+   *
+   * @param depth     # rows
+   * @param width     # counters per row
+   * @param escalate  whether to keep what saturated counters cannot hold in a
+   * side table of `T`. Ignored if `counter_t` is `T`.
+   */
+  CounterArray(int32_t depth, int32_t width, bool escalate = false)
+      : depth(depth), width(width), escalate(narrow && escalate) {
+    counter = new counter_t[static_cast<size_t>(depth) * width + pad]();
+  }
+  /**
+   * @brief Load an array saved by save(), with counters used in place
+   *
+   * @param depth   # rows
+   * @param width   # counters per row
+   * @param reader  snapshot scoped to the array
+   */
+  CounterArray(int32_t depth, int32_t width, const SnapshotReader &reader)
+      : depth(depth), width(width),
+        escalate(narrow && reader.get<bool>("escalate")),
+        counter(reader.map<counter_t>(
+            "counter", static_cast<size_t>(depth) * width + pad)),
+        mapping(reader.handle()) {
+    const auto pos = reader.getVector<int32_t>("overflow_pos");
+    const auto val = reader.getVector<T>("overflow_val");
+    overflow.reserve(pos.size());
+    for (size_t i = 0; i < pos.size() && i < val.size(); ++i) {
+      overflow[pos[i]] = val[i];
+    }
+  }
+  /**
+   * @brief Release the pointer
+   *
+   */
+  ~CounterArray() {
+    if (!mapping)
+      delete[] counter;
+  }
+  /**
+   * @brief Value of a counter
+   *
+   */
+  T get(const int32_t row, const int32_t col) const {
+    const int32_t pos = row * width + col;
+    const counter_t c = counter[pos];
+    if constexpr (narrow) {
+      if (escalate && saturated(c)) {
+        auto iter = overflow.find(pos);
+        if (iter != overflow.end())
+          return static_cast<T>(c) + iter->second;
+      }
+    }
+    return c;
+  }
+  /**
+   * @brief Set a counter to a value, saturating if it does not fit
+   *
+   */
+  void set(const int32_t row, const int32_t col, const T val) {
+    const int32_t pos = row * width + col;
+    if constexpr (!narrow) {
+      counter[pos] = val;
+    } else {
+      const counter_t old = counter[pos];
+      const T clamped = std::clamp<T>(val, lo, hi);
+      counter[pos] = static_cast<counter_t>(clamped);
+      if (!escalate)
+        return;
+      if (val != clamped && saturated(static_cast<counter_t>(clamped))) {
+        overflow[pos] = val - clamped;
+      } else if (saturated(old)) {
+        overflow.erase(pos);
+      }
+    }
+  }
+  /**
+   * @brief Add a value to a counter, saturating if the sum does not fit
+   *
+   */
+  void add(const int32_t row, const int32_t col, const T val) {
+    if constexpr (!narrow) {
+      counter[row * width + col] += val;
+    } else {
+      set(row, col, get(row, col) + val);
+    }
+  }
+  /**
+   * @brief Prefetch a counter that is about to be written, or only read
+   * @details The side table is not prefetched, as few counters saturate.
+   *
+   */
+  void prefetch(const int32_t row, const int32_t col,
+                const bool write = true) const {
+    const counter_t *ptr = counter + row * width + col;
+    if (write)
+      __builtin_prefetch(ptr, 1);
+    else
+      __builtin_prefetch(ptr, 0);
+  }
+  /**
+   * @brief Minimum of the counters at `cols[i]` on row `i`, for all rows
+   *
+   */
+  T min(const int32_t *cols) const {
+    if constexpr (gatherable) {
+      int32_t pos[depth];
+      for (int32_t i = 0; i < depth; ++i) {
+        pos[i] = i * width + cols[i];
+      }
+      const counter_t min_cnt = GatherMin(counter, pos, depth);
+      // a saturated minimum may not be exact
+      if (!escalate || !saturated(min_cnt))
+        return min_cnt;
+    }
+    T min_val = std::numeric_limits<T>::max();
+    for (int32_t i = 0; i < depth; ++i) {
+      min_val = std::min(min_val, get(i, cols[i]));
+    }
+    return min_val;
+  }
+  /**
+   * @brief Add an array of the same shape to this one, counter by counter
+   * @details Narrow counters saturate as add() does.
+   *
+   */
+  void merge(const CounterArray &other) { combine<true>(other); }
+  /**
+   * @brief Subtract an array of the same shape from this one, counter by
+   * counter
+   * @details Narrow counters saturate as add() does.
+   *
+   */
+  void subtract(const CounterArray &other) { combine<false>(other); }
+  /**
+   * @brief Save the array, along with the side table
+   *
+   * @param writer  snapshot scoped to the array
+   */
+  void save(SnapshotWriter &writer) const {
+    writer.put("escalate", escalate);
+    // padding included, so that gathers never read past the mapping
+    writer.putBlob("counter", counter,
+                   sizeof(counter_t) *
+                       (static_cast<size_t>(depth) * width + pad));
+    std::vector<int32_t> pos;
+    std::vector<T> val;
+    for (const auto &[p, v] : overflow) {
+      pos.push_back(p);
+      val.push_back(v);
+    }
+    writer.putVector("overflow_pos", pos);
+    writer.putVector("overflow_val", val);
+  }
+  /**
+   * @brief Memory taken by counters and the side table
+   *
+   */
+  size_t size() const {
+    return sizeof(counter_t) * depth * width                  // counters
+           + (sizeof(int32_t) + sizeof(T)) * overflow.size(); // side table
+  }
+  /**
+   * @brief Reset all counters to zero
+   *
+   */
+  void clear() {
+    std::fill(counter, counter + static_cast<size_t>(depth) * width, 0);
+    overflow.clear();
+  }
+};
+
+/**
+ * @brief A `depth * width` array of atomic counters, shared by threads
+ *
+ * @details Counters are read and added with relaxed ordering: every addition
+ * is eventually seen by all threads, while reads running alongside additions
+ * may see any subset of them. Threads hammering a few hot counters may go
+ * through a Buffer instead, which combines additions to the same counter
+ * before they reach the array.
+ *
+ * @tparam T  type of counters
+ */
+template <typename T> class AtomicCounterArray {
+  const int32_t depth;
+  const int32_t width;
+  std::atomic<T> *counter;
+  /// keeps counters mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
+
+  AtomicCounterArray(const AtomicCounterArray &) = delete;
+  AtomicCounterArray(AtomicCounterArray &&) = delete;
+  AtomicCounterArray &operator=(AtomicCounterArray) = delete;
+
+public:
+  /**
+   * @brief A write-combining buffer private to a thread
+   *
+   * @details A direct-mapped table of pending additions, indexed by a hash of
+   * the counter position. Additions to a counter already pending are combined
+   * in place; otherwise the pending one in the slot is added to the array
+   * first. Whatever is pending reaches the array on flush() or destruction.
+   */
+  class Buffer {
+    /// a pending addition, with `pos < 0` meaning an empty slot
+    struct Slot {
+      int32_t pos;
+      T delta;
+    };
+    AtomicCounterArray &array;
+    int32_t shift;
+    std::vector<Slot> slot;
+
+    Buffer(const Buffer &) = delete;
+    Buffer(Buffer &&) = delete;
+    Buffer &operator=(Buffer) = delete;
+
+  public:
+    /**
+     * @brief Construct a buffer of an array
+     *
+     * @param array     array to flush to
+     * @param num_slot  # slots, rounded up to a power of 2
+     */
+    Buffer(AtomicCounterArray &array, int32_t num_slot) : array(array) {
+      int32_t bits = 0;
+      while (bits < 30 && (1 << bits) < num_slot)
+        ++bits;
+      shift = 32 - bits;
+      slot.assign(static_cast<size_t>(1) << bits, Slot{-1, 0});
+    }
+    /**
+     * @brief Flush and release the buffer
+     *
+     */
+    ~Buffer() { flush(); }
+    /**
+     * @brief Add a value to a counter, possibly later
+     *
+     */
+    void add(const int32_t row, const int32_t col, const T val) {
+      const int32_t pos = row * array.width + col;
+      // multiplicative hashing by 2^32 / phi; a 32-bit shift is reserved for
+      // a single slot
+      const uint32_t h = static_cast<uint32_t>(pos) * 0x9E3779B1u;
+      Slot &s = slot[shift == 32 ? 0 : h >> shift];
+      if (s.pos == pos) {
+        s.delta += val;
+        return;
+      }
+      if (s.pos >= 0)
+        array.counter[s.pos].fetch_add(s.delta, std::memory_order_relaxed);
+      s = Slot{pos, val};
+    }
+    /**
+     * @brief Add all pending values to the array
+     *
+     */
+    void flush() {
+      for (auto &s : slot) {
+        if (s.pos >= 0) {
+          array.counter[s.pos].fetch_add(s.delta, std::memory_order_relaxed);
+          s.pos = -1;
+        }
+      }
+    }
+  };
+
+  /**
+   * @brief Construct a zero-initialized array
+   *
+   * @param depth # rows
+   * @param width # counters per row
+   */
+  AtomicCounterArray(int32_t depth, int32_t width)
+      : depth(depth), width(width),
+        counter(new std::atomic<T>[static_cast<size_t>(depth) * width]) {
+    clear();
+  }
+  /**
+   * @brief Load an array saved by save(), with counters used in place
+   *
+   * @param depth   # rows
+   * @param width   # counters per row
+   * @param reader  snapshot scoped to the array
+   */
+  AtomicCounterArray(int32_t depth, int32_t width,
+                     const SnapshotReader &reader)
+      : depth(depth), width(width),
+        counter(reader.map<std::atomic<T>>(
+            "counter", static_cast<size_t>(depth) * width)),
+        mapping(reader.handle()) {
+    static_assert(sizeof(std::atomic<T>) == sizeof(T),
+                  "std::atomic<T> should be laid out as T");
+  }
+  /**
+   * @brief Release the pointer
+   *
+   */
+  ~AtomicCounterArray() {
+    if (!mapping)
+      delete[] counter;
+  }
+  /**
+   * @brief Value of a counter
+   *
+   */
+  T get(const int32_t row, const int32_t col) const {
+    return counter[row * width + col].load(std::memory_order_relaxed);
+  }
+  /**
+   * @brief Add a value to a counter at once
+   *
+   */
+  void add(const int32_t row, const int32_t col, const T val) {
+    counter[row * width + col].fetch_add(val, std::memory_order_relaxed);
+  }
+  /**
+   * @brief Set a counter to `desired` if it still holds `expected`
+   *
+   * @return whether the counter is set; if not, `expected` is loaded with
+   * what the counter holds instead
+   */
+  bool replace(const int32_t row, const int32_t col, T &expected,
+               const T desired) {
+    return counter[row * width + col].compare_exchange_strong(
+        expected, desired, std::memory_order_relaxed);
+  }
+  /**
+   * @brief Prefetch a counter that is about to be written
+   *
+   */
+  void prefetch(const int32_t row, const int32_t col) const {
+    __builtin_prefetch(counter + row * width + col, 1);
+  }
+  /**
+   * @brief Save the array
+   * @details Not to be called alongside additions, lest the snapshot be torn.
+   *
+   * @param writer  snapshot scoped to the array
+   */
+  void save(SnapshotWriter &writer) const {
+    writer.putBlob("counter", counter,
+                   sizeof(std::atomic<T>) * depth * width);
+  }
+  /**
+   * @brief Memory taken by counters
+   *
+   */
+  size_t size() const { return sizeof(std::atomic<T>) * depth * width; }
+  /**
+   * @brief Reset all counters to zero
+   * @details Not to be called alongside additions.
+   *
+   */
+  void clear() {
+    for (size_t i = 0; i < static_cast<size_t>(depth) * width; ++i) {
+      counter[i].store(0, std::memory_order_relaxed);
+    }
+  }
+};
+
+} // namespace OmniSketch::Sketch
@@ -9,6 +9,10 @@
 #pragma once
 
 #include "flowkey.h"
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 /**
  * @brief Warehouse of hashing classes
@@ -30,6 +34,8 @@
  *   uint64_t hash(const uint8_t *key, const int32_t len) const;
  *
  * public:
+ *   // Name recorded in snapshots of sketches (if they are to be saved)
+ *   static constexpr std::string_view name = "MyHash";
  *   // Constructors & destructors (if needed)
  * };
  *
@@ -44,10 +50,178 @@
  * chosen for byte array is that multitudinous hash functions (if not all) are
  * built upon unsigned integers.
  *
- * @see HashBase
+ * Hashing classes derived from HashBase are dispatched virtually. Where the
+ * indirect call matters, a hashing class may instead derive from
+ * StaticHashBase, which resolves every call at compile time and passes the
+ * length of flowkey down to the hashing loop as a template argument. Both
+ * kinds can be plugged into the `hash_t` template parameter of any sketch.
+ *
+ * Every hashing class should also provide an explicit constructor taking an
+ * `uint64_t` seed, so that instances built with the same seed hash
+ * identically, no matter in which process, thread or order they are built.
+ * Sketches draw these seeds from a SeedSequence.
+ *
+ * @see HashBase, StaticHashBase, SeedSequence, HashContext
  *
  */
 namespace OmniSketch::Hash {
+/**
+ * @brief Remix a 64-bit value by the finalizer of splitmix64
+ *
+ * @details Every bit of the value affects every bit of the result. Sketches
+ * use it to draw more bits out of a single hashed value, e.g., a fingerprint
+ * or in-block positions besides the index.
+ */
+inline uint64_t Remix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Deterministic source of seeds for hashing classes
+ *
+ * @details A SeedSequence is a base seed from which an unbounded sequence of
+ * seeds is derived by splitmix64. Two SeedSequence with the same base seed
+ * give the same hashing classes, so sketches built with them hash
+ * identically and can be merged afterwards. A default-constructed
+ * SeedSequence draws a distinct base seed from a process-wide counter, which
+ * is thread-safe.
+ *
+ * ### Example
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~.cpp
+ * Hash::SeedSequence seeds(0x5eed);
+ * // two sketches sharing the very same hashing classes
+ * Sketch::CMSketch<13, int64_t> a(4, 1024, false, 0, seeds),
+ *     b(4, 1024, false, 0, seeds);
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ */
+class SeedSequence {
+  uint64_t base;
+
+public:
+  /**
+   * @brief Construct with a freshly drawn base seed
+   *
+   * @details Base seeds are drawn from a process-wide atomic counter whose
+   * starting point comes from `rand()` on first use.
+   *
+   */
+  SeedSequence();
+  /**
+   * @brief Construct with a given base seed
+   *
+   */
+  explicit SeedSequence(uint64_t seed) : base(seed) {}
+  /**
+   * @brief Get the base seed
+   *
+   */
+  uint64_t seed() const { return base; }
+  /**
+   * @brief Get the `i`-th seed in the sequence
+   *
+   */
+  uint64_t operator[](const size_t i) const {
+    return Remix(base + (i + 1) * 0x9e3779b97f4a7c15ULL);
+  }
+  /**
+   * @brief Derive an independent sequence
+   *
+   * @details Used to seed an inner structure of a sketch (e.g., the Bloom
+   * filter inside Flow Radar) without overlapping the seeds of the sketch.
+   *
+   * @param salt  different salts lead to different sequences
+   */
+  SeedSequence fork(const uint64_t salt) const {
+    return SeedSequence(Remix(base ^ Remix(salt + 0x2545f4914f6cdd1dULL)));
+  }
+  /**
+   * @brief Construct the `i`-th hashing class of the sequence
+   *
+   * @details Hashing classes that cannot be constructed from a seed are
+   * default-constructed instead, and are hence not reproducible.
+   *
+   */
+  template <typename hash_t> hash_t get(const size_t i) const {
+    if constexpr (std::is_constructible_v<hash_t, uint64_t>) {
+      return hash_t((*this)[i]);
+    } else {
+      return hash_t();
+    }
+  }
+  /**
+   * @brief Allocate an array of hashing classes seeded by `0` to `n - 1`
+   *
+   * @return a pointer to be released by `delete[]`
+   */
+  template <typename hash_t> hash_t *make(const int32_t n) const {
+    hash_t *hash_fns = new hash_t[n];
+    for (int32_t i = 0; i < n; ++i) {
+      hash_fns[i] = get<hash_t>(i);
+    }
+    return hash_fns;
+  }
+  /**
+   * @brief Same as make() but in a vector
+   *
+   */
+  template <typename hash_t>
+  std::vector<hash_t> makeVector(const int32_t n) const {
+    std::vector<hash_t> hash_fns;
+    hash_fns.reserve(n);
+    for (int32_t i = 0; i < n; ++i) {
+      hash_fns.push_back(get<hash_t>(i));
+    }
+    return hash_fns;
+  }
+};
+
+/**
+ * @brief Indices of a flowkey in a sub-structure, computed once and shared
+ *
+ * @details A composite sketch asks its sub-structure to fill a HashContext
+ * once per packet, and then passes the context down to every method of the
+ * sub-structure taking one, so that the same key is never hashed twice. E.g.,
+ * Flow Radar looks up and then inserts into its flow filter with a single
+ * round of hashing. The buffer is reused across packets, so that nothing is
+ * allocated per packet.
+ *
+ * @see BloomFilter::hash()
+ */
+class HashContext {
+  std::vector<int32_t> indices;
+
+public:
+  HashContext() = default;
+  /**
+   * @brief Construct with room for `n` indices
+   *
+   */
+  explicit HashContext(const int32_t n) : indices(n) {}
+  /**
+   * @brief Number of indices
+   *
+   */
+  int32_t size() const { return indices.size(); }
+  /**
+   * @brief Resize to `n` indices
+   *
+   */
+  void resize(const int32_t n) { indices.resize(n); }
+  /**
+   * @brief Access the `i`-th index
+   *
+   */
+  int32_t &operator[](const int32_t i) { return indices[i]; }
+  /**
+   * @brief Access the `i`-th index
+   *
+   */
+  int32_t operator[](const int32_t i) const { return indices[i]; }
+};
+
 /**
  * @brief Base class for all hashing classes
  *
@@ -59,7 +233,9 @@ namespace OmniSketch::Hash {
  * - operator()(const FlowKey<key_len> &) const
  *
  * are automatically inherited so that they internally call
- * `hash(const uint8_t *, const int32_t) const` to hash the input.
+ * `hash(const uint8_t *, const int32_t) const` to hash the input. So is
+ * multiHash(), which hashes a flowkey with a row of hashing classes at once
+ * and may be specialized in the derived class for speed.
  *
  * ### Example
  * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~.cpp
@@ -71,6 +247,8 @@ namespace OmniSketch::Hash {
  *   uint64_t hash(const uint8_t *key, const int32_t len) const;
  *
  * public:
+ *   // Name recorded in snapshots of sketches (if they are to be saved)
+ *   static constexpr std::string_view name = "MyHash";
  *   // Constructors & destructors (if needed)
  * };
  *
@@ -96,6 +274,25 @@ private:
    * @note This function has to be declared as a constant class function.
    */
   virtual uint64_t hash(const uint8_t *key, const int32_t len) const = 0;
+  /**
+   * @brief Hash a batch of byte arrays of the same length
+   *
+   * @details May be overriden in derived class with a vectorized kernel. By
+   * default the byte arrays are hashed one by one.
+   *
+   * @param keys    pointer to the first byte array
+   * @param len     length of each byte array
+   * @param stride  distance (in bytes) between two adjacent byte arrays
+   * @param n       number of byte arrays
+   * @param out     hashed values, one for each byte array
+   */
+  virtual void hashMany(const uint8_t *keys, const int32_t len,
+                        const size_t stride, const size_t n,
+                        uint64_t *out) const {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = this->hash(keys + i * stride, len);
+    }
+  }
 
 public:
   /**
@@ -136,10 +333,72 @@ public:
     return this->hash(reinterpret_cast<const uint8_t *>(flowkey.cKey()),
                       key_len);
   }
+  /**
+   * @brief Hash an array of flowkeys
+   *
+   * @details Equivalent to `out[i] = (*this)(keys[i])` for every `i` in `[0,
+   * n)`, but the hashing class may process several flowkeys in parallel
+   * (see AwareHash).
+   *
+   * @tparam key_len  length of flowkey
+   * @param keys      array of (at least `n`) flowkeys
+   * @param n         number of flowkeys
+   * @param out       hashed values, one for each flowkey
+   */
+  template <int32_t key_len>
+  void hashBatch(const FlowKey<key_len> *keys, size_t n, uint64_t *out) const {
+    if (!n)
+      return;
+    this->hashMany(reinterpret_cast<const uint8_t *>(keys->cKey()), key_len,
+                   sizeof(FlowKey<key_len>), n, out);
+  }
+  /**
+   * @brief Hash a flowkey with a row of hashing classes at once
+   *
+   * @details Equivalent to `out[i] = hash_fns[i](flowkey)` for every `i` in
+   * `[0, num)`, but a derived class may hash all rows in a single traversal of
+   * the flowkey by providing a static method with the signature of
+   * multiHash(const hash_t *, const int32_t, const uint8_t *, const int32_t,
+   * uint64_t *) (see AwareHash).
+   *
+   * @tparam hash_t   hashing class
+   * @tparam key_len  length of flowkey
+   * @param hash_fns  array of (at least `num`) hashing classes
+   * @param num       number of rows to hash
+   * @param flowkey   the flowkey to hash
+   * @param out       hashed values, one for each row
+   */
+  template <typename hash_t, int32_t key_len>
+  static void multiHash(const hash_t *hash_fns, const int32_t num,
+                        const FlowKey<key_len> &flowkey, uint64_t *out) {
+    hash_t::multiHash(hash_fns, num,
+                      reinterpret_cast<const uint8_t *>(flowkey.cKey()),
+                      key_len, out);
+  }
+  /**
+   * @brief Hash byte array with a row of hashing classes at once
+   *
+   * @details The fallback simply hashes the byte array row by row.
+   *
+   * @tparam hash_t   hashing class
+   * @param hash_fns  array of (at least `num`) hashing classes
+   * @param num       number of rows to hash
+   * @param key       pointer to the byte array
+   * @param len       length of the byte array
+   * @param out       hashed values, one for each row
+   */
+  template <typename hash_t>
+  static void multiHash(const hash_t *hash_fns, const int32_t num,
+                        const uint8_t *key, const int32_t len, uint64_t *out) {
+    for (int32_t i = 0; i < num; ++i) {
+      out[i] = hash_fns[i](key, len);
+    }
+  }
   /**
    * @brief Randomize the seed of the pseudo-randomness generator
    *
-   * @note Currently not invoked.
+   * @note Currently not invoked. If invoked, it has to precede the first
+   * default-constructed SeedSequence to take effect.
    *
    */
   static void random_seed() { ::srand((unsigned)time(NULL)); }
@@ -154,6 +413,8 @@ public:
  *
  */
 class AwareHash : public HashBase {
+  friend class StaticAwareHash;
+
   uint64_t init;
   uint64_t scale;
   uint64_t hardener;
@@ -170,16 +431,344 @@ class AwareHash : public HashBase {
    * @see HashBase::hash(const uint8_t *, const int32_t) const
    */
   uint64_t hash(const uint8_t *data, const int32_t n) const;
+  /**
+   * @brief Hash a batch of byte arrays with an AVX2 kernel
+   *
+   * @details Eight byte arrays are hashed in parallel lanes. Falls back to
+   * the scalar loop at runtime if the CPU does not support AVX2. Results are
+   * bit-identical in both cases.
+   *
+   * @see HashBase::hashMany()
+   */
+  void hashMany(const uint8_t *keys, const int32_t len, const size_t stride,
+                const size_t n, uint64_t *out) const override;
 
 public:
+  /// name of the hashing class, recorded in snapshots
+  static constexpr std::string_view name = "AwareHash";
   /**
-   * @brief Construct an AwareHash instance
+   * @brief Construct an AwareHash instance with a freshly drawn seed
+   *
+   * @see SeedSequence::SeedSequence()
+   */
+  AwareHash();
+  /**
+   * @brief Construct an AwareHash instance with a given seed
    *
    * @details Seeds are internally mangled and hashed so that fewer
    * hash collisions are expected.
    *
    */
-  AwareHash();
+  explicit AwareHash(uint64_t seed);
+
+  using HashBase::multiHash;
+  /**
+   * @brief Hash byte array with a row of AwareHash at once
+   *
+   * @details All rows run as independent lanes in a single traversal of the
+   * byte array. Results are identical to hashing the array row by row.
+   *
+   * @see HashBase::multiHash()
+   */
+  static void multiHash(const AwareHash *hash_fns, const int32_t num,
+                        const uint8_t *key, const int32_t len, uint64_t *out);
+};
+
+/**
+ * @brief XXH64 of the xxHash family
+ *
+ * @details A port of the reference XXH64 by Yann Collet. Keys of 32 bytes or
+ * more are consumed by four independent accumulators; shorter keys, flowkeys
+ * included, go straight to the final rounds of 8, 4 and 1 byte(s).
+ *
+ * @see https://github.com/Cyan4973/xxHash/blob/dev/doc/xxhash_spec.md
+ */
+class XXHash64 : public HashBase {
+  uint64_t seed;
+  /**
+   * @see HashBase::hash(const uint8_t *, const int32_t) const
+   */
+  uint64_t hash(const uint8_t *data, const int32_t n) const;
+
+public:
+  /// name of the hashing class, recorded in snapshots
+  static constexpr std::string_view name = "XXHash64";
+  /**
+   * @brief Construct with a freshly drawn seed
+   *
+   */
+  XXHash64();
+  /**
+   * @brief Construct with a given seed
+   *
+   */
+  explicit XXHash64(uint64_t seed) : seed(seed) {}
+};
+
+/**
+ * @brief MurmurHash3
+ *
+ * @details The x64 128-bit variant by Austin Appleby, of which the lower 64
+ * bits are returned.
+ *
+ * @see https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
+ */
+class MurmurHash3 : public HashBase {
+  uint64_t seed;
+  /**
+   * @see HashBase::hash(const uint8_t *, const int32_t) const
+   */
+  uint64_t hash(const uint8_t *data, const int32_t n) const;
+
+public:
+  /// name of the hashing class, recorded in snapshots
+  static constexpr std::string_view name = "MurmurHash3";
+  /**
+   * @brief Construct with a freshly drawn seed
+   *
+   */
+  MurmurHash3();
+  /**
+   * @brief Construct with a given seed
+   *
+   */
+  explicit MurmurHash3(uint64_t seed) : seed(seed) {}
+};
+
+/**
+ * @brief CRC32C (Castagnoli), seeded
+ *
+ * @details Runs on the SSE4.2 `crc32` instruction, 8 bytes per instruction,
+ * if the CPU supports it, or else on a table-driven software implementation.
+ * Both give the same result. Only the lower 32 bits of the hashed value are
+ * set. With seed `0` it is the standard CRC32C checksum.
+ *
+ * @note CRC is linear, so it offers much weaker independence than the other
+ * hashing classes in exchange for speed.
+ */
+class CRC32C : public HashBase {
+  uint32_t seed;
+  /**
+   * @see HashBase::hash(const uint8_t *, const int32_t) const
+   */
+  uint64_t hash(const uint8_t *data, const int32_t n) const;
+
+public:
+  /// name of the hashing class, recorded in snapshots
+  static constexpr std::string_view name = "CRC32C";
+  /**
+   * @brief Construct with a freshly drawn seed
+   *
+   */
+  CRC32C();
+  /**
+   * @brief Construct with a given seed
+   *
+   */
+  explicit CRC32C(uint64_t seed)
+      : seed(static_cast<uint32_t>(seed ^ (seed >> 32))) {}
+};
+
+/**
+ * @brief Simple tabulation hashing
+ *
+ * @details Each byte position owns a table of 256 random 64-bit words, and
+ * the hashed value is the XOR of the words looked up by the bytes. Simple
+ * tabulation is 3-independent and has proven guarantees for linear probing,
+ * Count Sketch and the like.
+ *
+ * @note Tables cover the first #TABLE_NUM positions, which is enough for all
+ * flowkeys and integers. Positions beyond that reuse the tables with the
+ * looked-up word rotated, so longer keys are still hashed but without the
+ * guarantees above. Every instance takes 32 KiB.
+ */
+class TabulationHash : public HashBase {
+  static constexpr int32_t TABLE_NUM = 16;
+  uint64_t table[TABLE_NUM][256];
+  /**
+   * @see HashBase::hash(const uint8_t *, const int32_t) const
+   */
+  uint64_t hash(const uint8_t *data, const int32_t n) const;
+
+public:
+  /// name of the hashing class, recorded in snapshots
+  static constexpr std::string_view name = "TabulationHash";
+  /**
+   * @brief Construct with randomly filled tables
+   *
+   */
+  TabulationHash();
+  /**
+   * @brief Construct with tables filled from a given seed
+   *
+   */
+  explicit TabulationHash(uint64_t seed);
+};
+
+/**
+ * @brief Base class for statically dispatched hashing classes
+ *
+ * @details A CRTP counterpart of HashBase. Nothing is virtual, so that a
+ * sketch instantiated with such a hashing class calls straight into the
+ * hashing loop. The derived class `hash_t` has to provide
+ *
+ * - `uint64_t hash(const uint8_t *, const int32_t) const`
+ * - `template <int32_t len> uint64_t hashFixed(const uint8_t *) const`
+ *
+ * where the latter hashes a byte array whose length is known at compile time.
+ * Besides, it may provide `template <int32_t len> static void
+ * multiHashFixed(const hash_t *, const int32_t, const uint8_t *, uint64_t *)`
+ * to specialize multiHash().
+ *
+ * @tparam hash_t the derived hashing class
+ */
+template <typename hash_t> class StaticHashBase {
+private:
+  /**
+   * @brief Downcast to the derived class
+   *
+   */
+  const hash_t &derived() const { return static_cast<const hash_t &>(*this); }
+
+public:
+  /**
+   * @brief Hash byte array
+   *
+   */
+  uint64_t operator()(const uint8_t *key, const int32_t len) const {
+    return derived().hash(key, len);
+  }
+  /**
+   * @brief Hash an integer
+   *
+   */
+  uint64_t operator()(const size_t val) const {
+    return derived().template hashFixed<sizeof(size_t)>(
+        reinterpret_cast<const uint8_t *>(&val));
+  }
+  /**
+   * @brief Hash a flowkey
+   *
+   */
+  template <int32_t key_len>
+  uint64_t operator()(const FlowKey<key_len> &flowkey) const {
+    return derived().template hashFixed<key_len>(
+        reinterpret_cast<const uint8_t *>(flowkey.cKey()));
+  }
+  /**
+   * @brief Hash an array of flowkeys
+   * @see HashBase::hashBatch()
+   */
+  template <int32_t key_len>
+  void hashBatch(const FlowKey<key_len> *keys, size_t n, uint64_t *out) const {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = (*this)(keys[i]);
+    }
+  }
+  /**
+   * @brief Hash a flowkey with a row of hashing classes at once
+   * @see HashBase::multiHash()
+   */
+  template <int32_t key_len>
+  static void multiHash(const hash_t *hash_fns, const int32_t num,
+                        const FlowKey<key_len> &flowkey, uint64_t *out) {
+    hash_t::template multiHashFixed<key_len>(
+        hash_fns, num, reinterpret_cast<const uint8_t *>(flowkey.cKey()), out);
+  }
+  /**
+   * @brief Hash byte array with a row of hashing classes at once
+   * @see HashBase::multiHash()
+   */
+  static void multiHash(const hash_t *hash_fns, const int32_t num,
+                        const uint8_t *key, const int32_t len, uint64_t *out) {
+    for (int32_t i = 0; i < num; ++i) {
+      out[i] = hash_fns[i](key, len);
+    }
+  }
+  /**
+   * @brief Hash byte array of a fixed length with a row of hashing classes
+   *
+   * @details By default the rows are hashed one after another.
+   */
+  template <int32_t len>
+  static void multiHashFixed(const hash_t *hash_fns, const int32_t num,
+                             const uint8_t *key, uint64_t *out) {
+    for (int32_t i = 0; i < num; ++i) {
+      out[i] = hash_fns[i].template hashFixed<len>(key);
+    }
+  }
+};
+
+/**
+ * @brief Aware hash, statically dispatched
+ *
+ * @details Computes exactly the same function as AwareHash, yet the hashing
+ * loop is fully unrolled at compile time for flowkeys (`key_len` being 4, 8
+ * or 13) and integers, leaving neither an indirect call nor a loop counter on
+ * the hot path.
+ *
+ * @see AwareHash, StaticHashBase
+ */
+class StaticAwareHash : public StaticHashBase<StaticAwareHash> {
+  uint64_t init;
+  uint64_t scale;
+  uint64_t hardener;
+
+  /**
+   * @brief Workhorse of hashFixed()
+   *
+   */
+  template <size_t... I>
+  uint64_t hashUnrolled(const uint8_t *data, std::index_sequence<I...>) const {
+    uint64_t result = init;
+    ((result = result * scale + data[I]), ...);
+    return result ^ hardener;
+  }
+
+public:
+  /// name of the hashing class, recorded in snapshots
+  static constexpr std::string_view name = "StaticAwareHash";
+  /**
+   * @brief Construct a StaticAwareHash instance
+   *
+   * @details Parameters are drawn in the same way as AwareHash::AwareHash().
+   *
+   */
+  StaticAwareHash() : StaticAwareHash(AwareHash()) {}
+  /**
+   * @brief Construct with a given seed
+   *
+   * @details Same parameters as AwareHash::AwareHash(uint64_t).
+   *
+   */
+  explicit StaticAwareHash(uint64_t seed)
+      : StaticAwareHash(AwareHash(seed)) {}
+  /**
+   * @brief Construct by copying the parameters of an AwareHash
+   *
+   * @details The two instances then hash every input to the same value.
+   *
+   */
+  explicit StaticAwareHash(const AwareHash &other)
+      : init(other.init), scale(other.scale), hardener(other.hardener) {}
+  /**
+   * @brief Hash byte array of any length
+   *
+   */
+  uint64_t hash(const uint8_t *data, const int32_t n) const {
+    uint64_t result = init;
+    for (int32_t i = 0; i < n; ++i) {
+      result = result * scale + data[i];
+    }
+    return result ^ hardener;
+  }
+  /**
+   * @brief Hash byte array whose length is known at compile time
+   *
+   */
+  template <int32_t len> uint64_t hashFixed(const uint8_t *data) const {
+    return hashUnrolled(data, std::make_index_sequence<len>());
+  }
 };
 
-} // namespace OmniSketch::Hash
\ No newline at end of file
+} // namespace OmniSketch::Hash
@@ -9,6 +9,7 @@
 #pragma once
 
 #include "hash.h"
+#include "snapshot.h"
 #include "utils.h"
 #include <Eigen/Dense>
 #include <Eigen/IterativeLinearSolvers>
@@ -66,6 +67,11 @@ private:
    *
    */
   const std::vector<size_t> no_hash;
+  /**
+   * @brief Base seed of hashing classes
+   *
+   */
+  const uint64_t seed;
   /**
    * @brief array of hashing classes
    *
@@ -136,6 +142,7 @@ public:
    * @param width_cnt   width of counters on each layer, from low to high
    * @param no_hash     number of hash functions used on each layer, from low
    * to high (except for the last layer)
+   * @param seeds       seeds of hashing classes
    *
    * @details The meaning of the three parameters stipulates the following
    * requirements:
@@ -152,7 +159,18 @@ public:
    */
   CounterHierarchy(const std::vector<size_t> &no_cnt,
                    const std::vector<size_t> &width_cnt,
-                   const std::vector<size_t> &no_hash);
+                   const std::vector<size_t> &no_hash,
+                   const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a CH saved by save()
+   *
+   * @details Unlike flat counter arrays, layers of CH are not laid out as
+   * plain arrays in memory, so they are copied out of the snapshot instead of
+   * being used in place.
+   *
+   * @param reader  snapshot scoped to the CH
+   */
+  explicit CounterHierarchy(const SnapshotReader &reader);
   /**
    * @brief Destructor
    *
@@ -181,6 +199,15 @@ public:
    * index serialized in advance.
    */
   T getCnt(size_t index);
+  /**
+   * @brief Prefetch a counter that getCnt() is about to read
+   *
+   * @details Nothing is checked. Counters are prefetched from where getCnt()
+   * reads them currently, which is stale if there are pending lazy updates.
+   *
+   * @param index Serialized index of a counter
+   */
+  void prefetchCnt(size_t index) const;
   /**
    * @brief Get the original value of counters.
    *
@@ -190,6 +217,12 @@ public:
    * the index serialized in advance.
    */
   T getOriginalCnt(size_t index) const;
+  /**
+   * @brief Save CH, pending lazy updates included
+   *
+   * @param writer  snapshot scoped to the CH
+   */
+  void save(SnapshotWriter &writer) const;
   /**
    * @brief Size of CH.
    *
@@ -298,9 +331,9 @@ std::vector<double> CounterHierarchy<no_layer, T, hash_t>::decodeLayer(
 template <int32_t no_layer, typename T, typename hash_t>
 CounterHierarchy<no_layer, T, hash_t>::CounterHierarchy(
     const std::vector<size_t> &no_cnt, const std::vector<size_t> &width_cnt,
-    const std::vector<size_t> &no_hash)
+    const std::vector<size_t> &no_hash, const Hash::SeedSequence &seeds)
     : no_cnt(no_cnt), width_cnt(width_cnt), no_hash(no_hash),
-      need_to_decode(false) {
+      seed(seeds.seed()), need_to_decode(false) {
   // validity check
   if (no_layer < 1) {
     throw std::invalid_argument(
@@ -356,7 +389,7 @@ CounterHierarchy<no_layer, T, hash_t>::CounterHierarchy(
   // allocate in heap
   hash_fns = new std::vector<hash_t>[no_layer - 1];
   for (int32_t i = 0; i < no_layer - 1; ++i) {
-    hash_fns[i] = std::vector<hash_t>(no_hash[i]);
+    hash_fns[i] = seeds.fork(i).makeVector<hash_t>(no_hash[i]);
   }
   cnt_array = new std::vector<Util::DynamicIntX<T>>[no_layer];
   for (int32_t i = 0; i < no_layer; ++i) {
@@ -372,6 +405,47 @@ CounterHierarchy<no_layer, T, hash_t>::CounterHierarchy(
   decoded_cnt.resize(no_cnt[0]);
 }
 
+template <int32_t no_layer, typename T, typename hash_t>
+CounterHierarchy<no_layer, T, hash_t>::CounterHierarchy(
+    const SnapshotReader &reader)
+    : no_cnt(reader.getVector<size_t>("no_cnt")),
+      width_cnt(reader.getVector<size_t>("width_cnt")),
+      no_hash(reader.getVector<size_t>("no_hash")),
+      seed(reader.get<uint64_t>("seed")),
+      original_cnt(reader.getVector<T>("original")),
+      decoded_cnt(reader.getVector<double>("decoded")),
+      need_to_decode(reader.get<bool>("need_to_decode")) {
+  if (no_cnt.size() != no_layer || width_cnt.size() != no_layer ||
+      no_hash.size() != no_layer - 1) {
+    throw std::invalid_argument(
+        "Invalid Snapshot: Should have " + std::to_string(no_layer) +
+        " layers, but got " + std::to_string(no_cnt.size()) + " instead.");
+  }
+  // hashing classes are rebuilt from the seed
+  const Hash::SeedSequence seeds(seed);
+  hash_fns = new std::vector<hash_t>[no_layer - 1];
+  for (int32_t i = 0; i < no_layer - 1; ++i) {
+    hash_fns[i] = seeds.fork(i).makeVector<hash_t>(no_hash[i]);
+  }
+  cnt_array = new std::vector<Util::DynamicIntX<T>>[no_layer];
+  status_bits = new boost::dynamic_bitset<uint8_t>[no_layer];
+  for (int32_t i = 0; i < no_layer; ++i) {
+    const std::string layer = std::to_string(i);
+    const auto *cnt =
+        reader.map<Util::DynamicIntX<T>>("cnt" + layer, no_cnt[i]);
+    cnt_array[i].assign(cnt, cnt + no_cnt[i]);
+    const auto blocks = reader.getVector<uint8_t>("status" + layer);
+    status_bits[i].append(blocks.begin(), blocks.end());
+    status_bits[i].resize(no_cnt[i]);
+  }
+  // pending lazy updates
+  const auto index = reader.getVector<size_t>("lazy_index");
+  const auto val = reader.getVector<T>("lazy_val");
+  for (size_t i = 0; i < index.size() && i < val.size(); ++i) {
+    lazy_update[index[i]] = val[i];
+  }
+}
+
 template <int32_t no_layer, typename T, typename hash_t>
 CounterHierarchy<no_layer, T, hash_t>::~CounterHierarchy() {
   if (hash_fns)
@@ -431,11 +505,47 @@ T CounterHierarchy<no_layer, T, hash_t>::getCnt(size_t index) {
   return static_cast<T>(decoded_cnt[index]);
 }
 
+template <int32_t no_layer, typename T, typename hash_t>
+void CounterHierarchy<no_layer, T, hash_t>::prefetchCnt(size_t index) const {
+  if (!need_to_decode)
+    __builtin_prefetch(cnt_array[0].data() + index, 0);
+  else
+    __builtin_prefetch(decoded_cnt.data() + index, 0);
+}
+
 template <int32_t no_layer, typename T, typename hash_t>
 T CounterHierarchy<no_layer, T, hash_t>::getOriginalCnt(size_t index) const {
   return original_cnt[index];
 }
 
+template <int32_t no_layer, typename T, typename hash_t>
+void CounterHierarchy<no_layer, T, hash_t>::save(
+    SnapshotWriter &writer) const {
+  writer.putVector("no_cnt", no_cnt);
+  writer.putVector("width_cnt", width_cnt);
+  writer.putVector("no_hash", no_hash);
+  writer.put("seed", seed);
+  for (int32_t i = 0; i < no_layer; ++i) {
+    const std::string layer = std::to_string(i);
+    writer.putBlob("cnt" + layer, cnt_array[i].data(),
+                   sizeof(Util::DynamicIntX<T>) * no_cnt[i]);
+    std::vector<uint8_t> blocks;
+    boost::to_block_range(status_bits[i], std::back_inserter(blocks));
+    writer.putVector("status" + layer, blocks);
+  }
+  writer.putVector("original", original_cnt);
+  writer.putVector("decoded", decoded_cnt);
+  std::vector<size_t> index;
+  std::vector<T> val;
+  for (const auto &kv : lazy_update) {
+    index.push_back(kv.first);
+    val.push_back(kv.second);
+  }
+  writer.putVector("lazy_index", index);
+  writer.putVector("lazy_val", val);
+  writer.put("need_to_decode", need_to_decode);
+}
+
 template <int32_t no_layer, typename T, typename hash_t>
 size_t CounterHierarchy<no_layer, T, hash_t>::size() const {
   // counters + status bits
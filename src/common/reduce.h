@@ -0,0 +1,175 @@
+/**
+ * @file reduce.h
+ * @author dromniscience (you@domain.com)
+ * @brief Policies reducing hashed values to indices
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include "utils.h"
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+/**
+ * @brief Policies reducing hashed values to indices, along with other
+ * helpers on hashed values
+ *
+ * @details Reduction policies map a 64-bit hashed value to an index in
+ * `[0, width)`. Every sketch takes one as the `reduce_t` template parameter,
+ * which defaults to PrimeMod. A policy looks like
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~.cpp
+ * class MyReduce {
+ * public:
+ *   // width actually used when `width` is asked for
+ *   static int32_t adjust(const int32_t width);
+ *   // construct with the width returned by adjust()
+ *   explicit MyReduce(const int32_t width);
+ *   // index in [0, width)
+ *   int32_t operator()(const uint64_t hashed) const;
+ * };
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * @note Except for PrimeMod and Mod, policies work on the hashed value folded
+ * to 32 bits, so that both halves take effect. This matters for hashing
+ * classes whose lower bits are poorly mixed (AwareHash) or whose upper bits
+ * are unset (CRC32C). Widths are therefore below `2^31`, as is always the
+ * case in sketches.
+ *
+ */
+namespace OmniSketch::Hash {
+
+/**
+ * @brief Fold a 64-bit hashed value into 32 bits
+ *
+ */
+inline uint32_t Fold(const uint64_t hashed) {
+  return static_cast<uint32_t>(hashed ^ (hashed >> 32));
+}
+
+/**
+ * @brief Map a 64-bit hashed value to a sign, either `-1` or `1`
+ *
+ * @details The hashed value is multiplied by an odd constant and the top bit
+ * is taken, which depends on every bit of the hashed value. It is thus nearly
+ * independent of the index that any policy reduces the same value to, so a
+ * single hashing class gives both, as in Count Sketch.
+ */
+inline int32_t Sign(const uint64_t hashed) {
+  return static_cast<int32_t>((hashed * 0x9e3779b97f4a7c15ULL) >> 63) * 2 - 1;
+}
+
+/**
+ * @brief `hashed % width` with width rounded up to a prime
+ *
+ * @details The legacy behavior of all sketches, and hence the default
+ * policy. It costs a 64-bit division per index.
+ *
+ */
+class PrimeMod {
+  uint64_t width;
+
+public:
+  /// name of the policy, recorded in snapshots
+  static constexpr std::string_view name = "PrimeMod";
+  static int32_t adjust(const int32_t width) { return Util::NextPrime(width); }
+  explicit PrimeMod(const int32_t width) : width(width) {}
+  int32_t operator()(const uint64_t hashed) const { return hashed % width; }
+};
+
+/**
+ * @brief `hashed % width` with width as is
+ *
+ */
+class Mod {
+  uint64_t width;
+
+public:
+  /// name of the policy, recorded in snapshots
+  static constexpr std::string_view name = "Mod";
+  static int32_t adjust(const int32_t width) { return width; }
+  explicit Mod(const int32_t width) : width(width) {}
+  int32_t operator()(const uint64_t hashed) const { return hashed % width; }
+};
+
+/**
+ * @brief Multiply-shift range reduction by Lemire
+ *
+ * @details Index is `(x * width) >> 32` for the folded 32-bit value `x`, i.e.,
+ * a single multiplication. It is not `x % width`, but is as uniform.
+ *
+ * @see D. Lemire, Fast Random Integer Generation in an Interval, ACM TOMACS
+ * 29(1), 2019.
+ */
+class Lemire {
+  uint64_t width;
+
+public:
+  /// name of the policy, recorded in snapshots
+  static constexpr std::string_view name = "Lemire";
+  static int32_t adjust(const int32_t width) { return width; }
+  explicit Lemire(const int32_t width) : width(width) {}
+  int32_t operator()(const uint64_t hashed) const {
+    return (Fold(hashed) * width) >> 32;
+  }
+};
+
+/**
+ * @brief Masking with width rounded up to a power of two
+ *
+ * @details The cheapest of all, at the expense of up to twice the memory.
+ *
+ */
+class Pow2 {
+  uint32_t mask;
+
+public:
+  /// name of the policy, recorded in snapshots
+  static constexpr std::string_view name = "Pow2";
+  static int32_t adjust(const int32_t width) {
+    if (width <= 0 || width > (1 << 30)) {
+      throw std::out_of_range("Width Out Of Range: Should be in (0, 2^30], "
+                              "but got " +
+                              std::to_string(width) + " instead.");
+    }
+    int32_t pow2 = 1;
+    while (pow2 < width)
+      pow2 <<= 1;
+    return pow2;
+  }
+  explicit Pow2(const int32_t width) : mask(width - 1) {}
+  int32_t operator()(const uint64_t hashed) const {
+    return Fold(hashed) & mask;
+  }
+};
+
+/**
+ * @brief Modulo by a precomputed reciprocal
+ *
+ * @details Gives exactly `x % width` for the folded 32-bit value `x` with two
+ * multiplications instead of a division. Width is taken as is, so round it
+ * to a prime in the config if a prime modulus is wanted.
+ *
+ * @see D. Lemire, O. Kaser, N. Kurz, Faster Remainder by Direct Computation,
+ * Software: Practice and Experience 49(6), 2019.
+ */
+class Reciprocal {
+  uint64_t width;
+  uint64_t factor;
+
+public:
+  /// name of the policy, recorded in snapshots
+  static constexpr std::string_view name = "Reciprocal";
+  static int32_t adjust(const int32_t width) { return width; }
+  explicit Reciprocal(const int32_t width)
+      : width(width), factor(UINT64_MAX / width + 1) {}
+  int32_t operator()(const uint64_t hashed) const {
+    const uint64_t low = factor * Fold(hashed);
+    return (static_cast<unsigned __int128>(low) * width) >> 64;
+  }
+};
+
+} // namespace OmniSketch::Hash
@@ -10,6 +10,11 @@
 
 // A bunch of files to include!
 #include "data.h"
+#include "snapshot.h"
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 /**
  * @brief Warehouse of sketches
@@ -17,6 +22,44 @@
  */
 namespace OmniSketch::Sketch {
 
+/**
+ * @brief Name of a type argument, the same across compilers
+ * @details Arithmetic types are named after their width, e.g., `int32_t`, and
+ * the others, e.g., hashing classes and reduction policies, by their `name`.
+ *
+ */
+template <typename X> std::string TypeName() {
+  if constexpr (std::is_same_v<X, bool>) {
+    return "bool";
+  } else if constexpr (std::is_integral_v<X>) {
+    return (std::is_signed_v<X> ? "int" : "uint") +
+           std::to_string(8 * sizeof(X)) + "_t";
+  } else if constexpr (std::is_floating_point_v<X>) {
+    return sizeof(X) == sizeof(float)    ? "float"
+           : sizeof(X) == sizeof(double) ? "double"
+                                         : "long double";
+  } else {
+    return std::string(X::name);
+  }
+}
+
+/**
+ * @brief Name of a sketch along with its template arguments, e.g.,
+ * `CMSketch<13,int64_t,AwareHash,PrimeMod,int64_t>`
+ *
+ * @tparam Args   type arguments, put after the non-type ones
+ * @param name    name of the sketch
+ * @param values  non-type arguments
+ */
+template <typename... Args, typename... Values>
+std::string SketchTypeName(std::string_view name, Values... values) {
+  std::string result(name);
+  char sep = '<';
+  ((result += sep, result += std::to_string(values), sep = ','), ...);
+  ((result += sep, result += TypeName<Args>(), sep = ','), ...);
+  return result + '>';
+}
+
 /**
  * @brief Base sketch
  *
@@ -49,10 +92,28 @@ namespace OmniSketch::Sketch {
  *        <td>update(const FlowKey<key_len> &, T)</td>
  *   </tr>
  *   <tr>
+ *        <td>insert a batch of records without value</td>
+ *        <td>insertBatch(const Data::Record<key_len> *, size_t)</td>
+ *   </tr>
+ *   <tr>
+ *        <td>insert a batch of records with value</td>
+ *        <td>
+ * updateBatch(const Data::Record<key_len> *, size_t, Data::CntMethod)
+ *        </td>
+ *   </tr>
+ *   <tr>
  *        <td>look up a flowkey (*if exists*)</td>
  *        <td>lookup(const FlowKey<key_len> &) const</td>
  *   </tr>
  *   <tr>
+ *        <td>query a batch of flowkeys</td>
+ *        <td>queryBatch(const FlowKey<key_len> *, size_t, T *) const</td>
+ *   </tr>
+ *   <tr>
+ *        <td>look up a batch of flowkeys</td>
+ *        <td>lookupBatch(const FlowKey<key_len> *, size_t, bool *) const</td>
+ *   </tr>
+ *   <tr>
  *        <td>heavy hitter</td>
  *        <td>getHeavyHitter(double) const</td>
  *   </tr>
@@ -63,6 +124,22 @@ namespace OmniSketch::Sketch {
  *     </td>
  *   </tr>
  *   <tr>
+ *        <td>merge a sketch of the same kind</td>
+ *        <td>merge(const SketchBase<key_len, T> &)</td>
+ *   </tr>
+ *   <tr>
+ *        <td>subtract a sketch of the same kind</td>
+ *        <td>subtract(const SketchBase<key_len, T> &)</td>
+ *   </tr>
+ *   <tr>
+ *        <td>save to a snapshot</td>
+ *        <td>save(SnapshotWriter &) const</td>
+ *   </tr>
+ *   <tr>
+ *        <td>name the type in a snapshot</td>
+ *        <td>type() const</td>
+ *   </tr>
+ *   <tr>
  *        <td>decode flowkeys with values</td>
  *        <td>decode()</td>
  *   </tr>
@@ -70,7 +147,21 @@ namespace OmniSketch::Sketch {
  *
  */
 template <int32_t key_len, typename T = int64_t> class SketchBase {
+protected:
+  /**
+   * @brief # records or flowkeys hashed ahead by the batched methods before
+   * any of them is processed
+   *
+   */
+  static constexpr int32_t BATCH_WINDOW = 16;
+
 public:
+  /**
+   * @brief Destroy the derived sketch, as sketches are owned through pointers
+   * to the base
+   *
+   */
+  virtual ~SketchBase() = default;
   /**
    * @brief Return the size of the sketch
    *
@@ -107,6 +198,38 @@ public:
     }
     return;
   }
+  /**
+   * @brief Insert a batch of records without value
+   * @details By default records are inserted one by one. A sketch may
+   * override it to hash a window of records first and prefetch whatever they
+   * touch, so that their cache misses overlap.
+   *
+   * @param records pointer to the first record
+   * @param n       # records
+   */
+  virtual void insertBatch(const Data::Record<key_len> *records, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      insert(records[i].flowkey);
+    }
+  }
+  /**
+   * @brief Update a batch of records with their values
+   * @details The value of a record is its length under Data::InLength and 1
+   * under Data::InPacket. By default records are updated one by one. A sketch
+   * may override it to hash a window of records first and prefetch whatever
+   * they touch, so that their cache misses overlap.
+   *
+   * @param records     pointer to the first record
+   * @param n           # records
+   * @param cnt_method  counting method
+   */
+  virtual void updateBatch(const Data::Record<key_len> *records, size_t n,
+                           Data::CntMethod cnt_method) {
+    for (size_t i = 0; i < n; ++i) {
+      update(records[i].flowkey,
+             cnt_method == Data::InLength ? records[i].length : 1);
+    }
+  }
   /**
    * @brief Query the sketch for the estimated size of a flowkey
    *
@@ -131,6 +254,38 @@ public:
     }
     return false;
   }
+  /**
+   * @brief Query a batch of flowkeys
+   * @details By default flowkeys are queried one by one. A sketch may override
+   * it to hash a window of flowkeys first and prefetch whatever they read, so
+   * that their cache misses overlap.
+   *
+   * @param flowkeys  pointer to the first flowkey
+   * @param n         # flowkeys
+   * @param out       `out[i]` is set to the estimated size of `flowkeys[i]`
+   */
+  virtual void queryBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                          T *out) const {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = query(flowkeys[i]);
+    }
+  }
+  /**
+   * @brief Look up a batch of flowkeys
+   * @details By default flowkeys are looked up one by one. A sketch may
+   * override it to hash a window of flowkeys first and prefetch whatever they
+   * read, so that their cache misses overlap.
+   *
+   * @param flowkeys  pointer to the first flowkey
+   * @param n         # flowkeys
+   * @param out       `out[i]` is set to whether `flowkeys[i]` exists
+   */
+  virtual void lookupBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                           bool *out) const {
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = lookup(flowkeys[i]);
+    }
+  }
   /**
    * @brief Get all the heavy hitters
    * @return See Data::Estimation for more info.
@@ -145,6 +300,11 @@ public:
   }
   /**
    * @brief Get all the heavy changers
+   * @details Heavy changers are flowkeys whose estimates in this sketch and in
+   * `*ptr_sketch` differ by at least `threshold`. The other sketch is to
+   * summarize another window of the stream, and the same requirements as
+   * merge() apply.
+   *
    * @return See Data::Estimation for more info.
    */
   virtual Data::Estimation<key_len, T>
@@ -157,6 +317,66 @@ public:
     }
     return {};
   }
+  /**
+   * @brief Merge another sketch into this one
+   * @details Afterwards this sketch summarizes both streams, as if it had seen
+   * the records of `other` as well. Both sketches should be of the same type,
+   * the same dimensions and the same seeds, or an `std::invalid_argument` is
+   * thrown.
+   *
+   */
+  virtual void merge(const SketchBase<key_len, T> &other) {
+    static bool emit = false; // avoid burst of LOG
+    if (!emit) {
+      LOG(ERROR, "Erroneously called SketchBase::merge(const SketchBase &).");
+      emit = true;
+    }
+    return;
+  }
+  /**
+   * @brief Subtract another sketch from this one
+   * @details Only linear sketches support it. Afterwards this sketch
+   * summarizes the difference of both streams, e.g., for heavy changers. The
+   * same requirements as merge() apply.
+   *
+   */
+  virtual void subtract(const SketchBase<key_len, T> &other) {
+    static bool emit = false; // avoid burst of LOG
+    if (!emit) {
+      LOG(ERROR,
+          "Erroneously called SketchBase::subtract(const SketchBase &).");
+      emit = true;
+    }
+    return;
+  }
+  /**
+   * @brief Save the sketch into a snapshot
+   * @details Called by SaveSnapshot(). A sketch that saves itself should also
+   * have a constructor from a SnapshotReader, which LoadSnapshot() calls.
+   *
+   */
+  virtual void save(SnapshotWriter &writer) const {
+    static bool emit = false; // avoid burst of LOG
+    if (!emit) {
+      LOG(ERROR, "Erroneously called SketchBase::save(SnapshotWriter &).");
+      emit = true;
+    }
+    return;
+  }
+  /**
+   * @brief Name of the type of the sketch, recorded in snapshots
+   * @details Called by SaveSnapshot(). LoadSnapshot() checks it against the
+   * static `typeName()` of the sketch to load.
+   *
+   */
+  virtual std::string type() const {
+    static bool emit = false; // avoid burst of LOG
+    if (!emit) {
+      LOG(ERROR, "Erroneously called SketchBase::type() const.");
+      emit = true;
+    }
+    return {};
+  }
   /**
    * @brief Decode all flowkeys along with their values
    * @return An Estimation that contains all decoded flowkeys with estimated
@@ -173,4 +393,74 @@ public:
   }
 };
 
+/**
+ * @brief Cast a sketch to be merged to the type of the sketch merging it
+ * @details An `std::invalid_argument` is thrown if the types differ.
+ *
+ * @tparam sketch_t type of the sketch merging it
+ */
+template <typename sketch_t, int32_t key_len, typename T>
+const sketch_t &MergeCast(const SketchBase<key_len, T> &other) {
+  const auto *ptr = dynamic_cast<const sketch_t *>(&other);
+  if (!ptr) {
+    throw std::invalid_argument(
+        "Incompatible Sketch: Should be of the same type and template "
+        "arguments.");
+  }
+  return *ptr;
+}
+
+/**
+ * @brief Check a parameter of a sketch to be merged
+ * @details An `std::invalid_argument` is thrown if it differs.
+ *
+ * @param name      name of the parameter
+ * @param expected  value of the sketch merging it
+ * @param got       value of the sketch to be merged
+ */
+inline void CheckMergeable(const std::string &name, uint64_t expected,
+                           uint64_t got) {
+  if (expected != got) {
+    throw std::invalid_argument("Incompatible Sketch: Should have " + name +
+                                " " + std::to_string(expected) + ", but got " +
+                                std::to_string(got) + " instead.");
+  }
+}
+
+/**
+ * @brief Save a sketch to a snapshot file
+ * @details The name of the type of the sketch, template arguments included,
+ * is recorded along, so that the snapshot is loaded only into a sketch of the
+ * very type.
+ *
+ */
+template <int32_t key_len, typename T>
+void SaveSnapshot(const SketchBase<key_len, T> &sketch,
+                  const std::string &path) {
+  SnapshotWriter writer;
+  sketch.save(writer);
+  writer.write(path, sketch.type());
+}
+
+/**
+ * @brief Load a sketch from a snapshot file
+ * @details Counters are used in place where the sketch allows, so loading
+ * costs little more than mapping the file. An `std::invalid_argument` is
+ * thrown if the snapshot is not of `sketch_t`.
+ *
+ * @tparam sketch_t type of the sketch, with a constructor from a
+ * SnapshotReader and a static `typeName()`
+ */
+template <typename sketch_t>
+std::unique_ptr<sketch_t> LoadSnapshot(const std::string &path) {
+  SnapshotReader reader(path);
+  const std::string expected = sketch_t::typeName();
+  if (reader.type() != expected) {
+    throw std::invalid_argument("Incompatible Snapshot: Should be of type " +
+                                expected + ", but got " + reader.type() +
+                                " instead.");
+  }
+  return std::make_unique<sketch_t>(reader);
+}
+
 } // namespace OmniSketch::Sketch
\ No newline at end of file
@@ -0,0 +1,204 @@
+/**
+ * @file snapshot.h
+ * @author dromniscience (you@domain.com)
+ * @brief Binary snapshots of sketches
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief Version of the snapshot format
+ *
+ */
+inline constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+/**
+ * @brief Writer of a snapshot
+ *
+ * @details A snapshot consists of
+ * - a header, with the magic `"OMNISNAP"`, the version, a byte-order mark and
+ * the type of the sketch;
+ * - a table of sections, each with a name, an offset and a length;
+ * - the sections, each starting on a 64-byte boundary of the file.
+ *
+ * A sketch puts its dimensions, its base seed and its counters into sections.
+ * Hashing classes are not saved, but rebuilt from the base seed on loading.
+ * Names are scoped by sub(), so that a sketch may save its components under
+ * names of their own. The type of a sketch is named after the sketch and its
+ * template arguments, so it is the same across compilers, but values are in
+ * the byte order of the host, so snapshots are to be loaded on the same
+ * architecture.
+ *
+ * @note Sections put by putBlob() are not copied until write(), so the memory
+ * should outlive the writer.
+ */
+class SnapshotWriter {
+  struct Section {
+    std::string name;
+    const void *data;  // data put by putBlob()
+    size_t length;     // in bytes
+    std::string owned; // data put by copy instead
+    bool copied;
+  };
+  std::shared_ptr<std::vector<Section>> sections;
+  std::string prefix;
+
+public:
+  /**
+   * @brief Construct an empty snapshot
+   *
+   */
+  SnapshotWriter();
+  /**
+   * @brief A view of the snapshot that puts names under a scope
+   * @details Sections put by the view belong to this writer.
+   *
+   * @param scope name of the scope, prefixed to names as `scope.name`
+   */
+  SnapshotWriter sub(std::string_view scope) const;
+  /**
+   * @brief Put a section of bytes without copying them
+   *
+   */
+  void putBlob(std::string_view name, const void *data, size_t length);
+  /**
+   * @brief Put a section of bytes by copy
+   *
+   */
+  void putCopy(std::string_view name, const void *data, size_t length);
+  /**
+   * @brief Put a value of a trivially copyable type by copy
+   *
+   */
+  template <typename V> void put(std::string_view name, const V &value) {
+    static_assert(std::is_trivially_copyable_v<V>,
+                  "V should be trivially copyable");
+    putCopy(name, &value, sizeof(V));
+  }
+  /**
+   * @brief Put a vector of a trivially copyable type by copy
+   *
+   */
+  template <typename V>
+  void putVector(std::string_view name, const std::vector<V> &values) {
+    static_assert(std::is_trivially_copyable_v<V>,
+                  "V should be trivially copyable");
+    putCopy(name, values.data(), sizeof(V) * values.size());
+  }
+  /**
+   * @brief Write the snapshot of a sketch of type `type` to a file
+   * @details An `std::runtime_error` is thrown if the file cannot be written.
+   *
+   */
+  void write(const std::string &path, std::string_view type) const;
+};
+
+/**
+ * @brief Reader of a snapshot
+ *
+ * @details The file is mapped into memory privately and copy-on-write, and
+ * only the header and the table of sections are parsed. Sections are then
+ * used in place by map(), so counters are paged in as they are read, and a
+ * sketch that is updated afterwards never writes through to the file. The
+ * mapping lives as long as any reader or handle() of it.
+ *
+ * An `std::invalid_argument` is thrown if the file is not a snapshot of this
+ * version, or a section is missing or of a wrong size.
+ */
+class SnapshotReader {
+  struct Section {
+    size_t offset;
+    size_t length;
+  };
+  struct Mapping;
+  std::shared_ptr<Mapping> mapping;
+  std::string prefix;
+
+  /**
+   * @brief Locate a section of `length` bytes
+   *
+   */
+  void *locate(std::string_view name, size_t length) const;
+
+public:
+  /**
+   * @brief Map a snapshot file
+   * @details An `std::runtime_error` is thrown if the file cannot be mapped.
+   *
+   */
+  explicit SnapshotReader(const std::string &path);
+  /**
+   * @brief A view of the snapshot that reads names under a scope
+   *
+   */
+  SnapshotReader sub(std::string_view scope) const;
+  /**
+   * @brief Type of the sketch saved
+   *
+   */
+  const std::string &type() const;
+  /**
+   * @brief Whether there is a section of this name
+   *
+   */
+  bool has(std::string_view name) const;
+  /**
+   * @brief Length of a section in bytes
+   *
+   */
+  size_t length(std::string_view name) const;
+  /**
+   * @brief A value of a trivially copyable type
+   *
+   */
+  template <typename V> V get(std::string_view name) const {
+    static_assert(std::is_trivially_copyable_v<V>,
+                  "V should be trivially copyable");
+    V value;
+    std::memcpy(&value, locate(name, sizeof(V)), sizeof(V));
+    return value;
+  }
+  /**
+   * @brief A vector of a trivially copyable type, by copy
+   *
+   */
+  template <typename V> std::vector<V> getVector(std::string_view name) const {
+    static_assert(std::is_trivially_copyable_v<V>,
+                  "V should be trivially copyable");
+    const size_t n = length(name) / sizeof(V);
+    std::vector<V> values(n);
+    std::memcpy(values.data(), locate(name, sizeof(V) * n), sizeof(V) * n);
+    return values;
+  }
+  /**
+   * @brief `count` objects of type `V` in place, without copying
+   * @details The section should hold exactly `count` objects. Sections are
+   * aligned to 64 bytes, so is the pointer. It stays valid as long as the
+   * handle() does.
+   *
+   */
+  template <typename V> V *map(std::string_view name, size_t count) const {
+    static_assert(alignof(V) <= 64, "V should be aligned to at most 64 bytes");
+    return static_cast<V *>(locate(name, sizeof(V) * count));
+  }
+  /**
+   * @brief A handle keeping the mapping alive
+   *
+   */
+  std::shared_ptr<const void> handle() const;
+};
+
+} // namespace OmniSketch::Sketch
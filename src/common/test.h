@@ -9,12 +9,17 @@
 #pragma once
 
 // A bunch of files to include!
+#include "counter.h"
+#include "hash.h"
+#include "reduce.h"
 #include "sketch.h"
 #include <boost/any.hpp>
 #include <ctime>
+#include <functional>
 #include <map>
 #include <memory>
 #include <set>
+#include <thread>
 
 /**
  * @brief Testing classes and metrics
@@ -115,6 +120,218 @@ public:
   bool in(const Metric metric) const { return metric_set.count(metric); }
 };
 
+/**
+ * @brief Tag that carries a type, e.g., a hashing class or a reduction policy
+ *
+ */
+template <typename U> struct TypeTag {
+  using type = U;
+};
+
+/**
+ * @brief Select a hashing class by name at runtime
+ *
+ * @details Invoke `func(TypeTag<X>())`, where `X` is the hashing class named
+ * `name`, so that a generic lambda can instantiate a sketch with `typename
+ * decltype(tag)::type`. Names are those of the classes in Hash, i.e.,
+ * `AwareHash`, `StaticAwareHash`, `XXHash64`, `MurmurHash3`, `CRC32C` and
+ * `TabulationHash`. An empty name selects `default_t`, which is usually the
+ * `hash_t` given in the driver template.
+ *
+ * @tparam default_t  hashing class used when `name` is empty
+ * @param name        name of the hashing class, e.g. the `hash` key in config
+ * @param func        generic callable
+ * @return `true` on success; `false` if the name is unknown.
+ */
+template <typename default_t, typename Func>
+bool DispatchHash(const std::string_view name, Func &&func) {
+  if (name.empty()) {
+    func(TypeTag<default_t>());
+  } else if (name == "AwareHash") {
+    func(TypeTag<Hash::AwareHash>());
+  } else if (name == "StaticAwareHash") {
+    func(TypeTag<Hash::StaticAwareHash>());
+  } else if (name == "XXHash64") {
+    func(TypeTag<Hash::XXHash64>());
+  } else if (name == "MurmurHash3") {
+    func(TypeTag<Hash::MurmurHash3>());
+  } else if (name == "CRC32C") {
+    func(TypeTag<Hash::CRC32C>());
+  } else if (name == "TabulationHash") {
+    func(TypeTag<Hash::TabulationHash>());
+  } else {
+    LOG(ERROR,
+        fmt::format("Unknown hashing class \"{}\": Should be one of "
+                    "\"AwareHash\", \"StaticAwareHash\", \"XXHash64\", "
+                    "\"MurmurHash3\", \"CRC32C\" and \"TabulationHash\".",
+                    name));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Select a reduction policy by name at runtime
+ *
+ * @details The counterpart of DispatchHash() for reduction policies, i.e.,
+ * `PrimeMod`, `Mod`, `Lemire`, `Pow2` and `Reciprocal`. An empty name selects
+ * `default_t`.
+ *
+ * @tparam default_t  reduction policy used when `name` is empty
+ * @param name        name of the reduction policy
+ * @param func        generic callable
+ * @return `true` on success; `false` if the name is unknown.
+ */
+template <typename default_t, typename Func>
+bool DispatchReduce(const std::string_view name, Func &&func) {
+  if (name.empty()) {
+    func(TypeTag<default_t>());
+  } else if (name == "PrimeMod") {
+    func(TypeTag<Hash::PrimeMod>());
+  } else if (name == "Mod") {
+    func(TypeTag<Hash::Mod>());
+  } else if (name == "Lemire") {
+    func(TypeTag<Hash::Lemire>());
+  } else if (name == "Pow2") {
+    func(TypeTag<Hash::Pow2>());
+  } else if (name == "Reciprocal") {
+    func(TypeTag<Hash::Reciprocal>());
+  } else {
+    LOG(ERROR, fmt::format("Unknown reduction policy \"{}\": Should be one "
+                           "of \"PrimeMod\", \"Mod\", \"Lemire\", "
+                           "\"Pow2\" and \"Reciprocal\".",
+                           name));
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief Select a counter type by name at runtime
+ *
+ * @details The counterpart of DispatchHash() for types of counters stored in
+ * a sketch, i.e., `int8_t`, `int16_t`, `int32_t`, `uint8_t`, `uint16_t` and
+ * `uint32_t`. An empty name selects `T`. Types that cannot hold values of `T`
+ * (see Sketch::IsValidCounter()) are rejected, and `func` is never
+ * instantiated with them.
+ *
+ * @tparam T          type of values counted, i.e., the `T` in the driver
+ * template
+ * @tparam turnstile  whether counters go below zero in the normal course, so
+ * that unsigned types are rejected for a signed `T`
+ * @param name  name of the counter type
+ * @param func  generic callable
+ * @return `true` on success; `false` if the name is unknown or invalid.
+ */
+template <typename T, bool turnstile = false, typename Func>
+bool DispatchCounter(const std::string_view name, Func &&func) {
+  bool valid = true;
+  auto select = [&](auto tag) {
+    using counter_t = typename decltype(tag)::type;
+    if constexpr (Sketch::IsValidCounter<T, counter_t, turnstile>()) {
+      func(tag);
+    } else {
+      valid = false;
+    }
+  };
+  if (name.empty()) {
+    select(TypeTag<T>());
+  } else if (name == "int8_t") {
+    select(TypeTag<int8_t>());
+  } else if (name == "int16_t") {
+    select(TypeTag<int16_t>());
+  } else if (name == "int32_t") {
+    select(TypeTag<int32_t>());
+  } else if (name == "uint8_t") {
+    select(TypeTag<uint8_t>());
+  } else if (name == "uint16_t") {
+    select(TypeTag<uint16_t>());
+  } else if (name == "uint32_t") {
+    select(TypeTag<uint32_t>());
+  } else {
+    LOG(ERROR, fmt::format("Unknown counter type \"{}\": Should be one of "
+                           "\"int8_t\", \"int16_t\", \"int32_t\", "
+                           "\"uint8_t\", \"uint16_t\" and \"uint32_t\".",
+                           name));
+    return false;
+  }
+  if (!valid) {
+    LOG(ERROR, fmt::format("Invalid counter type \"{}\": Should be narrower "
+                           "than the type of values{}.",
+                           name,
+                           turnstile ? ", and signed if values are" : ""));
+  }
+  return valid;
+}
+
+/**
+ * @brief Select a hashing class, a reduction policy and a counter type by
+ * name at runtime
+ *
+ * @details Invoke `func(hash_tag, reduce_tag, counter_tag)` by
+ * DispatchHash(), DispatchReduce() and DispatchCounter(). Counter types other
+ * than `T` are only dispatched under `hash_t` and `PrimeMod`, so that a driver
+ * instantiates its sketch once per hashing class and reduction policy, plus
+ * once per counter type, rather than for their cross product.
+ *
+ * @tparam hash_t     hashing class used when `hash_name` is empty
+ * @tparam T          type of values counted
+ * @tparam turnstile  see DispatchCounter()
+ * @return `true` on success; `false` if a name is unknown or invalid, or if
+ * a counter type is asked for under other hashing classes or policies.
+ */
+template <typename hash_t, typename T, bool turnstile = false, typename Func>
+bool DispatchSketch(const std::string_view hash_name,
+                    const std::string_view reduce_name,
+                    const std::string_view counter_name, Func &&func) {
+  if (counter_name.empty()) {
+    bool valid = false;
+    DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+      valid = DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+        func(hash_tag, reduce_tag, TypeTag<T>());
+      });
+    });
+    return valid;
+  }
+  if ((!hash_name.empty() && hash_name != hash_t::name) ||
+      (!reduce_name.empty() && reduce_name != Hash::PrimeMod::name)) {
+    LOG(ERROR, fmt::format("Counter type \"{}\" under \"{}\" and \"{}\": "
+                           "Should be under \"{}\" and \"PrimeMod\" only.",
+                           counter_name, hash_name, reduce_name,
+                           hash_t::name));
+    return false;
+  }
+  return DispatchCounter<T, turnstile>(counter_name, [&](auto counter_tag) {
+    func(TypeTag<hash_t>(), TypeTag<Hash::PrimeMod>(), counter_tag);
+  });
+}
+
+/**
+ * @brief Parse the probing mode of a Bloom-filter-like sketch by name
+ *
+ * @details Either `Independent`, which evaluates one hashing class per probe,
+ * or `Double`, which derives all probes from two hashing classes. An empty
+ * name selects `Independent`.
+ *
+ * @param name            name of the probing mode, e.g., the `probe` key in
+ * config
+ * @param double_hashing  set to `true` iff the mode is `Double`
+ * @return `true` on success; `false` if the name is unknown.
+ */
+inline bool ParseProbe(const std::string_view name, bool &double_hashing) {
+  if (name.empty() || name == "Independent") {
+    double_hashing = false;
+  } else if (name == "Double") {
+    double_hashing = true;
+  } else {
+    LOG(ERROR, fmt::format("Unknown probing mode \"{}\": Should be either "
+                           "\"Independent\" or \"Double\".",
+                           name));
+    return false;
+  }
+  return true;
+}
+
 /**
  * @brief Collection of metrics
  *
@@ -151,18 +368,63 @@ public:
  *        <td>`update`</td>
  *   </tr>
  *   <tr>
+ *        <td>testInsertBatch()</td>
+ *        <td>[insertBatch()](@ref Sketch::SketchBase::insertBatch())</td>
+ *        <td>RATE</td>
+ *        <td>`insert_batch`</td>
+ *   </tr>
+ *   <tr>
+ *        <td>testUpdateBatch()</td>
+ *        <td>[updateBatch()](@ref Sketch::SketchBase::updateBatch())</td>
+ *        <td>RATE</td>
+ *        <td>`update_batch`</td>
+ *   </tr>
+ *   <tr>
+ *        <td>testShardedUpdate()</td>
+ *        <td>
+ * [updateBatch()](@ref Sketch::SketchBase::updateBatch()),
+ * [merge()](@ref Sketch::SketchBase::merge())
+ *        </td>
+ *        <td>RATE, TIME</td>
+ *        <td>`sharded_update`</td>
+ *   </tr>
+ *   <tr>
+ *        <td>testConcurrentUpdate()</td>
+ *        <td>[updateBatch()](@ref Sketch::SketchBase::updateBatch())</td>
+ *        <td>RATE</td>
+ *        <td>`concurrent_update`</td>
+ *   </tr>
+ *   <tr>
+ *        <td>testConcurrentInsert()</td>
+ *        <td>[insertBatch()](@ref Sketch::SketchBase::insertBatch())</td>
+ *        <td>RATE</td>
+ *        <td>`concurrent_insert`</td>
+ *   </tr>
+ *   <tr>
  *        <td>testQuery()</td>
  *        <td>[query()](@ref Sketch::SketchBase::query())</td>
  *        <td>RATE, ARE, AAE, ACC, PODF, DIST</td>
  *        <td>`query`</td>
  *   </tr>
  *   <tr>
+ *        <td>testQueryBatch()</td>
+ *        <td>[queryBatch()](@ref Sketch::SketchBase::queryBatch())</td>
+ *        <td>RATE, ARE, AAE</td>
+ *        <td>`query_batch`</td>
+ *   </tr>
+ *   <tr>
  *        <td>testLookup()</td>
  *        <td>[lookup()](@ref Sketch::SketchBase::lookup())</td>
  *        <td>RATE, TP, FP, PRC</td>
  *        <td>`lookup`</td>
  *   </tr>
  *   <tr>
+ *        <td>testLookupBatch()</td>
+ *        <td>[lookupBatch()](@ref Sketch::SketchBase::lookupBatch())</td>
+ *        <td>RATE, PRC</td>
+ *        <td>`lookup_batch`</td>
+ *   </tr>
+ *   <tr>
  *        <td>testHeavyHitter()</td>
  *        <td>[getHeavyHitter()](@ref Sketch::SketchBase::getHeavyHitter())</td>
  *        <td>TIME, ARE, PRC, RCL, F1</td>
@@ -191,9 +453,16 @@ private:
 
   Vec size;
   Vec insert;
+  Vec insert_batch;
   Vec lookup;
+  Vec lookup_batch;
   Vec update;
+  Vec update_batch;
+  std::map<int32_t, Vec> sharded_update; // by # threads
+  std::map<int32_t, Vec> concurrent_update; // by # threads
+  std::map<int32_t, Vec> concurrent_insert; // by # threads
   Vec query;
+  Vec query_batch;
   Vec heavy_hitter;
   Vec heavy_changer;
   Vec decode;
@@ -287,6 +556,80 @@ public:
              typename std::vector<Data::Record<key_len>>::const_iterator begin,
              typename std::vector<Data::Record<key_len>>::const_iterator end,
              Data::CntMethod cnt_method) final;
+  /**
+   * @brief Insert a row of records by batches
+   * @details Records in [begin, end) are passed to a single call of
+   * Sketch::SketchBase::insertBatch(), whose rate is thus comparable to that
+   * of testInsert(). Use a fresh sketch, lest records be inserted twice.
+   *
+   * @param ptr_sketch  pointer to the sketch
+   * @param begin       [begin, end)
+   * @param end         [begin, end)
+   */
+  virtual void testInsertBatch(
+      std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+      typename std::vector<Data::Record<key_len>>::const_iterator begin,
+      typename std::vector<Data::Record<key_len>>::const_iterator end) final;
+  /**
+   * @brief Update a row of records (with values to the sketch) by batches
+   * @details Records in [begin, end) are passed to a single call of
+   * Sketch::SketchBase::updateBatch(), whose rate is thus comparable to that
+   * of testUpdate(). Use a fresh sketch, lest records be updated twice.
+   *
+   */
+  virtual void testUpdateBatch(
+      std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+      typename std::vector<Data::Record<key_len>>::const_iterator begin,
+      typename std::vector<Data::Record<key_len>>::const_iterator end,
+      Data::CntMethod cnt_method) final;
+  /**
+   * @brief Update a row of records by several threads, each into a replica of
+   * its own, and merge the replicas afterwards
+   * @details Records in [begin, end) are split into `num_threads` contiguous
+   * ranges without being copied, and each thread updates its range into a
+   * replica by Sketch::SketchBase::updateBatch(). Replicas are then merged
+   * pairwise by Sketch::SketchBase::merge() in a tree of `log2(num_threads)`
+   * levels, with merges on the same level run in parallel. RATE counts from
+   * the start of updates to the end of merging, while TIME is that of merging
+   * alone. Metrics are kept apart for each `num_threads`.
+   *
+   * @param ptr_sketch  the merged sketch on return
+   * @param make_sketch returns a fresh replica; replicas should be mergeable,
+   * e.g., built with the same seeds
+   * @param num_threads # threads
+   */
+  virtual void testShardedUpdate(
+      std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+      const std::function<Sketch::SketchBase<key_len, T> *()> &make_sketch,
+      typename std::vector<Data::Record<key_len>>::const_iterator begin,
+      typename std::vector<Data::Record<key_len>>::const_iterator end,
+      Data::CntMethod cnt_method, int32_t num_threads) final;
+  /**
+   * @brief Update a row of records by several threads into a single sketch
+   * @details Records in [begin, end) are split into `num_threads` contiguous
+   * ranges without being copied, and each thread updates its range by
+   * Sketch::SketchBase::updateBatch() into the very sketch, which should thus
+   * be thread-safe. Metrics are kept apart for each `num_threads`. Use a
+   * fresh sketch, lest records be updated twice.
+   *
+   */
+  virtual void testConcurrentUpdate(
+      std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+      typename std::vector<Data::Record<key_len>>::const_iterator begin,
+      typename std::vector<Data::Record<key_len>>::const_iterator end,
+      Data::CntMethod cnt_method, int32_t num_threads) final;
+  /**
+   * @brief Insert a row of records by several threads into a single sketch
+   * @details The counterpart of testConcurrentUpdate() for
+   * Sketch::SketchBase::insertBatch(). Metrics are kept apart for each
+   * `num_threads`. Use a fresh sketch, lest records be inserted twice.
+   *
+   */
+  virtual void testConcurrentInsert(
+      std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+      typename std::vector<Data::Record<key_len>>::const_iterator begin,
+      typename std::vector<Data::Record<key_len>>::const_iterator end,
+      int32_t num_threads) final;
   /**
    * @brief Query for each flow in ground truth
    * @details You should override the Sketch::SketchBase::query() method.
@@ -297,6 +640,17 @@ public:
   virtual void
   testQuery(std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
             const Data::GndTruth<key_len, T> &gnd_truth) final;
+  /**
+   * @brief Query all flows in ground truth by a batch
+   * @details Flowkeys are first gathered in an array, which is then passed to
+   * a single call of Sketch::SketchBase::queryBatch(). Only the call is timed.
+   *
+   * @param ptr_sketch  pointer to the sketch
+   * @param gnd_truth   ground truth
+   */
+  virtual void
+  testQueryBatch(std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+                 const Data::GndTruth<key_len, T> &gnd_truth) final;
   /**
    * @brief Lookup each flow in ground truth
    * @details You should override the Sketch::SketchBase::lookup() method.
@@ -309,6 +663,20 @@ public:
   testLookup(std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
              const Data::GndTruth<key_len, T> &gnd_truth,
              const Data::GndTruth<key_len, T> &sample) final;
+  /**
+   * @brief Look up all flows in ground truth by a batch
+   * @details Flowkeys are first gathered in an array, which is then passed to
+   * a single call of Sketch::SketchBase::lookupBatch(). Only the call is
+   * timed.
+   *
+   * @param ptr_sketch  pointer to the sketch
+   * @param gnd_truth   ground truth
+   * @param sample      sampled ground truth
+   */
+  virtual void
+  testLookupBatch(std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+                  const Data::GndTruth<key_len, T> &gnd_truth,
+                  const Data::GndTruth<key_len, T> &sample) final;
   /**
    * @brief Test heavy hitters
    * @details You should override the Sketch::SketchBase::getHeavyHitter()
@@ -490,12 +858,32 @@ template <int32_t key_len, typename T> void TestBase<key_len, T>::show() const {
   foo(size, "Size");
   // insert
   foo(insert, "Insert");
+  // insert_batch
+  foo(insert_batch, "InsBatch");
   // lookup
   foo(lookup, "Lookup");
+  // lookup_batch
+  foo(lookup_batch, "LkpBatch");
   // update
   foo(update, "Update");
+  // update_batch
+  foo(update_batch, "UpdBatch");
+  // sharded_update
+  for (const auto &[num_threads, vec] : sharded_update) {
+    foo(vec, fmt::format("Update x{}", num_threads));
+  }
+  // concurrent_update
+  for (const auto &[num_threads, vec] : concurrent_update) {
+    foo(vec, fmt::format("Shared x{}", num_threads));
+  }
+  // concurrent_insert
+  for (const auto &[num_threads, vec] : concurrent_insert) {
+    foo(vec, fmt::format("ShIns x{}", num_threads));
+  }
   // query
   foo(query, "Query");
+  // query_batch
+  foo(query_batch, "QryBatch");
   // heavy_hitter
   foo(heavy_hitter, "HH");
   // heavy_changer
@@ -551,6 +939,176 @@ void TestBase<key_len, T>::testUpdate(
     update[Metric::RATE] = 1.0 * (end - begin) / TIMER_RESULT * 1e6;
 }
 
+template <int32_t key_len, typename T>
+void TestBase<key_len, T>::testInsertBatch(
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+    typename std::vector<Data::Record<key_len>>::const_iterator begin,
+    typename std::vector<Data::Record<key_len>>::const_iterator end) {
+  // config
+  MetricVec metric_vec(config_file, test_path, "insert_batch");
+
+  DEFINE_TIMERS;
+  START_TIMER;
+  ptr_sketch->insertBatch(&*begin, end - begin);
+  STOP_TIMER;
+  if (metric_vec.in(Metric::RATE)) {
+    insert_batch[Metric::RATE] = 1.0 * (end - begin) / TIMER_RESULT * 1e6;
+  }
+}
+
+template <int32_t key_len, typename T>
+void TestBase<key_len, T>::testUpdateBatch(
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+    typename std::vector<Data::Record<key_len>>::const_iterator begin,
+    typename std::vector<Data::Record<key_len>>::const_iterator end,
+    Data::CntMethod cnt_method) {
+  // config
+  MetricVec metric_vec(config_file, test_path, "update_batch");
+
+  DEFINE_TIMERS;
+  START_TIMER;
+  ptr_sketch->updateBatch(&*begin, end - begin, cnt_method);
+  STOP_TIMER;
+  if (metric_vec.in(Metric::RATE))
+    update_batch[Metric::RATE] = 1.0 * (end - begin) / TIMER_RESULT * 1e6;
+}
+
+template <int32_t key_len, typename T>
+void TestBase<key_len, T>::testShardedUpdate(
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+    const std::function<Sketch::SketchBase<key_len, T> *()> &make_sketch,
+    typename std::vector<Data::Record<key_len>>::const_iterator begin,
+    typename std::vector<Data::Record<key_len>>::const_iterator end,
+    Data::CntMethod cnt_method, int32_t num_threads) {
+  // config
+  MetricVec metric_vec(config_file, test_path, "sharded_update");
+  if (num_threads <= 0) {
+    LOG(ERROR, fmt::format("# Threads Out Of Range: Should be positive, but "
+                           "got {} instead.",
+                           num_threads));
+    return;
+  }
+
+  // replicas are built beforehand, so that allocation is not timed
+  std::vector<std::unique_ptr<Sketch::SketchBase<key_len, T>>> replicas;
+  for (int32_t i = 0; i < num_threads; ++i) {
+    replicas.emplace_back(make_sketch());
+  }
+  const auto total = end - begin;
+
+  DEFINE_TIMERS;
+  START_TIMER;
+  // update, with the i-th thread on the i-th range
+  std::vector<std::thread> workers;
+  for (int32_t i = 0; i < num_threads; ++i) {
+    const auto first = begin + total * i / num_threads;
+    const auto last = begin + total * (i + 1) / num_threads;
+    workers.emplace_back([&, i, first, last] {
+      if (first != last)
+        replicas[i]->updateBatch(&*first, last - first, cnt_method);
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  STOP_TIMER;
+  const int64_t update_time = TIMER_RESULT;
+  START_TIMER;
+  // merge, with the replica at `i + stride` into that at `i` on each level
+  for (int32_t stride = 1; stride < num_threads; stride *= 2) {
+    std::vector<std::thread> mergers;
+    for (int32_t i = 0; i + stride < num_threads; i += 2 * stride) {
+      mergers.emplace_back(
+          [&, i, stride] { replicas[i]->merge(*replicas[i + stride]); });
+    }
+    for (auto &merger : mergers) {
+      merger.join();
+    }
+  }
+  STOP_TIMER;
+  ptr_sketch = std::move(replicas[0]);
+
+  Vec &vec = sharded_update[num_threads];
+  if (metric_vec.in(Metric::RATE))
+    vec[Metric::RATE] = 1.0 * total / TIMER_RESULT * 1e6;
+  if (metric_vec.in(Metric::TIME))
+    vec[Metric::TIME] = TIMER_RESULT - update_time;
+}
+
+template <int32_t key_len, typename T>
+void TestBase<key_len, T>::testConcurrentUpdate(
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+    typename std::vector<Data::Record<key_len>>::const_iterator begin,
+    typename std::vector<Data::Record<key_len>>::const_iterator end,
+    Data::CntMethod cnt_method, int32_t num_threads) {
+  // config
+  MetricVec metric_vec(config_file, test_path, "concurrent_update");
+  if (num_threads <= 0) {
+    LOG(ERROR, fmt::format("# Threads Out Of Range: Should be positive, but "
+                           "got {} instead.",
+                           num_threads));
+    return;
+  }
+  const auto total = end - begin;
+
+  DEFINE_TIMERS;
+  START_TIMER;
+  // the i-th thread on the i-th range
+  std::vector<std::thread> workers;
+  for (int32_t i = 0; i < num_threads; ++i) {
+    const auto first = begin + total * i / num_threads;
+    const auto last = begin + total * (i + 1) / num_threads;
+    workers.emplace_back([&, first, last] {
+      if (first != last)
+        ptr_sketch->updateBatch(&*first, last - first, cnt_method);
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  STOP_TIMER;
+  if (metric_vec.in(Metric::RATE))
+    concurrent_update[num_threads][Metric::RATE] =
+        1.0 * total / TIMER_RESULT * 1e6;
+}
+
+template <int32_t key_len, typename T>
+void TestBase<key_len, T>::testConcurrentInsert(
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+    typename std::vector<Data::Record<key_len>>::const_iterator begin,
+    typename std::vector<Data::Record<key_len>>::const_iterator end,
+    int32_t num_threads) {
+  // config
+  MetricVec metric_vec(config_file, test_path, "concurrent_insert");
+  if (num_threads <= 0) {
+    LOG(ERROR, fmt::format("# Threads Out Of Range: Should be positive, but "
+                           "got {} instead.",
+                           num_threads));
+    return;
+  }
+  const auto total = end - begin;
+
+  DEFINE_TIMERS;
+  START_TIMER;
+  // the i-th thread on the i-th range
+  std::vector<std::thread> workers;
+  for (int32_t i = 0; i < num_threads; ++i) {
+    const auto first = begin + total * i / num_threads;
+    const auto last = begin + total * (i + 1) / num_threads;
+    workers.emplace_back([&, first, last] {
+      if (first != last)
+        ptr_sketch->insertBatch(&*first, last - first);
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  STOP_TIMER;
+  if (metric_vec.in(Metric::RATE))
+    concurrent_insert[num_threads][Metric::RATE] =
+        1.0 * total / TIMER_RESULT * 1e6;
+}
+
 template <int32_t key_len, typename T>
 void TestBase<key_len, T>::testQuery(
     std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
@@ -606,6 +1164,46 @@ void TestBase<key_len, T>::testQuery(
   }
 }
 
+template <int32_t key_len, typename T>
+void TestBase<key_len, T>::testQueryBatch(
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+    const Data::GndTruth<key_len, T> &gnd_truth) {
+  // config
+  MetricVec metric_vec(config_file, test_path, "query_batch");
+
+  std::vector<FlowKey<key_len>> flowkeys;
+  std::vector<T> actual_sizes;
+  flowkeys.reserve(gnd_truth.size());
+  actual_sizes.reserve(gnd_truth.size());
+  for (const auto &kv : gnd_truth) {
+    flowkeys.push_back(kv.get_left());
+    actual_sizes.push_back(kv.get_right());
+  }
+  std::vector<T> estimated_sizes(flowkeys.size());
+
+  DEFINE_TIMERS;
+  START_TIMER;
+  ptr_sketch->queryBatch(flowkeys.data(), flowkeys.size(),
+                         estimated_sizes.data());
+  STOP_TIMER;
+  double ARE = 0.0, AAE = 0.0;
+  for (size_t i = 0; i < flowkeys.size(); ++i) {
+    const double AE = std::abs(actual_sizes[i] - estimated_sizes[i]);
+    ARE += AE / actual_sizes[i];
+    AAE += AE;
+  }
+  // add statistics
+  if (metric_vec.in(Metric::RATE)) {
+    query_batch[Metric::RATE] = 1.0 * gnd_truth.size() / TIMER_RESULT * 1e6;
+  }
+  if (metric_vec.in(Metric::ARE)) {
+    query_batch[Metric::ARE] = ARE / gnd_truth.size();
+  }
+  if (metric_vec.in(Metric::AAE)) {
+    query_batch[Metric::AAE] = AAE / gnd_truth.size();
+  }
+}
+
 template <int32_t key_len, typename T>
 void TestBase<key_len, T>::testLookup(
     std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
@@ -643,6 +1241,43 @@ void TestBase<key_len, T>::testLookup(
   }
 }
 
+template <int32_t key_len, typename T>
+void TestBase<key_len, T>::testLookupBatch(
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
+    const Data::GndTruth<key_len, T> &gnd_truth,
+    const Data::GndTruth<key_len, T> &sample) {
+  // config
+  MetricVec metric_vec(config_file, test_path, "lookup_batch");
+
+  std::vector<FlowKey<key_len>> flowkeys;
+  flowkeys.reserve(gnd_truth.size());
+  for (const auto &kv : gnd_truth) {
+    flowkeys.push_back(kv.get_left());
+  }
+  std::unique_ptr<bool[]> existed(new bool[flowkeys.size()]);
+
+  DEFINE_TIMERS;
+  START_TIMER;
+  ptr_sketch->lookupBatch(flowkeys.data(), flowkeys.size(), existed.get());
+  STOP_TIMER;
+  double TP = 0.0, FP = 0.0;
+  for (size_t i = 0; i < flowkeys.size(); ++i) {
+    if (existed[i]) {
+      if (sample.count(flowkeys[i]))
+        TP += 1.0;
+      else
+        FP += 1.0;
+    }
+  }
+  // add statistics
+  if (metric_vec.in(Metric::RATE)) {
+    lookup_batch[Metric::RATE] = 1.0 * gnd_truth.size() / TIMER_RESULT * 1e6;
+  }
+  if (metric_vec.in(PRC)) {
+    lookup_batch[Metric::PRC] = TP / (TP + FP);
+  }
+}
+
 template <int32_t key_len, typename T>
 void TestBase<key_len, T>::testHeavyHitter(
     std::unique_ptr<Sketch::SketchBase<key_len, T>> &ptr_sketch,
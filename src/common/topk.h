@@ -0,0 +1,230 @@
+/**
+ * @file topk.h
+ * @author dromniscience (you@domain.com)
+ * @brief Tracker of the flowkeys with the largest estimates
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include "flowkey.h"
+#include "snapshot.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief The `k` flowkeys of the largest estimates offered so far
+ *
+ * @details Flowkeys are kept in `k` slots, ordered by a min-heap of slots on
+ * their estimates and indexed by a hash table from flowkeys to slots. A sketch
+ * offers every flowkey it updates along with its new estimate. A tracked
+ * flowkey has its estimate refreshed, and an untracked one takes the slot of
+ * the minimum if above it, after which the heap is restored in `O(log k)`.
+ * Slots never move, so sifting the heap touches no flowkeys and no hash
+ * table. Estimates of a sketch in the cash register model only grow, so once
+ * the heap is full, an offer of one not above the minimum is turned down by a
+ * single comparison, without even hashing the flowkey. Those in the turnstile
+ * model may fall, even below the minimum, so a tracked flowkey is looked up
+ * first to be refreshed either way. Which model applies is told by the sketch
+ * rather than by the signedness of `T`: Count Sketch estimates may fall on any
+ * update, while CM and CU ones only fall once another sketch is subtracted.
+ *
+ * @note Estimates of tracked flowkeys are refreshed only as they are offered,
+ * so a sketch should query them afresh before reporting any.
+ *
+ * @tparam key_len  length of flowkey
+ * @tparam T        type of estimates
+ */
+template <int32_t key_len, typename T> class TopK {
+public:
+  /**
+   * @brief A tracked flowkey and its estimate when last offered
+   *
+   */
+  struct Entry {
+    FlowKey<key_len> flowkey;
+    T val;
+  };
+
+private:
+  int32_t k;
+  /// whether offered estimates may fall
+  bool turnstile;
+  std::vector<Entry> slots;
+  /// slots in heap order
+  std::vector<int32_t> heap;
+  /// position of each slot in the heap
+  std::vector<int32_t> pos;
+  std::unordered_map<FlowKey<key_len>, int32_t> index;
+
+  bool less(int32_t a, int32_t b) const {
+    return slots[heap[a]].val < slots[heap[b]].val;
+  }
+  void swap(int32_t a, int32_t b) {
+    std::swap(heap[a], heap[b]);
+    pos[heap[a]] = a;
+    pos[heap[b]] = b;
+  }
+  void siftUp(int32_t i) {
+    while (i > 0 && less(i, (i - 1) / 2)) {
+      swap(i, (i - 1) / 2);
+      i = (i - 1) / 2;
+    }
+  }
+  void siftDown(int32_t i) {
+    const int32_t n = heap.size();
+    while (true) {
+      int32_t min = i;
+      if (2 * i + 1 < n && less(2 * i + 1, min))
+        min = 2 * i + 1;
+      if (2 * i + 2 < n && less(2 * i + 2, min))
+        min = 2 * i + 2;
+      if (min == i)
+        return;
+      swap(i, min);
+      i = min;
+    }
+  }
+
+public:
+  /**
+   * @brief Construct a tracker of `k` flowkeys, or a disabled one if `k` is 0
+   *
+   * @param k          # flowkeys tracked
+   * @param turnstile  whether offered estimates may fall
+   */
+  explicit TopK(int32_t k = 0, bool turnstile = false)
+      : k(k), turnstile(turnstile) {
+    if (k < 0) {
+      throw std::out_of_range(
+          "K Out Of Range: Should be non-negative, but got " +
+          std::to_string(k) + " instead.");
+    }
+    slots.reserve(k);
+    heap.reserve(k);
+    pos.reserve(k);
+    index.reserve(k);
+  }
+  /**
+   * @brief Load a tracker saved by save()
+   *
+   * @param reader  snapshot scoped to the tracker
+   */
+  explicit TopK(const SnapshotReader &reader)
+      : TopK(reader.get<int32_t>("k"), reader.get<bool>("turnstile")) {
+    for (const auto &entry : reader.getVector<Entry>("slots")) {
+      offer(entry.flowkey, entry.val);
+    }
+  }
+  /**
+   * @brief Whether flowkeys are tracked at all
+   *
+   */
+  bool enabled() const { return k > 0; }
+  /**
+   * @brief Number of flowkeys tracked at most
+   *
+   */
+  int32_t capacity() const { return k; }
+  /**
+   * @brief Tell that offered estimates may fall from now on, as when another
+   * sketch has been subtracted
+   *
+   */
+  void setTurnstile() { turnstile = true; }
+  /**
+   * @brief Offer a flowkey with its new estimate
+   *
+   */
+  void offer(const FlowKey<key_len> &flowkey, T val) {
+    const int32_t n = heap.size();
+    if (!k)
+      return;
+    if (!turnstile && n == k && val <= slots[heap[0]].val)
+      return;
+    auto iter = index.find(flowkey);
+    if (iter != index.end()) {
+      // refresh, which may move either way in the turnstile model
+      const int32_t slot = iter->second;
+      const bool up = val < slots[slot].val;
+      slots[slot].val = val;
+      if (up)
+        siftUp(pos[slot]);
+      else
+        siftDown(pos[slot]);
+    } else if (n == k && val <= slots[heap[0]].val) {
+      return;
+    } else if (n < k) {
+      slots.push_back({flowkey, val});
+      heap.push_back(n);
+      pos.push_back(n);
+      index.emplace(flowkey, n);
+      siftUp(n);
+    } else {
+      // evict the minimum
+      const int32_t slot = heap[0];
+      index.erase(slots[slot].flowkey);
+      slots[slot] = {flowkey, val};
+      index.emplace(flowkey, slot);
+      siftDown(0);
+    }
+  }
+  /**
+   * @brief Track afresh the flowkeys of both trackers
+   * @details Called after the sketch has been merged with or subtracted by
+   * that of `other`, as estimates of all flowkeys may have changed. Estimates
+   * may fall from now on if they may in `other`.
+   *
+   * @param other     tracker of the other sketch, possibly this one
+   * @param estimate  callable giving the new estimate of a flowkey
+   */
+  template <typename Estimate>
+  void retrack(const TopK &other, Estimate &&estimate) {
+    std::vector<Entry> candidates = slots;
+    candidates.insert(candidates.end(), other.slots.begin(),
+                      other.slots.end());
+    clear();
+    turnstile = turnstile || other.turnstile;
+    for (const auto &entry : candidates) {
+      offer(entry.flowkey, estimate(entry.flowkey));
+    }
+  }
+  /**
+   * @brief Tracked flowkeys, in no particular order
+   *
+   */
+  const std::vector<Entry> &entries() const { return slots; }
+  /**
+   * @brief Save the tracked flowkeys
+   *
+   * @param writer  snapshot scoped to the tracker
+   */
+  void save(SnapshotWriter &writer) const {
+    writer.put("k", k);
+    writer.put("turnstile", turnstile);
+    writer.putVector("slots", slots);
+  }
+  /**
+   * @brief Memory taken by the tracker
+   *
+   */
+  size_t size() const {
+    return (sizeof(Entry) + sizeof(int32_t) * 2) * k // slots and heap
+           + (sizeof(FlowKey<key_len>) + sizeof(int32_t)) * k; // index
+  }
+  /**
+   * @brief Forget all flowkeys
+   *
+   */
+  void clear() {
+    slots.clear();
+    heap.clear();
+    pos.clear();
+    index.clear();
+  }
+};
+
+} // namespace OmniSketch::Sketch
@@ -8,6 +8,7 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <string_view>
 #include <toml++/toml.h>
 #include <vector>
@@ -73,6 +74,45 @@ inline bool Endianness() {
   const int32_t i = 1;
   return *reinterpret_cast<const int8_t *>(&i) == 0;
 }
+/**
+ * @brief Median of `n` values, which are reordered in place
+ * @details Medians of 3, 5 and 7 values, the usual depths of sketches, are
+ * found by sorting networks of 3, 7 and 13 compare-exchanges, each compiled to
+ * conditional moves rather than branches. Other numbers of values fall back to
+ * `std::nth_element`. The median of an even number of values is the mean of
+ * the middle two.
+ *
+ * @see J. Devillard, Fast median search: an ANSI C implementation, 1998.
+ */
+template <typename T> T Median(T *values, const int32_t n) {
+  auto exchange = [values](int32_t i, int32_t j) {
+    const T lo = std::min(values[i], values[j]);
+    values[j] = std::max(values[i], values[j]);
+    values[i] = lo;
+  };
+  switch (n) {
+  case 3:
+    exchange(0, 1), exchange(1, 2), exchange(0, 1);
+    return values[1];
+  case 5:
+    exchange(0, 1), exchange(3, 4), exchange(0, 3), exchange(1, 4);
+    exchange(1, 2), exchange(2, 3), exchange(1, 2);
+    return values[2];
+  case 7:
+    exchange(0, 5), exchange(0, 3), exchange(1, 6), exchange(2, 4);
+    exchange(0, 1), exchange(3, 5), exchange(2, 6), exchange(2, 3);
+    exchange(3, 6), exchange(4, 5), exchange(1, 4), exchange(1, 3);
+    exchange(3, 4);
+    return values[3];
+  default:
+    std::nth_element(values, values + n / 2, values + n);
+    if (n & 1) { // odd
+      return values[n / 2];
+    } else { // even, the lower middle being the largest of the lower half
+      return (*std::max_element(values, values + n / 2) + values[n / 2]) / 2;
+    }
+  }
+}
 
 /**
  * @brief Parse config file and return its configurations in a versatile
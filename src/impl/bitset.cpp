@@ -0,0 +1,249 @@
+/**
+ * @file bitset.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Implementation of kernels on blocks and arrays of bits
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <common/bitset.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OMNISKETCH_BITSET_X86
+#endif
+
+namespace {
+
+using OmniSketch::Sketch::SplitBlock;
+using OmniSketch::Sketch::SplitBlockSalt;
+
+inline uint32_t SplitBlockBit(uint32_t h, int32_t i) {
+  return 1U << ((h * SplitBlockSalt[i]) >> 27);
+}
+
+void SplitBlockSetScalar(SplitBlock &block, uint32_t h, int32_t k) {
+  for (int32_t i = 0; i < k; ++i) {
+    block.word[i] |= SplitBlockBit(h, i);
+  }
+}
+
+bool SplitBlockTestScalar(const SplitBlock &block, uint32_t h, int32_t k) {
+  for (int32_t i = 0; i < k; ++i) {
+    if (!(block.word[i] & SplitBlockBit(h, i)))
+      return false;
+  }
+  return true;
+}
+
+template <bool is_or>
+void CombineScalar(uint64_t *dst, const uint64_t *src, const size_t n) {
+  for (size_t i = 0; i < n; ++i) {
+    dst[i] = is_or ? dst[i] | src[i] : dst[i] & src[i];
+  }
+}
+
+size_t PopCountScalar(const uint64_t *src, const size_t n) {
+  size_t cnt = 0;
+  for (size_t i = 0; i < n; ++i) {
+    cnt += __builtin_popcountll(src[i]);
+  }
+  return cnt;
+}
+
+/**
+ * @brief NibbleAllNonZero() one nibble at a time, without branching on them
+ *
+ */
+bool NibbleAllNonZeroScalar(const uint8_t *arr, const int32_t *idx,
+                            const int32_t k) {
+  bool all = true;
+  for (int32_t i = 0; i < k; ++i) {
+    all &= ((arr[idx[i] >> 1] >> ((idx[i] & 1) << 2)) & 0xf) != 0;
+  }
+  return all;
+}
+
+#ifdef OMNISKETCH_BITSET_X86
+/**
+ * @brief The bits that `h` picks in all eight words, with words from the
+ * `k`-th on cleared
+ *
+ */
+__attribute__((target("avx2"))) inline __m256i SplitBlockMask(uint32_t h,
+                                                               int32_t k) {
+  const __m256i salt =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(SplitBlockSalt));
+  const __m256i shift = _mm256_srli_epi32(
+      _mm256_mullo_epi32(_mm256_set1_epi32(h), salt), 27);
+  const __m256i bits = _mm256_sllv_epi32(_mm256_set1_epi32(1), shift);
+  // lanes below k are all ones
+  const __m256i keep = _mm256_cmpgt_epi32(
+      _mm256_set1_epi32(k), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  return _mm256_and_si256(bits, keep);
+}
+
+__attribute__((target("avx2"))) void
+SplitBlockSetAVX2(SplitBlock &block, uint32_t h, int32_t k) {
+  __m256i *ptr = reinterpret_cast<__m256i *>(block.word);
+  _mm256_store_si256(ptr, _mm256_or_si256(_mm256_load_si256(ptr),
+                                          SplitBlockMask(h, k)));
+}
+
+__attribute__((target("avx2"))) bool
+SplitBlockTestAVX2(const SplitBlock &block, uint32_t h, int32_t k) {
+  // whether the mask is contained in the block
+  return _mm256_testc_si256(
+      _mm256_load_si256(reinterpret_cast<const __m256i *>(block.word)),
+      SplitBlockMask(h, k));
+}
+
+/**
+ * @brief BitwiseOr() and BitwiseAnd() by AVX2, 4 words at a time
+ *
+ */
+template <bool is_or>
+__attribute__((target("avx2"))) void
+CombineAVX2(uint64_t *dst, const uint64_t *src, const size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+    const __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                        is_or ? _mm256_or_si256(a, b)
+                              : _mm256_and_si256(a, b));
+  }
+  CombineScalar<is_or>(dst + i, src + i, n - i);
+}
+
+/**
+ * @brief PopCount() by AVX2, 4 words at a time
+ * @details Each nibble is counted by a table look-up within a byte lane,
+ * and byte counts are summed into 64-bit lanes by `vpsadbw`.
+ *
+ */
+__attribute__((target("avx2"))) size_t PopCountAVX2(const uint64_t *src,
+                                                    const size_t n) {
+  const __m256i table =
+      _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, //
+                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    const __m256i lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, low));
+    const __m256i hi = _mm256_shuffle_epi8(
+        table, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    acc = _mm256_add_epi64(
+        acc, _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256()));
+  }
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         PopCountScalar(src + i, n - i);
+}
+
+/**
+ * @brief NibbleAllNonZero() by AVX2, 8 nibbles at a time
+ * @details The 32 bits from the byte of each nibble are gathered, and shifted
+ * such that the nibble is the lowest. Lanes beyond `k` are masked out of both
+ * the gather and the comparison.
+ *
+ */
+__attribute__((target("avx2"))) bool
+NibbleAllNonZeroAVX2(const uint8_t *arr, const int32_t *idx, const int32_t k) {
+  const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const __m256i low = _mm256_set1_epi32(0xf);
+  const __m256i one = _mm256_set1_epi32(1);
+  for (int32_t i = 0; i < k; i += 8) {
+    // lanes below k - i are all ones
+    const __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(k - i), lane);
+    const __m256i index = _mm256_maskload_epi32(idx + i, mask);
+    const __m256i bytes = _mm256_mask_i32gather_epi32(
+        _mm256_setzero_si256(), reinterpret_cast<const int *>(arr),
+        _mm256_srli_epi32(index, 1), mask, 1);
+    const __m256i shift = _mm256_slli_epi32(_mm256_and_si256(index, one), 2);
+    const __m256i nibble =
+        _mm256_and_si256(_mm256_srlv_epi32(bytes, shift), low);
+    // whether some nibble in the mask is zero
+    if (!_mm256_testz_si256(
+            _mm256_cmpeq_epi32(nibble, _mm256_setzero_si256()), mask))
+      return false;
+  }
+  return true;
+}
+#endif
+
+template <bool is_or>
+void CombineDispatch(uint64_t *dst, const uint64_t *src, const size_t n) {
+#ifdef OMNISKETCH_BITSET_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    CombineAVX2<is_or>(dst, src, n);
+    return;
+  }
+#endif
+  CombineScalar<is_or>(dst, src, n);
+}
+
+} // namespace
+
+namespace OmniSketch::Sketch {
+
+void SplitBlockSet(SplitBlock &block, uint32_t h, int32_t k) {
+#ifdef OMNISKETCH_BITSET_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    SplitBlockSetAVX2(block, h, k);
+    return;
+  }
+#endif
+  SplitBlockSetScalar(block, h, k);
+}
+
+bool SplitBlockTest(const SplitBlock &block, uint32_t h, int32_t k) {
+#ifdef OMNISKETCH_BITSET_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    return SplitBlockTestAVX2(block, h, k);
+  }
+#endif
+  return SplitBlockTestScalar(block, h, k);
+}
+
+void BitwiseOr(uint64_t *dst, const uint64_t *src, size_t n) {
+  CombineDispatch<true>(dst, src, n);
+}
+
+void BitwiseAnd(uint64_t *dst, const uint64_t *src, size_t n) {
+  CombineDispatch<false>(dst, src, n);
+}
+
+size_t PopCount(const uint64_t *src, size_t n) {
+#ifdef OMNISKETCH_BITSET_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    return PopCountAVX2(src, n);
+  }
+#endif
+  return PopCountScalar(src, n);
+}
+
+bool NibbleAllNonZero(const uint8_t *arr, const int32_t *idx, int32_t k) {
+#ifdef OMNISKETCH_BITSET_X86
+  // a gather is slower than a few loads in a row, until there are enough
+  // nibbles to fill most of the lanes
+  constexpr int32_t min_gather = 6;
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2 && k >= min_gather) {
+    return NibbleAllNonZeroAVX2(arr, idx, k);
+  }
+#endif
+  return NibbleAllNonZeroScalar(arr, idx, k);
+}
+
+} // namespace OmniSketch::Sketch
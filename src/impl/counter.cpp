@@ -0,0 +1,279 @@
+/**
+ * @file counter.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Implementation of gathering and combining counters
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <common/counter.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OMNISKETCH_COUNTER_X86
+#endif
+
+namespace {
+
+template <typename counter_t>
+counter_t GatherMinScalar(const counter_t *base, const int32_t *pos,
+                          const int32_t n) {
+  counter_t min_cnt = base[pos[0]];
+  for (int32_t i = 1; i < n; ++i) {
+    min_cnt = std::min(min_cnt, base[pos[i]]);
+  }
+  return min_cnt;
+}
+
+template <bool add, typename counter_t>
+void SaturateScalar(counter_t *dst, const counter_t *src, const size_t n) {
+  constexpr int64_t hi = std::numeric_limits<counter_t>::max();
+  constexpr int64_t lo = std::numeric_limits<counter_t>::lowest();
+  for (size_t i = 0; i < n; ++i) {
+    const int64_t val = add ? static_cast<int64_t>(dst[i]) + src[i]
+                            : static_cast<int64_t>(dst[i]) - src[i];
+    dst[i] = static_cast<counter_t>(std::clamp(val, lo, hi));
+  }
+}
+
+#ifdef OMNISKETCH_COUNTER_X86
+/**
+ * @brief Widen counters fetched by 32-bit gathers to 32-bit lanes
+ *
+ */
+template <typename counter_t>
+__attribute__((target("avx2"))) inline __m256i Widen(__m256i v) {
+  constexpr int shift = 32 - 8 * sizeof(counter_t);
+  if constexpr (shift == 0) {
+    return v;
+  } else if constexpr (std::is_signed_v<counter_t>) {
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, shift), shift);
+  } else {
+    return _mm256_srli_epi32(_mm256_slli_epi32(v, shift), shift);
+  }
+}
+
+/**
+ * @brief Lane-wise minimum, signed or unsigned as `counter_t` is
+ *
+ */
+template <typename counter_t>
+__attribute__((target("avx2"))) inline __m256i Min(__m256i a, __m256i b) {
+  if constexpr (std::is_signed_v<counter_t>) {
+    return _mm256_min_epi32(a, b);
+  } else {
+    return _mm256_min_epu32(a, b);
+  }
+}
+
+/**
+ * @brief GatherMin() by AVX2, eight counters at a time
+ *
+ * @details The last group is gathered under a mask, with masked lanes
+ * blended to the neutral element of minimum.
+ */
+template <typename counter_t>
+__attribute__((target("avx2"))) counter_t
+GatherMinAVX2(const counter_t *base, const int32_t *pos, const int32_t n) {
+  constexpr int scale = sizeof(counter_t);
+  const auto ptr = reinterpret_cast<const int *>(base);
+  const __m256i neutral =
+      _mm256_set1_epi32(static_cast<int32_t>(std::numeric_limits<
+                                             counter_t>::max()));
+  __m256i v_min = neutral;
+  int32_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i idx =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pos + i));
+    const __m256i v = _mm256_i32gather_epi32(ptr, idx, scale);
+    v_min = Min<counter_t>(v_min, Widen<counter_t>(v));
+  }
+  if (i < n) {
+    const __m256i mask = _mm256_cmpgt_epi32(
+        _mm256_set1_epi32(n - i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i idx = _mm256_maskload_epi32(pos + i, mask);
+    const __m256i v = Widen<counter_t>(_mm256_mask_i32gather_epi32(
+        _mm256_setzero_si256(), ptr, idx, mask, scale));
+    v_min = Min<counter_t>(v_min, _mm256_blendv_epi8(neutral, v, mask));
+  }
+  // horizontal minimum
+  __m128i m = _mm256_castsi256_si128(v_min);
+  const __m128i high = _mm256_extracti128_si256(v_min, 1);
+  if constexpr (std::is_signed_v<counter_t>) {
+    m = _mm_min_epi32(m, high);
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  } else {
+    m = _mm_min_epu32(m, high);
+    m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+    m = _mm_min_epu32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  }
+  return static_cast<counter_t>(_mm_cvtsi128_si32(m));
+}
+
+/**
+ * @brief Lane-wise saturating addition or subtraction
+ *
+ * @details 8-bit and 16-bit lanes have native instructions. 32-bit lanes
+ * detect overflow by signs (signed) or by comparison (unsigned) instead.
+ */
+template <bool add, typename counter_t>
+__attribute__((target("avx2"))) inline __m256i Saturate(__m256i a,
+                                                        __m256i b) {
+  constexpr bool is_signed = std::is_signed_v<counter_t>;
+  if constexpr (sizeof(counter_t) == 1) {
+    if constexpr (is_signed)
+      return add ? _mm256_adds_epi8(a, b) : _mm256_subs_epi8(a, b);
+    else
+      return add ? _mm256_adds_epu8(a, b) : _mm256_subs_epu8(a, b);
+  } else if constexpr (sizeof(counter_t) == 2) {
+    if constexpr (is_signed)
+      return add ? _mm256_adds_epi16(a, b) : _mm256_subs_epi16(a, b);
+    else
+      return add ? _mm256_adds_epu16(a, b) : _mm256_subs_epu16(a, b);
+  } else if constexpr (is_signed) {
+    const __m256i r = add ? _mm256_add_epi32(a, b) : _mm256_sub_epi32(a, b);
+    // sign of the result differs from that of `a`, and so does (or does not
+    // for subtraction) that of `b`
+    const __m256i overflow =
+        add ? _mm256_andnot_si256(_mm256_xor_si256(a, b),
+                                  _mm256_xor_si256(a, r))
+            : _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(a, r));
+    // INT32_MAX if `a` is non-negative and INT32_MIN otherwise
+    const __m256i bound = _mm256_xor_si256(_mm256_set1_epi32(INT32_MAX),
+                                           _mm256_srai_epi32(a, 31));
+    return _mm256_blendv_epi8(r, bound, _mm256_srai_epi32(overflow, 31));
+  } else if constexpr (add) {
+    const __m256i r = _mm256_add_epi32(a, b);
+    // wrapped around iff the sum is below `a`
+    const __m256i wrapped =
+        _mm256_xor_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(r, a), r),
+                         _mm256_set1_epi32(-1));
+    return _mm256_or_si256(r, wrapped);
+  } else {
+    return _mm256_sub_epi32(_mm256_max_epu32(a, b), b);
+  }
+}
+
+/**
+ * @brief SaturatingAdd() and SaturatingSub() by AVX2, 32 bytes at a time
+ *
+ */
+template <bool add, typename counter_t>
+__attribute__((target("avx2"))) void
+SaturateAVX2(counter_t *dst, const counter_t *src, const size_t n) {
+  constexpr size_t lanes = 32 / sizeof(counter_t);
+  size_t i = 0;
+  for (; i + lanes <= n; i += lanes) {
+    const __m256i a =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+    const __m256i b =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                        Saturate<add, counter_t>(a, b));
+  }
+  SaturateScalar<add>(dst + i, src + i, n - i);
+}
+#endif
+
+template <typename counter_t>
+counter_t GatherMinDispatch(const counter_t *base, const int32_t *pos,
+                            const int32_t n) {
+#ifdef OMNISKETCH_COUNTER_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    return GatherMinAVX2(base, pos, n);
+  }
+#endif
+  return GatherMinScalar(base, pos, n);
+}
+
+template <bool add, typename counter_t>
+void SaturateDispatch(counter_t *dst, const counter_t *src, const size_t n) {
+#ifdef OMNISKETCH_COUNTER_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    SaturateAVX2<add>(dst, src, n);
+    return;
+  }
+#endif
+  SaturateScalar<add>(dst, src, n);
+}
+
+} // namespace
+
+namespace OmniSketch::Sketch {
+
+uint8_t GatherMin(const uint8_t *base, const int32_t *pos, int32_t n) {
+  return GatherMinDispatch(base, pos, n);
+}
+
+int8_t GatherMin(const int8_t *base, const int32_t *pos, int32_t n) {
+  return GatherMinDispatch(base, pos, n);
+}
+
+uint16_t GatherMin(const uint16_t *base, const int32_t *pos, int32_t n) {
+  return GatherMinDispatch(base, pos, n);
+}
+
+int16_t GatherMin(const int16_t *base, const int32_t *pos, int32_t n) {
+  return GatherMinDispatch(base, pos, n);
+}
+
+uint32_t GatherMin(const uint32_t *base, const int32_t *pos, int32_t n) {
+  return GatherMinDispatch(base, pos, n);
+}
+
+int32_t GatherMin(const int32_t *base, const int32_t *pos, int32_t n) {
+  return GatherMinDispatch(base, pos, n);
+}
+
+void SaturatingAdd(uint8_t *dst, const uint8_t *src, size_t n) {
+  SaturateDispatch<true>(dst, src, n);
+}
+
+void SaturatingAdd(int8_t *dst, const int8_t *src, size_t n) {
+  SaturateDispatch<true>(dst, src, n);
+}
+
+void SaturatingAdd(uint16_t *dst, const uint16_t *src, size_t n) {
+  SaturateDispatch<true>(dst, src, n);
+}
+
+void SaturatingAdd(int16_t *dst, const int16_t *src, size_t n) {
+  SaturateDispatch<true>(dst, src, n);
+}
+
+void SaturatingAdd(uint32_t *dst, const uint32_t *src, size_t n) {
+  SaturateDispatch<true>(dst, src, n);
+}
+
+void SaturatingAdd(int32_t *dst, const int32_t *src, size_t n) {
+  SaturateDispatch<true>(dst, src, n);
+}
+
+void SaturatingSub(uint8_t *dst, const uint8_t *src, size_t n) {
+  SaturateDispatch<false>(dst, src, n);
+}
+
+void SaturatingSub(int8_t *dst, const int8_t *src, size_t n) {
+  SaturateDispatch<false>(dst, src, n);
+}
+
+void SaturatingSub(uint16_t *dst, const uint16_t *src, size_t n) {
+  SaturateDispatch<false>(dst, src, n);
+}
+
+void SaturatingSub(int16_t *dst, const int16_t *src, size_t n) {
+  SaturateDispatch<false>(dst, src, n);
+}
+
+void SaturatingSub(uint32_t *dst, const uint32_t *src, size_t n) {
+  SaturateDispatch<false>(dst, src, n);
+}
+
+void SaturatingSub(int32_t *dst, const int32_t *src, size_t n) {
+  SaturateDispatch<false>(dst, src, n);
+}
+
+} // namespace OmniSketch::Sketch
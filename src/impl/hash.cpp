@@ -8,6 +8,89 @@
  */
 #include <common/hash.h>
 #include <common/utils.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define OMNISKETCH_HASH_X86
+#endif
+
+//-----------------------------------------------------------------------------
+//
+//                            Vectorized kernels
+//
+//-----------------------------------------------------------------------------
+
+#ifdef OMNISKETCH_HASH_X86
+namespace {
+
+/**
+ * @brief Lane-wise 64-bit multiplication (mod 2^64)
+ *
+ * @details AVX2 only has 32x32->64 multiplication, so the low 64 bits are
+ * assembled from three partial products.
+ */
+__attribute__((target("avx2"))) inline __m256i Mul64(__m256i a, __m256i b) {
+  __m256i lo = _mm256_mul_epu32(a, b);
+  __m256i cross = _mm256_add_epi64(
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+      _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+/**
+ * @brief AwareHash over eight byte arrays at a time
+ *
+ * @details Byte `j` of eight arrays is fetched by a single 32-bit gather, so
+ * a gather may read up to 3 bytes past the byte actually needed. Groups are
+ * therefore only vectorized when those bytes still lie in the batch; the rest
+ * is left to the caller.
+ *
+ * @return number of byte arrays hashed
+ */
+__attribute__((target("avx2"))) size_t
+AwareHashAVX2(uint64_t init, uint64_t scale, uint64_t hardener,
+              const uint8_t *keys, const int32_t len, const size_t stride,
+              const size_t n, uint64_t *out) {
+  const __m256i v_init = _mm256_set1_epi64x(init);
+  const __m256i v_scale = _mm256_set1_epi64x(scale);
+  const __m256i v_hardener = _mm256_set1_epi64x(hardener);
+  const __m256i v_offset =
+      _mm256_setr_epi32(0, stride, 2 * stride, 3 * stride, 4 * stride,
+                        5 * stride, 6 * stride, 7 * stride);
+  // pick byte 0 of each 32-bit lane
+  const __m256i v_pick = _mm256_setr_epi8(
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, //
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const size_t total = n * stride;
+
+  size_t i = 0;
+  for (; i + 8 <= n && i * stride + 7 * stride + len + 3 <= total; i += 8) {
+    const uint8_t *base = keys + i * stride;
+    __m256i lo = v_init, hi = v_init;
+    for (int32_t j = 0; j < len; ++j) {
+      __m256i word = _mm256_i32gather_epi32(
+          reinterpret_cast<const int *>(base + j), v_offset, 1);
+      __m256i bytes = _mm256_shuffle_epi8(word, v_pick);
+      lo = _mm256_add_epi64(
+          Mul64(lo, v_scale),
+          _mm256_cvtepu8_epi64(_mm256_castsi256_si128(bytes)));
+      hi = _mm256_add_epi64(
+          Mul64(hi, v_scale),
+          _mm256_cvtepu8_epi64(_mm256_extracti128_si256(bytes, 1)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        _mm256_xor_si256(lo, v_hardener));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 4),
+                        _mm256_xor_si256(hi, v_hardener));
+  }
+  return i;
+}
+
+} // namespace
+#endif
 
 //-----------------------------------------------------------------------------
 //
@@ -15,24 +98,110 @@
 //
 //-----------------------------------------------------------------------------
 
+namespace {
+
+/**
+ * @brief Step a splitmix64 generator
+ *
+ */
+uint64_t SplitMix64(uint64_t &state) {
+  return OmniSketch::Hash::Remix(state += 0x9e3779b97f4a7c15ULL);
+}
+
+inline uint64_t Rotl64(uint64_t x, int r) {
+  return r ? (x << r) | (x >> (64 - r)) : x;
+}
+
+/**
+ * @brief Unaligned little-endian loads
+ *
+ */
+inline uint64_t Read64(const uint8_t *p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+inline uint32_t Read32(const uint8_t *p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/**
+ * @brief Byte-at-a-time lookup table of CRC32C (reflected 0x1EDC6F41)
+ *
+ */
+struct CRC32CTable {
+  uint32_t t[256];
+  CRC32CTable() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; ++j) {
+        crc = (crc >> 1) ^ (0x82F63B78U & (0U - (crc & 1)));
+      }
+      t[i] = crc;
+    }
+  }
+};
+
+uint32_t CRC32CSoftware(uint32_t crc, const uint8_t *data, int32_t n) {
+  static const CRC32CTable table;
+  while (n--) {
+    crc = table.t[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#ifdef OMNISKETCH_HASH_X86
+__attribute__((target("sse4.2"))) uint32_t
+CRC32CHardware(uint32_t crc, const uint8_t *data, int32_t n) {
+#ifdef __x86_64__
+  uint64_t crc64 = crc;
+  for (; n >= 8; n -= 8, data += 8) {
+    crc64 = _mm_crc32_u64(crc64, Read64(data));
+  }
+  crc = static_cast<uint32_t>(crc64);
+#endif
+  if (n >= 4) {
+    crc = _mm_crc32_u32(crc, Read32(data));
+    n -= 4;
+    data += 4;
+  }
+  while (n--) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+#endif
+
+} // anonymous namespace
+
 namespace OmniSketch::Hash {
 
-AwareHash::AwareHash() {
+SeedSequence::SeedSequence() {
+  // initialized once, thread-safely
+  static std::atomic<uint64_t> counter(
+      Util::Mangle(static_cast<uint64_t>(rand())));
+  base = Remix(
+      counter.fetch_add(0x9e3779b97f4a7c15ULL, std::memory_order_relaxed));
+}
+
+AwareHash::AwareHash() : AwareHash(SeedSequence().seed()) {}
+
+AwareHash::AwareHash(uint64_t seed) {
   static const int32_t GEN_INIT_MAGIC = 388650253;
   static const int32_t GEN_SCALE_MAGIC = 388650319;
   static const int32_t GEN_HARDENER_MAGIC = 1176845762;
-  static int32_t index = 0;
-  static uint64_t seed = 0;
-  seed = rand();
-  static AwareHash gen_hash(GEN_INIT_MAGIC, GEN_SCALE_MAGIC,
-                            GEN_HARDENER_MAGIC);
-
-  uint64_t mangled;
-  mangled = Util::Mangle(seed + (index++));
+  static const AwareHash gen_hash(GEN_INIT_MAGIC, GEN_SCALE_MAGIC,
+                                  GEN_HARDENER_MAGIC);
+
+  // adjacent seeds must not share parameters
+  uint64_t state = seed, mangled;
+  mangled = Util::Mangle(SplitMix64(state));
   init = gen_hash((const uint8_t *)&mangled, sizeof(uint64_t));
-  mangled = Util::Mangle(seed + (index++));
+  mangled = Util::Mangle(SplitMix64(state));
   scale = gen_hash((const uint8_t *)&mangled, sizeof(uint64_t));
-  mangled = Util::Mangle(seed + (index++));
+  mangled = Util::Mangle(SplitMix64(state));
   hardener = gen_hash((const uint8_t *)&mangled, sizeof(uint64_t));
 }
 
@@ -46,4 +215,171 @@ uint64_t AwareHash::hash(const uint8_t *data, const int32_t n) const {
   return result ^ hardener;
 }
 
+void AwareHash::hashMany(const uint8_t *keys, const int32_t len,
+                         const size_t stride, const size_t n,
+                         uint64_t *out) const {
+  size_t i = 0;
+#ifdef OMNISKETCH_HASH_X86
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (has_avx2) {
+    i = AwareHashAVX2(init, scale, hardener, keys, len, stride, n, out);
+  }
+#endif
+  // scalar path & the remainder
+  for (; i < n; ++i) {
+    out[i] = hash(keys + i * stride, len);
+  }
+}
+
+void AwareHash::multiHash(const AwareHash *hash_fns, const int32_t num,
+                          const uint8_t *key, const int32_t len,
+                          uint64_t *out) {
+  for (int32_t i = 0; i < num; ++i) {
+    out[i] = hash_fns[i].init;
+  }
+  // one pass over the key, every row being a lane
+  for (int32_t j = 0; j < len; ++j) {
+    const uint8_t byte = key[j];
+    for (int32_t i = 0; i < num; ++i) {
+      out[i] = out[i] * hash_fns[i].scale + byte;
+    }
+  }
+  for (int32_t i = 0; i < num; ++i) {
+    out[i] ^= hash_fns[i].hardener;
+  }
+}
+
+XXHash64::XXHash64() : seed(SeedSequence().seed()) {}
+
+uint64_t XXHash64::hash(const uint8_t *data, const int32_t n) const {
+  static const uint64_t PRIME_1 = 0x9E3779B185EBCA87ULL;
+  static const uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+  static const uint64_t PRIME_3 = 0x165667B19E3779F9ULL;
+  static const uint64_t PRIME_4 = 0x85EBCA77C2B2AE63ULL;
+  static const uint64_t PRIME_5 = 0x27D4EB2F165667C5ULL;
+  auto round = [](uint64_t acc, uint64_t input) {
+    return Rotl64(acc + input * PRIME_2, 31) * PRIME_1;
+  };
+
+  const uint8_t *const end = data + n;
+  uint64_t h;
+  if (n >= 32) {
+    uint64_t v1 = seed + PRIME_1 + PRIME_2;
+    uint64_t v2 = seed + PRIME_2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - PRIME_1;
+    for (; data + 32 <= end; data += 32) {
+      v1 = round(v1, Read64(data));
+      v2 = round(v2, Read64(data + 8));
+      v3 = round(v3, Read64(data + 16));
+      v4 = round(v4, Read64(data + 24));
+    }
+    h = Rotl64(v1, 1) + Rotl64(v2, 7) + Rotl64(v3, 12) + Rotl64(v4, 18);
+    for (uint64_t v : {v1, v2, v3, v4}) {
+      h = (h ^ round(0, v)) * PRIME_1 + PRIME_4;
+    }
+  } else {
+    h = seed + PRIME_5;
+  }
+  h += static_cast<uint64_t>(n);
+
+  for (; data + 8 <= end; data += 8) {
+    h = Rotl64(h ^ round(0, Read64(data)), 27) * PRIME_1 + PRIME_4;
+  }
+  if (data + 4 <= end) {
+    h = Rotl64(h ^ (Read32(data) * PRIME_1), 23) * PRIME_2 + PRIME_3;
+    data += 4;
+  }
+  for (; data < end; ++data) {
+    h = Rotl64(h ^ (*data * PRIME_5), 11) * PRIME_1;
+  }
+  // avalanche
+  h ^= h >> 33;
+  h *= PRIME_2;
+  h ^= h >> 29;
+  h *= PRIME_3;
+  h ^= h >> 32;
+  return h;
+}
+
+MurmurHash3::MurmurHash3() : seed(SeedSequence().seed()) {}
+
+uint64_t MurmurHash3::hash(const uint8_t *data, const int32_t n) const {
+  static const uint64_t C1 = 0x87c37b91114253d5ULL;
+  static const uint64_t C2 = 0x4cf5ad432745937fULL;
+  auto mix_k1 = [](uint64_t k1) { return Rotl64(k1 * C1, 31) * C2; };
+  auto mix_k2 = [](uint64_t k2) { return Rotl64(k2 * C2, 33) * C1; };
+  auto fmix = [](uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+  };
+
+  uint64_t h1 = seed, h2 = seed;
+  const int32_t nblocks = n / 16;
+  for (int32_t i = 0; i < nblocks; ++i, data += 16) {
+    h1 ^= mix_k1(Read64(data));
+    h1 = (Rotl64(h1, 27) + h2) * 5 + 0x52dce729;
+    h2 ^= mix_k2(Read64(data + 8));
+    h2 = (Rotl64(h2, 31) + h1) * 5 + 0x38495ab5;
+  }
+  // tail: bytes 8..14 go to k2, bytes 0..7 to k1
+  const int32_t rest = n & 15;
+  uint64_t k1 = 0, k2 = 0;
+  for (int32_t i = rest - 1; i >= 8; --i) {
+    k2 ^= static_cast<uint64_t>(data[i]) << ((i - 8) * 8);
+  }
+  for (int32_t i = std::min(rest, 8) - 1; i >= 0; --i) {
+    k1 ^= static_cast<uint64_t>(data[i]) << (i * 8);
+  }
+  if (rest > 8) {
+    h2 ^= mix_k2(k2);
+  }
+  if (rest > 0) {
+    h1 ^= mix_k1(k1);
+  }
+  // finalization
+  h1 ^= static_cast<uint64_t>(n);
+  h2 ^= static_cast<uint64_t>(n);
+  h1 += h2;
+  h2 += h1;
+  h1 = fmix(h1);
+  h2 = fmix(h2);
+  return h1 + h2;
+}
+
+CRC32C::CRC32C() : CRC32C(SeedSequence().seed()) {}
+
+uint64_t CRC32C::hash(const uint8_t *data, const int32_t n) const {
+#ifdef OMNISKETCH_HASH_X86
+  static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+  if (has_sse42) {
+    return ~CRC32CHardware(~seed, data, n);
+  }
+#endif
+  return ~CRC32CSoftware(~seed, data, n);
+}
+
+TabulationHash::TabulationHash() : TabulationHash(SeedSequence().seed()) {}
+
+TabulationHash::TabulationHash(uint64_t seed) {
+  uint64_t state = seed;
+  for (int32_t i = 0; i < TABLE_NUM; ++i) {
+    for (int32_t j = 0; j < 256; ++j) {
+      table[i][j] = SplitMix64(state);
+    }
+  }
+}
+
+uint64_t TabulationHash::hash(const uint8_t *data, const int32_t n) const {
+  uint64_t result = 0;
+  for (int32_t i = 0; i < n; ++i) {
+    result ^= Rotl64(table[i % TABLE_NUM][data[i]], i / TABLE_NUM % 64);
+  }
+  return result;
+}
+
 } // namespace OmniSketch::Hash
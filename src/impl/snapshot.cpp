@@ -0,0 +1,258 @@
+/**
+ * @file snapshot.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Implementation of binary snapshots
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include <common/snapshot.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'O', 'M', 'N', 'I', 'S', 'N', 'A', 'P'};
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+constexpr size_t ALIGNMENT = 64;
+constexpr size_t MAX_NAME = 47;
+
+/**
+ * @brief First 64 bytes of a snapshot
+ *
+ */
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t num_sections;
+  uint32_t type_length; // the type follows the header
+  uint64_t table_offset;
+  char reserved[32];
+};
+static_assert(sizeof(Header) == ALIGNMENT);
+
+/**
+ * @brief An entry in the table of sections
+ *
+ */
+struct TableEntry {
+  char name[MAX_NAME + 1]; // null-terminated
+  uint64_t offset;
+  uint64_t length;
+};
+static_assert(sizeof(TableEntry) == ALIGNMENT);
+
+size_t Align(size_t offset) {
+  return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+} // namespace
+
+namespace OmniSketch::Sketch {
+
+SnapshotWriter::SnapshotWriter()
+    : sections(std::make_shared<std::vector<Section>>()) {}
+
+SnapshotWriter SnapshotWriter::sub(std::string_view scope) const {
+  SnapshotWriter writer(*this);
+  writer.prefix += std::string(scope) + ".";
+  return writer;
+}
+
+void SnapshotWriter::putBlob(std::string_view name, const void *data,
+                             size_t length) {
+  std::string full = prefix + std::string(name);
+  if (full.size() > MAX_NAME) {
+    throw std::length_error("Name Too Long: Should be at most " +
+                            std::to_string(MAX_NAME) + " characters, but got " +
+                            full + " instead.");
+  }
+  for (const auto &section : *sections) {
+    if (section.name == full)
+      throw std::invalid_argument("Duplicate Section: " + full + ".");
+  }
+  sections->push_back(Section{std::move(full), data, length, {}, false});
+}
+
+void SnapshotWriter::putCopy(std::string_view name, const void *data,
+                             size_t length) {
+  putBlob(name, nullptr, length);
+  Section &section = sections->back();
+  section.owned.assign(static_cast<const char *>(data), length);
+  section.copied = true;
+}
+
+void SnapshotWriter::write(const std::string &path,
+                           std::string_view type) const {
+  // lay out the file
+  Header header{};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = SNAPSHOT_VERSION;
+  header.byte_order = BYTE_ORDER_MARK;
+  header.num_sections = sections->size();
+  header.type_length = type.size();
+  header.table_offset = Align(sizeof(Header) + type.size());
+  std::vector<TableEntry> table(sections->size());
+  size_t offset =
+      Align(header.table_offset + sizeof(TableEntry) * sections->size());
+  for (size_t i = 0; i < sections->size(); ++i) {
+    const Section &section = (*sections)[i];
+    std::memset(table[i].name, 0, sizeof(table[i].name));
+    std::memcpy(table[i].name, section.name.data(), section.name.size());
+    table[i].offset = offset;
+    table[i].length = section.length;
+    offset = Align(offset + section.length);
+  }
+
+  // write it
+  std::ofstream fout(path, std::ios::binary | std::ios::trunc);
+  if (!fout) {
+    throw std::runtime_error("Runtime Error: Cannot open " + path +
+                             " for writing.");
+  }
+  const char padding[ALIGNMENT] = {};
+  auto pad_to = [&](size_t target) {
+    const size_t pos = fout.tellp();
+    fout.write(padding, target - pos);
+  };
+  fout.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  fout.write(type.data(), type.size());
+  pad_to(header.table_offset);
+  fout.write(reinterpret_cast<const char *>(table.data()),
+             sizeof(TableEntry) * table.size());
+  for (size_t i = 0; i < sections->size(); ++i) {
+    const Section &section = (*sections)[i];
+    pad_to(table[i].offset);
+    fout.write(section.copied ? section.owned.data()
+                              : static_cast<const char *>(section.data),
+               section.length);
+  }
+  if (!fout) {
+    throw std::runtime_error("Runtime Error: Cannot write " + path + ".");
+  }
+}
+
+/**
+ * @brief A mapped snapshot with its parsed table of sections
+ *
+ */
+struct SnapshotReader::Mapping {
+  void *addr = MAP_FAILED;
+  size_t size = 0;
+  std::string type;
+  std::unordered_map<std::string, Section> sections;
+
+  ~Mapping() {
+    if (addr != MAP_FAILED)
+      munmap(addr, size);
+  }
+};
+
+SnapshotReader::SnapshotReader(const std::string &path)
+    : mapping(std::make_shared<Mapping>()) {
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Runtime Error: Cannot open " + path +
+                             " for reading.");
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(Header)) {
+    mapping->size = st.st_size;
+    // private and copy-on-write, so that sketches may update counters in place
+    mapping->addr = mmap(nullptr, mapping->size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping->addr == MAP_FAILED) {
+    throw std::runtime_error("Runtime Error: Cannot map " + path +
+                             ", which should be a snapshot.");
+  }
+
+  // parse the header and the table
+  const char *base = static_cast<const char *>(mapping->addr);
+  Header header;
+  std::memcpy(&header, base, sizeof(header));
+  if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC))) {
+    throw std::invalid_argument("Invalid Snapshot: " + path +
+                                " is not a snapshot.");
+  }
+  if (header.version != SNAPSHOT_VERSION) {
+    throw std::invalid_argument(
+        "Invalid Snapshot: Should be of version " +
+        std::to_string(SNAPSHOT_VERSION) + ", but got " +
+        std::to_string(header.version) + " instead.");
+  }
+  if (header.byte_order != BYTE_ORDER_MARK) {
+    throw std::invalid_argument(
+        "Invalid Snapshot: Should be of the byte order of the host.");
+  }
+  const size_t table_end =
+      header.table_offset + sizeof(TableEntry) * header.num_sections;
+  if (sizeof(Header) + header.type_length > mapping->size ||
+      table_end > mapping->size) {
+    throw std::invalid_argument("Invalid Snapshot: " + path +
+                                " is truncated.");
+  }
+  mapping->type.assign(base + sizeof(Header), header.type_length);
+  for (uint32_t i = 0; i < header.num_sections; ++i) {
+    TableEntry entry;
+    std::memcpy(&entry, base + header.table_offset + sizeof(TableEntry) * i,
+                sizeof(entry));
+    entry.name[MAX_NAME] = '\0';
+    if (entry.offset % ALIGNMENT || entry.offset > mapping->size ||
+        entry.length > mapping->size - entry.offset) {
+      throw std::invalid_argument("Invalid Snapshot: " + path +
+                                  " is truncated.");
+    }
+    mapping->sections[entry.name] = Section{entry.offset, entry.length};
+  }
+}
+
+SnapshotReader SnapshotReader::sub(std::string_view scope) const {
+  SnapshotReader reader(*this);
+  reader.prefix += std::string(scope) + ".";
+  return reader;
+}
+
+const std::string &SnapshotReader::type() const { return mapping->type; }
+
+bool SnapshotReader::has(std::string_view name) const {
+  return mapping->sections.count(prefix + std::string(name));
+}
+
+size_t SnapshotReader::length(std::string_view name) const {
+  const std::string full = prefix + std::string(name);
+  auto iter = mapping->sections.find(full);
+  if (iter == mapping->sections.end()) {
+    throw std::invalid_argument("Invalid Snapshot: Should have section " +
+                                full + ", but got none instead.");
+  }
+  return iter->second.length;
+}
+
+void *SnapshotReader::locate(std::string_view name, size_t length) const {
+  const std::string full = prefix + std::string(name);
+  auto iter = mapping->sections.find(full);
+  if (iter == mapping->sections.end()) {
+    throw std::invalid_argument("Invalid Snapshot: Should have section " +
+                                full + ", but got none instead.");
+  }
+  if (iter->second.length != length) {
+    throw std::invalid_argument(
+        "Invalid Snapshot: Should have section " + full + " of " +
+        std::to_string(length) + " bytes, but got " +
+        std::to_string(iter->second.length) + " instead.");
+  }
+  return static_cast<char *>(mapping->addr) + iter->second.offset;
+}
+
+std::shared_ptr<const void> SnapshotReader::handle() const {
+  return mapping;
+}
+
+} // namespace OmniSketch::Sketch
@@ -0,0 +1,269 @@
+/**
+ * @file BlockedBloomFilter.h
+ * @author dromniscience (you@domain.com)
+ * @brief Register-blocked Bloom Filter
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/bitset.h>
+#include <common/hash.h>
+#include <common/reduce.h>
+#include <common/sketch.h>
+#include <algorithm>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief Bloom Filter with all bits of a flowkey in one 256-bit block
+ *
+ * @details A flowkey is hashed once to pick a block, and its `num_hash` bits
+ * are picked inside that block by the remaining bits of the hashed value, one
+ * bit per 32-bit word (see SplitBlock). An insertion or a look-up thus costs a
+ * single hashing and touches a single cache line, and a look-up is a single
+ * AVX2 comparison of the block against the bits of the flowkey. The price is
+ * a higher false positive rate than BloomFilter of the same size, as keys
+ * sharing a block collide more often than keys spread over the whole array.
+ *
+ * @tparam key_len  length of flowkey
+ * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
+ */
+template <int32_t key_len, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
+class BlockedBloomFilter : public SketchBase<key_len> {
+private:
+  int32_t num_block;
+  int32_t num_hash;
+  reduce_t reduce;
+  hash_t hash_fn;
+  uint64_t seed; // base seed of hashing classes
+  SplitBlock *block;
+  /// keeps blocks mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
+
+  BlockedBloomFilter(const BlockedBloomFilter &) = delete;
+  BlockedBloomFilter(BlockedBloomFilter &&) = delete;
+
+public:
+  /**
+   * @brief Construct by specifying # blocks and # bits of a flowkey
+   *
+   * @param num_block_  # 256-bit blocks
+   * @param num_hash_   # bits of a flowkey, at most 8
+   * @param seeds       seeds of hashing classes; filters built with the same
+   * seeds hash identically
+   */
+  BlockedBloomFilter(int32_t num_block_, int32_t num_hash_,
+                     const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a filter saved by save(), with blocks used in place
+   *
+   */
+  explicit BlockedBloomFilter(const SnapshotReader &reader);
+  /**
+   * @brief Release the pointer
+   *
+   */
+  ~BlockedBloomFilter();
+  /**
+   * @brief Insert a flowkey into the filter
+   * @details An overriding method
+   *
+   */
+  void insert(const FlowKey<key_len> &flowkey) override;
+  /**
+   * @brief Insert a batch of records
+   * @details An overriding method. A window of records is hashed and the
+   * blocks they set are prefetched before any of them is inserted.
+   *
+   */
+  void insertBatch(const Data::Record<key_len> *records, size_t n) override;
+  /**
+   * @brief Look up a flowkey to see whether it exists
+   * @details An overriding method
+   *
+   */
+  bool lookup(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Look up a batch of flowkeys
+   * @details An overriding method. A window of flowkeys is hashed and the
+   * blocks they read are prefetched before any of them is looked up.
+   *
+   */
+  void lookupBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                   bool *out) const override;
+  /**
+   * @brief Merge a filter of the same size, # bits and seeds
+   * @details An overriding method. Afterwards the filter holds flowkeys of
+   * both.
+   *
+   */
+  void merge(const SketchBase<key_len> &other) override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<hash_t, reduce_t>("BlockedBloomFilter", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the size, # bits, the seed and the blocks
+   * @details An overriding method
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
+  /**
+   * @brief Size of the sketch
+   * @details An overriding method
+   */
+  size_t size() const override;
+  /**
+   * @brief Reset the filter
+   * @details A non-overriding method
+   */
+  void clear();
+};
+
+} // namespace OmniSketch::Sketch
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Sketch {
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+BlockedBloomFilter<key_len, hash_t, reduce_t>::BlockedBloomFilter(
+    int32_t num_block_, int32_t num_hash_, const Hash::SeedSequence &seeds)
+    : num_block(reduce_t::adjust(num_block_)), num_hash(num_hash_),
+      reduce(num_block), hash_fn(seeds.get<hash_t>(0)), seed(seeds.seed()) {
+  if (num_hash <= 0 || num_hash > SplitBlock::words) {
+    throw std::out_of_range("# Hash Out Of Range: Should be in [1, " +
+                            std::to_string(SplitBlock::words) +
+                            "], but got " + std::to_string(num_hash) +
+                            " instead.");
+  }
+  block = new SplitBlock[num_block](); // Init with zero
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+BlockedBloomFilter<key_len, hash_t, reduce_t>::BlockedBloomFilter(
+    const SnapshotReader &reader)
+    : num_block(reader.get<int32_t>("num_block")),
+      num_hash(reader.get<int32_t>("num_hash")), reduce(num_block),
+      hash_fn(Hash::SeedSequence(reader.get<uint64_t>("seed")).get<hash_t>(0)),
+      seed(reader.get<uint64_t>("seed")),
+      block(reader.map<SplitBlock>("block", num_block)),
+      mapping(reader.handle()) {}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+BlockedBloomFilter<key_len, hash_t, reduce_t>::~BlockedBloomFilter() {
+  if (!mapping)
+    delete[] block;
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BlockedBloomFilter<key_len, hash_t, reduce_t>::insert(
+    const FlowKey<key_len> &flowkey) {
+  const uint64_t hashed = hash_fn(flowkey);
+  // remixed, so that bits picked in a block do not correlate with the block
+  SplitBlockSet(block[reduce(hashed)], Hash::Remix(hashed) >> 32, num_hash);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BlockedBloomFilter<key_len, hash_t, reduce_t>::insertBatch(
+    const Data::Record<key_len> *records, size_t n) {
+  constexpr size_t window = SketchBase<key_len>::BATCH_WINDOW;
+  int32_t indices[window];
+  uint32_t bits[window];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the blocks
+    for (size_t j = 0; j < m; ++j) {
+      const uint64_t hashed = hash_fn(records[base + j].flowkey);
+      indices[j] = reduce(hashed);
+      bits[j] = Hash::Remix(hashed) >> 32;
+      __builtin_prefetch(block + indices[j], 1);
+    }
+    // then set the bits
+    for (size_t j = 0; j < m; ++j) {
+      SplitBlockSet(block[indices[j]], bits[j], num_hash);
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+bool BlockedBloomFilter<key_len, hash_t, reduce_t>::lookup(
+    const FlowKey<key_len> &flowkey) const {
+  const uint64_t hashed = hash_fn(flowkey);
+  return SplitBlockTest(block[reduce(hashed)], Hash::Remix(hashed) >> 32,
+                        num_hash);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BlockedBloomFilter<key_len, hash_t, reduce_t>::lookupBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, bool *out) const {
+  constexpr size_t window = SketchBase<key_len>::BATCH_WINDOW;
+  int32_t indices[window];
+  uint32_t bits[window];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the blocks
+    for (size_t j = 0; j < m; ++j) {
+      const uint64_t hashed = hash_fn(flowkeys[base + j]);
+      indices[j] = reduce(hashed);
+      bits[j] = Hash::Remix(hashed) >> 32;
+      __builtin_prefetch(block + indices[j], 0);
+    }
+    // then test the bits
+    for (size_t j = 0; j < m; ++j) {
+      out[base + j] = SplitBlockTest(block[indices[j]], bits[j], num_hash);
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BlockedBloomFilter<key_len, hash_t, reduce_t>::merge(
+    const SketchBase<key_len> &other) {
+  const auto &filter = MergeCast<BlockedBloomFilter>(other);
+  CheckMergeable("# block", num_block, filter.num_block);
+  CheckMergeable("# hash", num_hash, filter.num_hash);
+  CheckMergeable("seed", seed, filter.seed);
+  for (int32_t i = 0; i < num_block; ++i) {
+    for (int32_t j = 0; j < SplitBlock::words; ++j) {
+      block[i].word[j] |= filter.block[i].word[j];
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BlockedBloomFilter<key_len, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("num_block", num_block);
+  writer.put("num_hash", num_hash);
+  writer.put("seed", seed);
+  writer.putBlob("block", block, sizeof(SplitBlock) * num_block);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+size_t BlockedBloomFilter<key_len, hash_t, reduce_t>::size() const {
+  return sizeof(*this)                     // instance
+         + sizeof(SplitBlock) * num_block; // block
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BlockedBloomFilter<key_len, hash_t, reduce_t>::clear() {
+  std::fill(block, block + num_block, SplitBlock());
+}
+
+} // namespace OmniSketch::Sketch
@@ -0,0 +1,233 @@
+/**
+ * @file BlockedCMSketch.h
+ * @author dromniscience (you@domain.com)
+ * @brief Implementation of Blocked Count Min Sketch
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/hash.h>
+#include <common/reduce.h>
+#include <common/sketch.h>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief Count Min Sketch with all counters of a key in one cache line
+ *
+ * @details A key is hashed once to pick a 64-byte bucket, and its `depth`
+ * sub-counters are picked inside that bucket by the remaining bits of the
+ * hashed value. The bucket is split into `depth` groups of adjacent counters,
+ * one per row, and a key picks one counter in each group, much as
+ * BlockedBloomFilter picks one bit per word (see SplitBlock). Counters of a
+ * key are thus distinct, and each row stays independent. An update or a query
+ * touches a single cache line instead of `depth` ones, at the expense of more
+ * collisions among keys sharing a bucket.
+ *
+ * @tparam key_len  length of flowkey
+ * @tparam T        type of the counter
+ * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
+ */
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
+class BlockedCMSketch : public SketchBase<key_len, T> {
+private:
+  static_assert(64 % sizeof(T) == 0, "T should divide a cache line");
+  /// # counters in a bucket
+  static constexpr int32_t slots = 64 / sizeof(T);
+  /// # hashed bits to pick a counter in a bucket
+  static constexpr int32_t slot_bits = __builtin_ctz(slots);
+  /// # counters of a key that a 64-bit hashed value can pick
+  static constexpr int32_t max_depth = std::min(slots, 64 / slot_bits);
+
+  struct alignas(64) Bucket {
+    T counter[slots];
+  };
+
+  int32_t depth;
+  int32_t num_bucket;
+  reduce_t reduce;
+  hash_t hash_fn;
+  uint64_t seed; // base seed of hashing classes
+  /// first counter of each row in a bucket, followed by `slots`
+  int32_t group[max_depth + 1];
+  Bucket *bucket;
+  /// keeps buckets mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
+
+  BlockedCMSketch(const BlockedCMSketch &) = delete;
+  BlockedCMSketch(BlockedCMSketch &&) = delete;
+
+  /**
+   * @brief Split a bucket into `depth` groups as evenly as possible
+   *
+   */
+  void splitBucket();
+  /**
+   * @brief Counter of row `i` in a bucket, picked by the lowest `slot_bits`
+   * of `bits` scaled to the size of the group
+   *
+   */
+  int32_t slot(int32_t i, uint64_t bits) const {
+    const int32_t fraction = bits & (slots - 1);
+    return group[i] + ((fraction * (group[i + 1] - group[i])) >> slot_bits);
+  }
+
+public:
+  /**
+   * @brief Construct by specifying depth and # buckets
+   *
+   * @param depth_      # counters of a key, at most 16 for 32-bit counters
+   * @param num_bucket_ # 64-byte buckets
+   * @param seeds       seeds of hashing classes; sketches built with the same
+   * seeds hash identically
+   */
+  BlockedCMSketch(int32_t depth_, int32_t num_bucket_,
+                  const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a sketch saved by save(), with buckets used in place
+   *
+   */
+  explicit BlockedCMSketch(const SnapshotReader &reader);
+  /**
+   * @brief Release the pointer
+   *
+   */
+  ~BlockedCMSketch();
+  /**
+   * @brief Update a flowkey with certain value
+   *
+   */
+  void update(const FlowKey<key_len> &flowkey, T val) override;
+  /**
+   * @brief Query a flowkey
+   *
+   */
+  T query(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<T, hash_t, reduce_t>("BlockedCMSketch", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed and the buckets
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
+  /**
+   * @brief Get the size of the sketch
+   *
+   */
+  size_t size() const override;
+  /**
+   * @brief Reset the sketch
+   *
+   */
+  void clear();
+};
+
+} // namespace OmniSketch::Sketch
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Sketch {
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+BlockedCMSketch<key_len, T, hash_t, reduce_t>::BlockedCMSketch(
+    int32_t depth_, int32_t num_bucket_, const Hash::SeedSequence &seeds)
+    : depth(depth_), num_bucket(reduce_t::adjust(num_bucket_)),
+      reduce(num_bucket), hash_fn(seeds.get<hash_t>(0)), seed(seeds.seed()) {
+  splitBucket();
+  bucket = new Bucket[num_bucket](); // Init with zero
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+BlockedCMSketch<key_len, T, hash_t, reduce_t>::BlockedCMSketch(
+    const SnapshotReader &reader)
+    : depth(reader.get<int32_t>("depth")),
+      num_bucket(reader.get<int32_t>("num_bucket")), reduce(num_bucket),
+      hash_fn(Hash::SeedSequence(reader.get<uint64_t>("seed")).get<hash_t>(0)),
+      seed(reader.get<uint64_t>("seed")),
+      bucket(reader.map<Bucket>("bucket", num_bucket)),
+      mapping(reader.handle()) {
+  splitBucket();
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+BlockedCMSketch<key_len, T, hash_t, reduce_t>::~BlockedCMSketch() {
+  if (!mapping)
+    delete[] bucket;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void BlockedCMSketch<key_len, T, hash_t, reduce_t>::splitBucket() {
+  if (depth <= 0 || depth > max_depth) {
+    throw std::out_of_range("Depth Out Of Range: Should be in [1, " +
+                            std::to_string(max_depth) + "], but got " +
+                            std::to_string(depth) + " instead.");
+  }
+  for (int32_t i = 0; i <= depth; ++i) {
+    group[i] = i * slots / depth;
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void BlockedCMSketch<key_len, T, hash_t, reduce_t>::update(
+    const FlowKey<key_len> &flowkey, T val) {
+  const uint64_t hashed = hash_fn(flowkey);
+  T *counter = bucket[reduce(hashed)].counter;
+  // remixed, so that counters picked do not correlate with the bucket
+  uint64_t bits = Hash::Remix(hashed);
+  for (int32_t i = 0; i < depth; ++i, bits >>= slot_bits) {
+    counter[slot(i, bits)] += val;
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+T BlockedCMSketch<key_len, T, hash_t, reduce_t>::query(
+    const FlowKey<key_len> &flowkey) const {
+  const uint64_t hashed = hash_fn(flowkey);
+  const T *counter = bucket[reduce(hashed)].counter;
+  uint64_t bits = Hash::Remix(hashed);
+  T min_val = std::numeric_limits<T>::max();
+  for (int32_t i = 0; i < depth; ++i, bits >>= slot_bits) {
+    min_val = std::min(min_val, counter[slot(i, bits)]);
+  }
+  return min_val;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void BlockedCMSketch<key_len, T, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("depth", depth);
+  writer.put("num_bucket", num_bucket);
+  writer.put("seed", seed);
+  writer.putBlob("bucket", bucket, sizeof(Bucket) * num_bucket);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+size_t BlockedCMSketch<key_len, T, hash_t, reduce_t>::size() const {
+  return sizeof(*this)                  // instance
+         + sizeof(Bucket) * num_bucket; // bucket
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void BlockedCMSketch<key_len, T, hash_t, reduce_t>::clear() {
+  std::fill(bucket, bucket + num_bucket, Bucket());
+}
+
+} // namespace OmniSketch::Sketch
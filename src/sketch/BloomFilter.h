@@ -8,11 +8,16 @@
  */
 #pragma once
 
+#include <common/bitset.h>
 #include <common/hash.h>
+#include <common/reduce.h>
 #include <common/sketch.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 
-#define BYTE(n) ((n) >> 3)
-#define BIT(n) ((n)&7)
+#define WORD(n) ((n) >> 6)
+#define BIT(n) ((n)&63)
 
 namespace OmniSketch::Sketch {
 /**
@@ -20,32 +25,106 @@ namespace OmniSketch::Sketch {
  *
  * @tparam key_len  length of flowkey
  * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
+ *
+ * @details In the double hashing mode, only two hashing classes are evaluated
+ * per flowkey and the `i`-th probing position is derived as `h1 + i * h2`.
+ * The false positive rate is asymptotically the same, while hashing is
+ * `num_hash / 2` times as cheap.
+ *
+ * In the concurrent mode, insertions set bits by `fetch_or` on 64-bit words,
+ * so insert(), insertBatch(), lookup() and lookupBatch() may be called by any
+ * number of threads at the same time without losing bits. Look-ups are
+ * wait-free, and see any subset of the insertions running alongside them.
+ * Otherwise bits are set by plain read-modify-writes, as cheap as on bytes.
+ *
+ * Filters of the same shape are combined word by word, by merge() into their
+ * union and by intersect() into their intersection, and cardinality()
+ * estimates # distinct flowkeys from the bits set alone. Filters of several
+ * shards or epochs are thus combined and counted without inserting any
+ * flowkey again.
+ *
+ * @see A. Kirsch, M. Mitzenmacher, Less Hashing, Same Performance: Building a
+ * Better Bloom Filter, ESA 2006.
+ * @see S. J. Swamidass, P. Baldi, Mathematical Correction for Fingerprint
+ * Similarity Measures to Improve Chemical Retrieval, J. Chem. Inf. Model.,
+ * 2007.
  */
-template <int32_t key_len, typename hash_t = Hash::AwareHash>
+template <int32_t key_len, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
 class BloomFilter : public SketchBase<key_len> {
 
 private:
   int32_t nbits;
   int32_t num_hash;
-  int32_t nbytes;
-  uint8_t *arr;
+  bool double_hashing;
+  bool concurrent;
+  int32_t num_hash_fns;
+  reduce_t reduce;
+  int32_t nwords;
+  std::atomic<uint64_t> *arr;
   hash_t *hash_fns;
+  uint64_t seed; // base seed of hashing classes
+  /// keeps bits mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
 
   BloomFilter(const BloomFilter &) = delete;
   BloomFilter(BloomFilter &&) = delete;
   BloomFilter &operator=(BloomFilter) = delete;
+  static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+                "std::atomic<uint64_t> should be laid out as uint64_t");
 
+  /**
+   * @brief Words of bits, for kernels that need no atomicity
+   *
+   */
+  uint64_t *words() { return reinterpret_cast<uint64_t *>(arr); }
+  /// @overload
+  const uint64_t *words() const {
+    return reinterpret_cast<const uint64_t *>(arr);
+  }
+  /**
+   * @brief Cast a filter to be combined, checking its shape and seed
+   *
+   */
+  const BloomFilter &mergeable(const SketchBase<key_len> &other) const;
   /**
    * @brief Set a bit
    *
    */
-  void setBit(int32_t pos) { arr[BYTE(pos)] |= (1 << BIT(pos)); }
+  void setBit(int32_t pos) {
+    std::atomic<uint64_t> &word = arr[WORD(pos)];
+    const uint64_t mask = uint64_t(1) << BIT(pos);
+    if (concurrent) {
+      word.fetch_or(mask, std::memory_order_relaxed);
+    } else {
+      word.store(word.load(std::memory_order_relaxed) | mask,
+                 std::memory_order_relaxed);
+    }
+  }
   /**
    * @brief Fetch a bit
    *
    * @return `true` if it is `1`; `false` otherwise.
    */
-  bool getBit(int32_t pos) const { return (arr[BYTE(pos)] >> BIT(pos)) & 1; }
+  bool getBit(int32_t pos) const {
+    return (arr[WORD(pos)].load(std::memory_order_relaxed) >> BIT(pos)) & 1;
+  }
+  /**
+   * @brief Hash a flowkey into `num_hash` values to be reduced to positions
+   *
+   */
+  void probe(const FlowKey<key_len> &flowkey, uint64_t *hashed) const {
+    if (!double_hashing) {
+      hash_t::multiHash(hash_fns, num_hash, flowkey, hashed);
+      return;
+    }
+    uint64_t base[2] = {0, 0};
+    hash_t::multiHash(hash_fns, num_hash_fns, flowkey, base);
+    for (int32_t i = 0; i < num_hash; ++i) {
+      hashed[i] = base[0] + i * base[1];
+    }
+  }
 
 public:
   /**
@@ -53,8 +132,19 @@ public:
    *
    * @param num_bits        # bit
    * @param num_hash_class  # hash classes
+   * @param double_hashing  whether to derive positions from two hash classes
+   * @param concurrent      whether threads may insert at the same time
+   * @param seeds           seeds of hashing classes; filters built with the
+   * same seeds hash identically
+   */
+  BloomFilter(int32_t num_bits, int32_t num_hash_class,
+              bool double_hashing = false, bool concurrent = false,
+              const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a filter saved by save(), with bits used in place
+   *
    */
-  BloomFilter(int32_t num_bits, int32_t num_hash_class);
+  explicit BloomFilter(const SnapshotReader &reader);
   /**
    * @brief Destructor
    *
@@ -63,16 +153,103 @@ public:
 
   /**
    * @brief Insert a flowkey into the bloom filter
-   * @details An overriding method
+   * @details An overriding method. Thread-safe in the concurrent mode.
    *
    */
   void insert(const FlowKey<key_len> &flowkey) override;
+  /**
+   * @brief Insert a batch of records
+   * @details An overriding method. A window of records is hashed and the
+   * words they set are prefetched before any of them is inserted. Thread-safe
+   * in the concurrent mode.
+   *
+   */
+  void insertBatch(const Data::Record<key_len> *records, size_t n) override;
   /**
    * @brief Look up a flowkey to see whether it exists
-   * @details An overriding method
+   * @details An overriding method. Wait-free.
    *
    */
   bool lookup(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Look up a batch of flowkeys
+   * @details An overriding method. A window of flowkeys is hashed and the
+   * words they read are prefetched before any of them is looked up. Wait-free.
+   *
+   */
+  void lookupBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                   bool *out) const override;
+  /**
+   * @brief Compute the positions of a flowkey once for insert() and lookup()
+   * @details A non-overriding method
+   *
+   * @param flowkey the flowkey
+   * @param ctx     filled with `num_hash` positions
+   */
+  void hash(const FlowKey<key_len> &flowkey, Hash::HashContext &ctx) const;
+  /**
+   * @brief Insert a flowkey whose positions have been computed by hash()
+   * @details A non-overriding method
+   *
+   */
+  void insert(const Hash::HashContext &ctx);
+  /**
+   * @brief Look up a flowkey whose positions have been computed by hash()
+   * @details A non-overriding method
+   *
+   */
+  bool lookup(const Hash::HashContext &ctx) const;
+  /**
+   * @brief Prefetch the words of a flowkey whose positions have been computed
+   * by hash()
+   * @details A non-overriding method
+   *
+   */
+  void prefetch(const Hash::HashContext &ctx) const;
+  /**
+   * @brief Merge a filter of the same size, probing mode and seeds
+   * @details An overriding method. Afterwards the filter holds flowkeys of
+   * both. Thread-safe in the concurrent mode, as far as this filter is
+   * concerned.
+   *
+   */
+  void merge(const SketchBase<key_len> &other) override;
+  /**
+   * @brief Intersect with a filter of the same size, probing mode and seeds
+   * @details A non-overriding method. Afterwards the filter holds flowkeys
+   * inserted into both, with a false positive rate no less than that of a
+   * filter they alone are inserted into. Thread-safe in the concurrent mode,
+   * as far as this filter is concerned.
+   *
+   */
+  void intersect(const SketchBase<key_len> &other);
+  /**
+   * @brief Estimate # distinct flowkeys inserted
+   * @details A non-overriding method. With `X` of the `m` bits set, the
+   * estimate is `-m / num_hash * ln(1 - X / m)`, which is infinite once all
+   * bits are set. Not to be called alongside insertions.
+   *
+   */
+  double cardinality() const;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<hash_t, reduce_t>("BloomFilter", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the size, the modes, the seed and the bits
+   * @details An overriding method. Not to be called alongside insertions.
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
   /**
    * @brief Size of the sketch
    * @details An overriding method
@@ -80,7 +257,7 @@ public:
   size_t size() const override;
   /**
    * @brief Reset the Bloom Filter
-   * @details A non-overriding method
+   * @details A non-overriding method. Not to be called alongside insertions.
    */
   void clear();
 };
@@ -95,37 +272,84 @@ public:
 
 namespace OmniSketch::Sketch {
 
-template <int32_t key_len, typename hash_t>
-BloomFilter<key_len, hash_t>::BloomFilter(int32_t num_bits,
-                                          int32_t num_hash_class)
-    : nbits(num_bits), num_hash(num_hash_class) {
-  nbits = Util::NextPrime(nbits);
-  nbytes = (nbits + 7) >> 3; // ceil(nbits / 8)
-  hash_fns = new hash_t[num_hash];
+template <int32_t key_len, typename hash_t, typename reduce_t>
+BloomFilter<key_len, hash_t, reduce_t>::BloomFilter(
+    int32_t num_bits, int32_t num_hash_class, bool double_hashing,
+    bool concurrent, const Hash::SeedSequence &seeds)
+    : nbits(reduce_t::adjust(num_bits)), num_hash(num_hash_class),
+      double_hashing(double_hashing), concurrent(concurrent),
+      num_hash_fns(double_hashing ? std::min(num_hash_class, 2)
+                                  : num_hash_class),
+      reduce(nbits), seed(seeds.seed()) {
+  nwords = (nbits + 63) >> 6; // ceil(nbits / 64)
+  hash_fns = seeds.make<hash_t>(num_hash_fns);
   // Allocate memory, zero initialized
-  arr = new uint8_t[nbytes]();
+  arr = new std::atomic<uint64_t>[nwords]();
 }
 
-template <int32_t key_len, typename hash_t>
-BloomFilter<key_len, hash_t>::~BloomFilter() {
+template <int32_t key_len, typename hash_t, typename reduce_t>
+BloomFilter<key_len, hash_t, reduce_t>::BloomFilter(
+    const SnapshotReader &reader)
+    : nbits(reader.get<int32_t>("nbits")),
+      num_hash(reader.get<int32_t>("num_hash")),
+      double_hashing(reader.get<bool>("double_hashing")),
+      concurrent(reader.get<bool>("concurrent")),
+      num_hash_fns(double_hashing ? std::min(num_hash, 2) : num_hash),
+      reduce(nbits), nwords((nbits + 63) >> 6),
+      arr(reader.map<std::atomic<uint64_t>>("arr", nwords)),
+      seed(reader.get<uint64_t>("seed")), mapping(reader.handle()) {
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(num_hash_fns);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+BloomFilter<key_len, hash_t, reduce_t>::~BloomFilter() {
   delete[] hash_fns;
-  delete[] arr;
+  if (!mapping)
+    delete[] arr;
 }
 
-template <int32_t key_len, typename hash_t>
-void BloomFilter<key_len, hash_t>::insert(const FlowKey<key_len> &flowkey) {
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::insert(
+    const FlowKey<key_len> &flowkey) {
+  uint64_t hashed[num_hash];
+  probe(flowkey, hashed);
   for (int32_t i = 0; i < num_hash; ++i) {
-    int32_t idx = hash_fns[i](flowkey) % nbits;
+    int32_t idx = reduce(hashed[i]);
     setBit(idx);
   }
 }
 
-template <int32_t key_len, typename hash_t>
-bool BloomFilter<key_len, hash_t>::lookup(
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::insertBatch(
+    const Data::Record<key_len> *records, size_t n) {
+  constexpr size_t window = SketchBase<key_len>::BATCH_WINDOW;
+  uint64_t hashed[num_hash];
+  int32_t indices[window * num_hash];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the words
+    for (size_t j = 0; j < m; ++j) {
+      probe(records[base + j].flowkey, hashed);
+      for (int32_t i = 0; i < num_hash; ++i) {
+        indices[j * num_hash + i] = reduce(hashed[i]);
+        __builtin_prefetch(arr + WORD(indices[j * num_hash + i]), 1);
+      }
+    }
+    // then set the bits
+    for (int32_t i = 0; i < static_cast<int32_t>(m) * num_hash; ++i) {
+      setBit(indices[i]);
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+bool BloomFilter<key_len, hash_t, reduce_t>::lookup(
     const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[num_hash];
+  probe(flowkey, hashed);
   // If every bit is on, return true
   for (int32_t i = 0; i < num_hash; ++i) {
-    int32_t idx = hash_fns[i](flowkey) % nbits;
+    int32_t idx = reduce(hashed[i]);
     if (!getBit(idx)) {
       return false;
     }
@@ -133,19 +357,143 @@ bool BloomFilter<key_len, hash_t>::lookup(
   return true;
 }
 
-template <int32_t key_len, typename hash_t>
-size_t BloomFilter<key_len, hash_t>::size() const {
-  return sizeof(*this)                // Instance
-         + nbytes * sizeof(uint8_t)   // arr
-         + num_hash * sizeof(hash_t); // hash_fns
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::lookupBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, bool *out) const {
+  constexpr size_t window = SketchBase<key_len>::BATCH_WINDOW;
+  uint64_t hashed[num_hash];
+  int32_t indices[window * num_hash];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the words
+    for (size_t j = 0; j < m; ++j) {
+      probe(flowkeys[base + j], hashed);
+      for (int32_t i = 0; i < num_hash; ++i) {
+        indices[j * num_hash + i] = reduce(hashed[i]);
+        __builtin_prefetch(arr + WORD(indices[j * num_hash + i]), 0);
+      }
+    }
+    // then check the bits
+    for (size_t j = 0; j < m; ++j) {
+      bool exist = true;
+      for (int32_t i = 0; i < num_hash && exist; ++i) {
+        exist = getBit(indices[j * num_hash + i]);
+      }
+      out[base + j] = exist;
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::hash(
+    const FlowKey<key_len> &flowkey, Hash::HashContext &ctx) const {
+  uint64_t hashed[num_hash];
+  probe(flowkey, hashed);
+  ctx.resize(num_hash);
+  for (int32_t i = 0; i < num_hash; ++i) {
+    ctx[i] = reduce(hashed[i]);
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::insert(
+    const Hash::HashContext &ctx) {
+  for (int32_t i = 0; i < num_hash; ++i) {
+    setBit(ctx[i]);
+  }
 }
 
-template <int32_t key_len, typename hash_t>
-void BloomFilter<key_len, hash_t>::clear() {
-  std::fill(arr, arr + nbytes, 0);
+template <int32_t key_len, typename hash_t, typename reduce_t>
+bool BloomFilter<key_len, hash_t, reduce_t>::lookup(
+    const Hash::HashContext &ctx) const {
+  for (int32_t i = 0; i < num_hash; ++i) {
+    if (!getBit(ctx[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::prefetch(
+    const Hash::HashContext &ctx) const {
+  for (int32_t i = 0; i < num_hash; ++i) {
+    __builtin_prefetch(arr + WORD(ctx[i]), 1);
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+const BloomFilter<key_len, hash_t, reduce_t> &
+BloomFilter<key_len, hash_t, reduce_t>::mergeable(
+    const SketchBase<key_len> &other) const {
+  const auto &filter = MergeCast<BloomFilter>(other);
+  CheckMergeable("# bits", nbits, filter.nbits);
+  CheckMergeable("# hash", num_hash, filter.num_hash);
+  CheckMergeable("double hashing", double_hashing, filter.double_hashing);
+  CheckMergeable("seed", seed, filter.seed);
+  return filter;
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::merge(
+    const SketchBase<key_len> &other) {
+  const auto &filter = mergeable(other);
+  if (!concurrent) {
+    BitwiseOr(words(), filter.words(), nwords);
+    return;
+  }
+  for (int32_t i = 0; i < nwords; ++i) {
+    arr[i].fetch_or(filter.arr[i].load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::intersect(
+    const SketchBase<key_len> &other) {
+  const auto &filter = mergeable(other);
+  if (!concurrent) {
+    BitwiseAnd(words(), filter.words(), nwords);
+    return;
+  }
+  for (int32_t i = 0; i < nwords; ++i) {
+    arr[i].fetch_and(filter.arr[i].load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+double BloomFilter<key_len, hash_t, reduce_t>::cardinality() const {
+  const double set = PopCount(words(), nwords);
+  return -static_cast<double>(nbits) / num_hash * std::log1p(-set / nbits);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("nbits", nbits);
+  writer.put("num_hash", num_hash);
+  writer.put("double_hashing", double_hashing);
+  writer.put("concurrent", concurrent);
+  writer.put("seed", seed);
+  writer.putBlob("arr", arr, sizeof(std::atomic<uint64_t>) * nwords);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+size_t BloomFilter<key_len, hash_t, reduce_t>::size() const {
+  return sizeof(*this)                            // Instance
+         + nwords * sizeof(std::atomic<uint64_t>) // arr
+         + num_hash_fns * sizeof(hash_t);         // hash_fns
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void BloomFilter<key_len, hash_t, reduce_t>::clear() {
+  for (int32_t i = 0; i < nwords; ++i) {
+    arr[i].store(0, std::memory_order_relaxed);
+  }
 }
 
 } // namespace OmniSketch::Sketch
 
-#undef BYTE
+#undef WORD
 #undef BIT
\ No newline at end of file
@@ -10,6 +10,7 @@
 
 #include <common/hash.h>
 #include <common/hierarchy.h>
+#include <common/reduce.h>
 #include <common/sketch.h>
 
 namespace OmniSketch::Sketch {
@@ -20,19 +21,23 @@ namespace OmniSketch::Sketch {
  * @tparam no_layer layer of CH
  * @tparam T        type of the counter
  * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
  */
 template <int32_t key_len, int32_t no_layer, typename T,
-          typename hash_t = Hash::AwareHash>
+          typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
 class CHCMSketch : public SketchBase<key_len, T> {
 private:
   int32_t depth;
   int32_t width;
+  reduce_t reduce;
 
   std::vector<size_t> no_cnt;
   std::vector<size_t> width_cnt;
   std::vector<size_t> no_hash;
 
   hash_t *hash_fns;
+  uint64_t seed; // base seed of hashing classes
   CounterHierarchy<no_layer, T, hash_t> *ch;
 
   CHCMSketch(const CHCMSketch &) = delete;
@@ -48,11 +53,20 @@ public:
    * (should be in (0, 1))
    * @param width_cnt   Width of counters on each layer
    * @param no_hash     #hash between adjacent layers
+   * @param seeds       seeds of hashing classes; sketches built with the same
+   * seeds hash identically
    *
    */
   CHCMSketch(int32_t depth, int32_t width, double cnt_no_ratio,
              const std::vector<size_t> &width_cnt,
-             const std::vector<size_t> &no_hash);
+             const std::vector<size_t> &no_hash,
+             const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a sketch saved by save()
+   * @details CH is copied out of the snapshot, see CounterHierarchy.
+   *
+   */
+  explicit CHCMSketch(const SnapshotReader &reader);
   /**
    * @brief Release the pointer
    *
@@ -68,6 +82,32 @@ public:
    *
    */
   T query(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Query a batch of flowkeys
+   * @details A window of flowkeys is hashed and the counters they read from
+   * the lowest layer are prefetched before any of them is queried.
+   *
+   */
+  void queryBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                  T *out) const override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<T, hash_t, reduce_t>("CHCMSketch", key_len, no_layer);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed and CH
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
   /**
    * @brief Get the size of the sketch
    *
@@ -90,14 +130,16 @@ public:
 
 namespace OmniSketch::Sketch {
 
-template <int32_t key_len, int32_t no_layer, typename T, typename hash_t>
-CHCMSketch<key_len, no_layer, T, hash_t>::CHCMSketch(
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::CHCMSketch(
     int32_t depth, int32_t width, double cnt_no_ratio,
-    const std::vector<size_t> &width_cnt, const std::vector<size_t> &no_hash)
-    : depth(depth), width(Util::NextPrime(width)), ch(nullptr),
-      width_cnt(width_cnt), no_hash(no_hash) {
+    const std::vector<size_t> &width_cnt, const std::vector<size_t> &no_hash,
+    const Hash::SeedSequence &seeds)
+    : depth(depth), width(reduce_t::adjust(width)), reduce(this->width),
+      ch(nullptr), width_cnt(width_cnt), no_hash(no_hash), seed(seeds.seed()) {
 
-  hash_fns = new hash_t[this->depth];
+  hash_fns = seeds.make<hash_t>(this->depth);
   // check ratio
   if (cnt_no_ratio <= 0.0 || cnt_no_ratio >= 1.0) {
     throw std::out_of_range("Out of Range: Ratio of #counters of adjacent "
@@ -112,44 +154,106 @@ CHCMSketch<key_len, no_layer, T, hash_t>::CHCMSketch(
   }
   // CH
   ch = new CounterHierarchy<no_layer, T, hash_t>(no_cnt, this->width_cnt,
-                                                 this->no_hash);
+                                                 this->no_hash, seeds.fork(1));
+}
+
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::CHCMSketch(
+    const SnapshotReader &reader)
+    : depth(reader.get<int32_t>("depth")), width(reader.get<int32_t>("width")),
+      reduce(width), no_cnt(reader.sub("ch").getVector<size_t>("no_cnt")),
+      width_cnt(reader.sub("ch").getVector<size_t>("width_cnt")),
+      no_hash(reader.sub("ch").getVector<size_t>("no_hash")),
+      seed(reader.get<uint64_t>("seed")) {
+
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(depth);
+  ch = new CounterHierarchy<no_layer, T, hash_t>(reader.sub("ch"));
 }
 
-template <int32_t key_len, int32_t no_layer, typename T, typename hash_t>
-CHCMSketch<key_len, no_layer, T, hash_t>::~CHCMSketch() {
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::~CHCMSketch() {
   delete[] hash_fns;
-  delete[] ch;
+  delete ch;
 }
 
-template <int32_t key_len, int32_t no_layer, typename T, typename hash_t>
-void CHCMSketch<key_len, no_layer, T, hash_t>::update(
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+void CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::update(
     const FlowKey<key_len> &flowkey, T val) {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
   for (int32_t i = 0; i < depth; ++i) {
-    int32_t index = hash_fns[i](flowkey) % width;
+    int32_t index = reduce(hashed[i]);
     ch->updateCnt(i * width + index, val);
   }
 }
 
-template <int32_t key_len, int32_t no_layer, typename T, typename hash_t>
-T CHCMSketch<key_len, no_layer, T, hash_t>::query(
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+T CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::query(
     const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
   T min_val = std::numeric_limits<T>::max();
   for (int32_t i = 0; i < depth; ++i) {
-    int32_t index = hash_fns[i](flowkey) % width;
+    int32_t index = reduce(hashed[i]);
     min_val = std::min(min_val, ch->getCnt(i * width + index));
   }
   return min_val;
 }
 
-template <int32_t key_len, int32_t no_layer, typename T, typename hash_t>
-size_t CHCMSketch<key_len, no_layer, T, hash_t>::size() const {
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+void CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::queryBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, T *out) const {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  uint64_t hashed[depth];
+  int32_t indices[window * depth];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the counters
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, depth, flowkeys[base + j], hashed);
+      for (int32_t i = 0; i < depth; ++i) {
+        indices[j * depth + i] = i * width + reduce(hashed[i]);
+        ch->prefetchCnt(indices[j * depth + i]);
+      }
+    }
+    // then query
+    for (size_t j = 0; j < m; ++j) {
+      T min_val = std::numeric_limits<T>::max();
+      for (int32_t i = 0; i < depth; ++i) {
+        min_val = std::min(min_val, ch->getCnt(indices[j * depth + i]));
+      }
+      out[base + j] = min_val;
+    }
+  }
+}
+
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+void CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("depth", depth);
+  writer.put("width", width);
+  writer.put("seed", seed);
+  SnapshotWriter sub = writer.sub("ch");
+  ch->save(sub);
+}
+
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+size_t CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::size() const {
   return sizeof(*this)            // instance
          + depth * sizeof(hash_t) // hashing class
          + ch->size();            // ch
 }
 
-template <int32_t key_len, int32_t no_layer, typename T, typename hash_t>
-void CHCMSketch<key_len, no_layer, T, hash_t>::clear() {
+template <int32_t key_len, int32_t no_layer, typename T, typename hash_t,
+          typename reduce_t>
+void CHCMSketch<key_len, no_layer, T, hash_t, reduce_t>::clear() {
   ch->clear();
 }
 
@@ -8,34 +8,74 @@
  */
 #pragma once
 
+#include <common/counter.h>
 #include <common/hash.h>
+#include <common/reduce.h>
 #include <common/sketch.h>
+#include <common/topk.h>
 
 namespace OmniSketch::Sketch {
 /**
  * @brief Count Min Sketch
  *
- * @tparam key_len  length of flowkey
- * @tparam T        type of the counter
- * @tparam hash_t   hashing class
+ * @tparam key_len   length of flowkey
+ * @tparam T         type of the counter
+ * @tparam hash_t    hashing class
+ * @tparam reduce_t  reduction policy
+ * @tparam counter_t type of the counters stored, being `T` by default.
+ * Narrower integers save memory but saturate.
  */
-template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash>
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod, typename counter_t = T>
 class CMSketch : public SketchBase<key_len, T> {
 private:
   int32_t depth;
   int32_t width;
+  reduce_t reduce;
   hash_t *hash_fns;
-  T **counter;
+  uint64_t seed; // base seed of hashing classes
+  CounterArray<T, counter_t> counter;
+  TopK<key_len, T> topk; // flowkeys of the largest estimates
 
   CMSketch(const CMSketch &) = delete;
   CMSketch(CMSketch &&) = delete;
 
+  /**
+   * @brief Cast a sketch to be merged, checking its dimensions and seed
+   *
+   */
+  const CMSketch &mergeable(const SketchBase<key_len, T> &other) const;
+  /**
+   * @brief Change of a flowkey against another sketch, estimated row by row
+   * @details Both sketches overestimate, so the noise in the difference of a
+   * row may go either way. The absolute median of row differences is thus
+   * taken rather than the minimum. Differences are signed, and are taken in
+   * `int64_t` for unsigned `T` so as not to wrap around.
+   *
+   */
+  T change(const CMSketch &other, const FlowKey<key_len> &flowkey) const;
+
 public:
   /**
    * @brief Construct by specifying depth and width
    *
+   * @param depth_    depth of the sketch
+   * @param width_    width of the sketch
+   * @param escalate  whether to keep what saturated counters cannot hold in a
+   * side table
+   * @param top_k     # flowkeys of the largest estimates tracked during
+   * updates for getHeavyHitter(), or 0 not to track any
+   * @param seeds     seeds of hashing classes; sketches built with the same
+   * seeds hash identically
    */
-  CMSketch(int32_t depth_, int32_t width_);
+  CMSketch(int32_t depth_, int32_t width_, bool escalate = false,
+           int32_t top_k = 0,
+           const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a sketch saved by save(), with counters used in place
+   *
+   */
+  explicit CMSketch(const SnapshotReader &reader);
   /**
    * @brief Release the pointer
    *
@@ -46,11 +86,76 @@ public:
    *
    */
   void update(const FlowKey<key_len> &flowkey, T val) override;
+  /**
+   * @brief Update a batch of records
+   * @details A window of records is hashed and the counters they touch are
+   * prefetched before any of them is updated.
+   *
+   */
+  void updateBatch(const Data::Record<key_len> *records, size_t n,
+                   Data::CntMethod cnt_method) override;
   /**
    * @brief Query a flowkey
    *
    */
   T query(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Query a batch of flowkeys
+   * @details A window of flowkeys is hashed and the counters they read are
+   * prefetched before any of them is queried.
+   *
+   */
+  void queryBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                  T *out) const override;
+  /**
+   * @brief Heavy hitters among the flowkeys tracked
+   * @details Tracked flowkeys are queried afresh, and those of estimates no
+   * less than `threshold` are reported. Nothing is reported unless the sketch
+   * is constructed with a positive `top_k`.
+   *
+   */
+  Data::Estimation<key_len, T> getHeavyHitter(double threshold) const override;
+  /**
+   * @brief Heavy changers among the flowkeys tracked by either sketch
+   * @details The change of a flowkey is estimated from the counters of both
+   * sketches in one pass over the rows, without building a sketch of their
+   * difference. Nothing is reported unless the sketches are constructed with
+   * a positive `top_k`.
+   *
+   */
+  Data::Estimation<key_len, T>
+  getHeavyChanger(std::unique_ptr<SketchBase<key_len, T>> &ptr_sketch,
+                  double threshold) const override;
+  /**
+   * @brief Merge a sketch of the same dimensions and seeds
+   * @details Flowkeys tracked by either sketch are tracked afresh.
+   *
+   */
+  void merge(const SketchBase<key_len, T> &other) override;
+  /**
+   * @brief Subtract a sketch of the same dimensions and seeds
+   * @details Flowkeys tracked by either sketch are tracked afresh.
+   *
+   */
+  void subtract(const SketchBase<key_len, T> &other) override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<T, hash_t, reduce_t, counter_t>("CMSketch", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed and the counters
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
   /**
    * @brief Get the size of the sketch
    *
@@ -73,55 +178,230 @@ public:
 
 namespace OmniSketch::Sketch {
 
-template <int32_t key_len, typename T, typename hash_t>
-CMSketch<key_len, T, hash_t>::CMSketch(int32_t depth_, int32_t width_)
-    : depth(depth_), width(Util::NextPrime(width_)) {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+CMSketch<key_len, T, hash_t, reduce_t, counter_t>::CMSketch(
+    int32_t depth_, int32_t width_, bool escalate, int32_t top_k,
+    const Hash::SeedSequence &seeds)
+    : depth(depth_), width(reduce_t::adjust(width_)), reduce(width),
+      seed(seeds.seed()), counter(depth, width, escalate), topk(top_k) {
 
-  hash_fns = new hash_t[depth];
-  // Allocate continuous memory
-  counter = new T *[depth];
-  counter[0] = new T[depth * width](); // Init with zero
-  for (int32_t i = 1; i < depth; ++i) {
-    counter[i] = counter[i - 1] + width;
-  }
+  hash_fns = seeds.make<hash_t>(depth);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+CMSketch<key_len, T, hash_t, reduce_t, counter_t>::CMSketch(
+    const SnapshotReader &reader)
+    : depth(reader.get<int32_t>("depth")), width(reader.get<int32_t>("width")),
+      reduce(width), seed(reader.get<uint64_t>("seed")),
+      counter(depth, width, reader.sub("counter")),
+      topk(reader.sub("topk")) {
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(depth);
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-CMSketch<key_len, T, hash_t>::~CMSketch() {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+CMSketch<key_len, T, hash_t, reduce_t, counter_t>::~CMSketch() {
   delete[] hash_fns;
-  delete[] counter[0];
-  delete[] counter;
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-void CMSketch<key_len, T, hash_t>::update(const FlowKey<key_len> &flowkey,
-                                          T val) {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CMSketch<key_len, T, hash_t, reduce_t, counter_t>::update(
+    const FlowKey<key_len> &flowkey, T val) {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  int32_t indices[depth];
   for (int32_t i = 0; i < depth; ++i) {
-    int32_t index = hash_fns[i](flowkey) % width;
-    counter[i][index] += val;
+    indices[i] = reduce(hashed[i]);
+    counter.add(i, indices[i], val);
+  }
+  if (topk.enabled()) {
+    topk.offer(flowkey, counter.min(indices));
   }
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-T CMSketch<key_len, T, hash_t>::query(const FlowKey<key_len> &flowkey) const {
-  T min_val = std::numeric_limits<T>::max();
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CMSketch<key_len, T, hash_t, reduce_t, counter_t>::updateBatch(
+    const Data::Record<key_len> *records, size_t n,
+    Data::CntMethod cnt_method) {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  uint64_t hashed[depth];
+  int32_t indices[window * depth];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the counters
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, depth, records[base + j].flowkey, hashed);
+      for (int32_t i = 0; i < depth; ++i) {
+        indices[j * depth + i] = reduce(hashed[i]);
+        counter.prefetch(i, indices[j * depth + i]);
+      }
+    }
+    // then update
+    for (size_t j = 0; j < m; ++j) {
+      const T val =
+          cnt_method == Data::InLength ? records[base + j].length : 1;
+      for (int32_t i = 0; i < depth; ++i) {
+        counter.add(i, indices[j * depth + i], val);
+      }
+      if (topk.enabled()) {
+        topk.offer(records[base + j].flowkey, counter.min(indices + j * depth));
+      }
+    }
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+T CMSketch<key_len, T, hash_t, reduce_t, counter_t>::query(
+    const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  int32_t indices[depth];
   for (int32_t i = 0; i < depth; ++i) {
-    int32_t index = hash_fns[i](flowkey) % width;
-    min_val = std::min(min_val, counter[i][index]);
+    indices[i] = reduce(hashed[i]);
+  }
+  return counter.min(indices);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CMSketch<key_len, T, hash_t, reduce_t, counter_t>::queryBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, T *out) const {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  uint64_t hashed[depth];
+  int32_t indices[window * depth];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the counters
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, depth, flowkeys[base + j], hashed);
+      for (int32_t i = 0; i < depth; ++i) {
+        indices[j * depth + i] = reduce(hashed[i]);
+        counter.prefetch(i, indices[j * depth + i], false);
+      }
+    }
+    // then query
+    for (size_t j = 0; j < m; ++j) {
+      out[base + j] = counter.min(indices + j * depth);
+    }
   }
-  return min_val;
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-size_t CMSketch<key_len, T, hash_t>::size() const {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+Data::Estimation<key_len, T>
+CMSketch<key_len, T, hash_t, reduce_t, counter_t>::getHeavyHitter(
+    double threshold) const {
+  Data::Estimation<key_len, T> heavy_hitters;
+  for (const auto &entry : topk.entries()) {
+    const T val = query(entry.flowkey);
+    if (val >= threshold) {
+      heavy_hitters[entry.flowkey] = val;
+    }
+  }
+  return heavy_hitters;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+Data::Estimation<key_len, T>
+CMSketch<key_len, T, hash_t, reduce_t, counter_t>::getHeavyChanger(
+    std::unique_ptr<SketchBase<key_len, T>> &ptr_sketch,
+    double threshold) const {
+  const auto &sketch = mergeable(*ptr_sketch);
+  Data::Estimation<key_len, T> heavy_changers;
+  for (const auto *tracker : {&topk, &sketch.topk}) {
+    for (const auto &entry : tracker->entries()) {
+      if (heavy_changers.count(entry.flowkey)) {
+        continue;
+      }
+      const T val = change(sketch, entry.flowkey);
+      if (val >= threshold) {
+        heavy_changers[entry.flowkey] = val;
+      }
+    }
+  }
+  return heavy_changers;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CMSketch<key_len, T, hash_t, reduce_t, counter_t>::merge(
+    const SketchBase<key_len, T> &other) {
+  const auto &sketch = mergeable(other);
+  counter.merge(sketch.counter);
+  topk.retrack(sketch.topk, [this](const auto &key) { return query(key); });
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CMSketch<key_len, T, hash_t, reduce_t, counter_t>::subtract(
+    const SketchBase<key_len, T> &other) {
+  const auto &sketch = mergeable(other);
+  counter.subtract(sketch.counter);
+  topk.setTurnstile(); // estimates may fall from now on
+  topk.retrack(sketch.topk, [this](const auto &key) { return query(key); });
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+const CMSketch<key_len, T, hash_t, reduce_t, counter_t> &
+CMSketch<key_len, T, hash_t, reduce_t, counter_t>::mergeable(
+    const SketchBase<key_len, T> &other) const {
+  const auto &sketch = MergeCast<CMSketch>(other);
+  CheckMergeable("depth", depth, sketch.depth);
+  CheckMergeable("width", width, sketch.width);
+  CheckMergeable("seed", seed, sketch.seed);
+  return sketch;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+T CMSketch<key_len, T, hash_t, reduce_t, counter_t>::change(
+    const CMSketch &other, const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  using diff_t = std::conditional_t<std::is_signed_v<T>, T, int64_t>;
+  diff_t diffs[depth];
+  for (int32_t i = 0; i < depth; ++i) {
+    const int32_t index = reduce(hashed[i]);
+    diffs[i] = static_cast<diff_t>(counter.get(i, index)) -
+               static_cast<diff_t>(other.counter.get(i, index));
+  }
+  return static_cast<T>(std::abs(Util::Median(diffs, depth)));
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CMSketch<key_len, T, hash_t, reduce_t, counter_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("depth", depth);
+  writer.put("width", width);
+  writer.put("seed", seed);
+  SnapshotWriter sub = writer.sub("counter");
+  counter.save(sub);
+  sub = writer.sub("topk");
+  topk.save(sub);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+size_t CMSketch<key_len, T, hash_t, reduce_t, counter_t>::size() const {
   return sizeof(*this)                // instance
          + sizeof(hash_t) * depth     // hashing class
-         + sizeof(T) * depth * width; // counter
+         + counter.size()             // counter
+         + topk.size();               // top-k tracker
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-void CMSketch<key_len, T, hash_t>::clear() {
-  std::fill(counter[0], counter[0] + depth * width, 0);
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CMSketch<key_len, T, hash_t, reduce_t, counter_t>::clear() {
+  counter.clear();
+  topk.clear();
 }
 
 } // namespace OmniSketch::Sketch
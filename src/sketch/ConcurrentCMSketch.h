@@ -0,0 +1,263 @@
+/**
+ * @file ConcurrentCMSketch.h
+ * @author dromniscience (you@domain.com)
+ * @brief Implementation of Concurrent Count Min Sketch
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/counter.h>
+#include <common/hash.h>
+#include <common/reduce.h>
+#include <common/sketch.h>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief Count Min Sketch whose counters are shared by threads
+ *
+ * @details Counters are atomic, so update(), updateBatch() and query() may be
+ * called by any number of threads at the same time, with a query seeing any
+ * subset of the updates running alongside it. With a positive `buffer_size`,
+ * each call of updateBatch() combines additions to the same counter in a
+ * buffer of its own, which is flushed every `flush_interval` records and on
+ * return. This relieves contention on counters of heavy hitters, at the
+ * expense of queries lagging behind by up to `flush_interval` records per
+ * thread.
+ *
+ * @tparam key_len  length of flowkey
+ * @tparam T        type of the counter
+ * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
+ */
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
+class ConcurrentCMSketch : public SketchBase<key_len, T> {
+private:
+  int32_t depth;
+  int32_t width;
+  int32_t buffer_size;
+  int32_t flush_interval;
+  reduce_t reduce;
+  hash_t *hash_fns;
+  uint64_t seed; // base seed of hashing classes
+  AtomicCounterArray<T> counter;
+
+  ConcurrentCMSketch(const ConcurrentCMSketch &) = delete;
+  ConcurrentCMSketch(ConcurrentCMSketch &&) = delete;
+
+public:
+  /**
+   * @brief Construct by specifying depth and width
+   *
+   * @param depth_          depth of the sketch
+   * @param width_          width of the sketch
+   * @param buffer_size_    # slots of the write-combining buffer of each
+   * thread, or 0 to add to counters at once
+   * @param flush_interval_ # records after which a buffer is flushed
+   * @param seeds           seeds of hashing classes; sketches built with the
+   * same seeds hash identically
+   */
+  ConcurrentCMSketch(int32_t depth_, int32_t width_, int32_t buffer_size_ = 0,
+                     int32_t flush_interval_ = 1024,
+                     const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a sketch saved by save(), with counters used in place
+   *
+   */
+  explicit ConcurrentCMSketch(const SnapshotReader &reader);
+  /**
+   * @brief Release the pointer
+   *
+   */
+  ~ConcurrentCMSketch();
+  /**
+   * @brief Update a flowkey with certain value
+   * @details Thread-safe. Counters are added to at once.
+   *
+   */
+  void update(const FlowKey<key_len> &flowkey, T val) override;
+  /**
+   * @brief Update a batch of records
+   * @details Thread-safe. A window of records is hashed and the counters they
+   * touch are prefetched before any of them is updated, through the
+   * write-combining buffer if there is one.
+   *
+   */
+  void updateBatch(const Data::Record<key_len> *records, size_t n,
+                   Data::CntMethod cnt_method) override;
+  /**
+   * @brief Query a flowkey
+   * @details Thread-safe.
+   *
+   */
+  T query(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<T, hash_t, reduce_t>("ConcurrentCMSketch", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed and the counters
+   * @details Not to be called alongside updates.
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
+  /**
+   * @brief Get the size of the sketch
+   * @details Buffers live only during updateBatch(), and are left out.
+   *
+   */
+  size_t size() const override;
+  /**
+   * @brief Reset the sketch
+   * @details Not to be called alongside updates.
+   *
+   */
+  void clear();
+};
+
+} // namespace OmniSketch::Sketch
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Sketch {
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::ConcurrentCMSketch(
+    int32_t depth_, int32_t width_, int32_t buffer_size_,
+    int32_t flush_interval_, const Hash::SeedSequence &seeds)
+    : depth(depth_), width(reduce_t::adjust(width_)),
+      buffer_size(buffer_size_), flush_interval(flush_interval_),
+      reduce(width), seed(seeds.seed()), counter(depth, width) {
+  if (buffer_size < 0) {
+    throw std::out_of_range(
+        "Buffer Size Out Of Range: Should be non-negative, but got " +
+        std::to_string(buffer_size) + " instead.");
+  }
+  if (flush_interval <= 0) {
+    throw std::out_of_range(
+        "Flush Interval Out Of Range: Should be positive, but got " +
+        std::to_string(flush_interval) + " instead.");
+  }
+  hash_fns = seeds.make<hash_t>(depth);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::ConcurrentCMSketch(
+    const SnapshotReader &reader)
+    : depth(reader.get<int32_t>("depth")), width(reader.get<int32_t>("width")),
+      buffer_size(reader.get<int32_t>("buffer_size")),
+      flush_interval(reader.get<int32_t>("flush_interval")), reduce(width),
+      seed(reader.get<uint64_t>("seed")),
+      counter(depth, width, reader.sub("counter")) {
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(depth);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::~ConcurrentCMSketch() {
+  delete[] hash_fns;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::update(
+    const FlowKey<key_len> &flowkey, T val) {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  for (int32_t i = 0; i < depth; ++i) {
+    counter.add(i, reduce(hashed[i]), val);
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::updateBatch(
+    const Data::Record<key_len> *records, size_t n,
+    Data::CntMethod cnt_method) {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  std::unique_ptr<typename AtomicCounterArray<T>::Buffer> buffer;
+  if (buffer_size)
+    buffer.reset(new typename AtomicCounterArray<T>::Buffer(counter,
+                                                              buffer_size));
+  uint64_t hashed[depth];
+  int32_t indices[window * depth];
+  size_t unflushed = 0;
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the counters
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, depth, records[base + j].flowkey, hashed);
+      for (int32_t i = 0; i < depth; ++i) {
+        indices[j * depth + i] = reduce(hashed[i]);
+        counter.prefetch(i, indices[j * depth + i]);
+      }
+    }
+    // then update
+    for (size_t j = 0; j < m; ++j) {
+      const T val =
+          cnt_method == Data::InLength ? records[base + j].length : 1;
+      for (int32_t i = 0; i < depth; ++i) {
+        if (buffer)
+          buffer->add(i, indices[j * depth + i], val);
+        else
+          counter.add(i, indices[j * depth + i], val);
+      }
+    }
+    unflushed += m;
+    if (buffer && unflushed >= static_cast<size_t>(flush_interval)) {
+      buffer->flush();
+      unflushed = 0;
+    }
+  }
+  // the buffer flushes the rest on destruction
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+T ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::query(
+    const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  T min_val = std::numeric_limits<T>::max();
+  for (int32_t i = 0; i < depth; ++i) {
+    min_val = std::min(min_val, counter.get(i, reduce(hashed[i])));
+  }
+  return min_val;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("depth", depth);
+  writer.put("width", width);
+  writer.put("buffer_size", buffer_size);
+  writer.put("flush_interval", flush_interval);
+  writer.put("seed", seed);
+  SnapshotWriter sub = writer.sub("counter");
+  counter.save(sub);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+size_t ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::size() const {
+  return sizeof(*this)            // instance
+         + sizeof(hash_t) * depth // hashing class
+         + counter.size();        // counter
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCMSketch<key_len, T, hash_t, reduce_t>::clear() {
+  counter.clear();
+}
+
+} // namespace OmniSketch::Sketch
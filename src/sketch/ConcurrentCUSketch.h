@@ -0,0 +1,254 @@
+/**
+ * @file ConcurrentCUSketch.h
+ * @author dromniscience (you@domain.com)
+ * @brief Implementation of Concurrent CU Sketch
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/counter.h>
+#include <common/hash.h>
+#include <common/reduce.h>
+#include <common/sketch.h>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief CU Sketch whose counters are shared by threads
+ *
+ * @details Counters are atomic, so update(), updateBatch() and query() may be
+ * called by any number of threads at the same time. An update reads the
+ * counters of a key once to get the target `min + val`, and then raises each
+ * counter below the target to it by a compare-and-swap loop, which gives up
+ * as soon as a concurrent update has raised the counter to the target or
+ * above. The target is never recomputed, so an update adds `val` at most once
+ * to each counter, which thus stays at or below its value in a Count Min
+ * Sketch of the same stream; and every counter of a key ends up at least
+ * `min + val`, so queries still never underestimate as with CUSketch. Updated
+ * by a single thread, the sketch is identical to a CUSketch of the same
+ * seeds.
+ *
+ * @tparam key_len  length of flowkey
+ * @tparam T        type of the counter
+ * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
+ */
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
+class ConcurrentCUSketch : public SketchBase<key_len, T> {
+private:
+  int32_t depth;
+  int32_t width;
+  reduce_t reduce;
+  hash_t *hash_fns;
+  uint64_t seed; // base seed of hashing classes
+  AtomicCounterArray<T> counter;
+
+  ConcurrentCUSketch(const ConcurrentCUSketch &) = delete;
+  ConcurrentCUSketch(ConcurrentCUSketch &&) = delete;
+
+  /**
+   * @brief Conservatively update the counters of a flowkey
+   *
+   * @param indices index of the flowkey on each row
+   * @param val     value to update
+   */
+  void raise(const int32_t *indices, T val);
+
+public:
+  /**
+   * @brief Construct by specifying depth and width
+   *
+   * @param depth_  depth of the sketch
+   * @param width_  width of the sketch
+   * @param seeds   seeds of hashing classes; sketches built with the same
+   * seeds hash identically
+   */
+  ConcurrentCUSketch(int32_t depth_, int32_t width_,
+                     const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a sketch saved by save(), with counters used in place
+   *
+   */
+  explicit ConcurrentCUSketch(const SnapshotReader &reader);
+  /**
+   * @brief Release the pointer
+   *
+   */
+  ~ConcurrentCUSketch();
+  /**
+   * @brief Update a flowkey with certain value
+   * @details Thread-safe.
+   *
+   */
+  void update(const FlowKey<key_len> &flowkey, T val) override;
+  /**
+   * @brief Update a batch of records
+   * @details Thread-safe. A window of records is hashed and the counters they
+   * touch are prefetched before any of them is updated.
+   *
+   */
+  void updateBatch(const Data::Record<key_len> *records, size_t n,
+                   Data::CntMethod cnt_method) override;
+  /**
+   * @brief Query a flowkey
+   * @details Thread-safe.
+   *
+   */
+  T query(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<T, hash_t, reduce_t>("ConcurrentCUSketch", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed and the counters
+   * @details Not to be called alongside updates.
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
+  /**
+   * @brief Get the size of the sketch
+   *
+   */
+  size_t size() const override;
+  /**
+   * @brief Reset the sketch
+   * @details Not to be called alongside updates.
+   *
+   */
+  void clear();
+};
+
+} // namespace OmniSketch::Sketch
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Sketch {
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::ConcurrentCUSketch(
+    int32_t depth_, int32_t width_, const Hash::SeedSequence &seeds)
+    : depth(depth_), width(reduce_t::adjust(width_)), reduce(width),
+      seed(seeds.seed()), counter(depth, width) {
+
+  hash_fns = seeds.make<hash_t>(depth);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::ConcurrentCUSketch(
+    const SnapshotReader &reader)
+    : depth(reader.get<int32_t>("depth")), width(reader.get<int32_t>("width")),
+      reduce(width), seed(reader.get<uint64_t>("seed")),
+      counter(depth, width, reader.sub("counter")) {
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(depth);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::~ConcurrentCUSketch() {
+  delete[] hash_fns;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::raise(
+    const int32_t *indices, T val) {
+  T values[depth];
+  T min_val = std::numeric_limits<T>::max();
+  for (int32_t i = 0; i < depth; ++i) {
+    values[i] = counter.get(i, indices[i]);
+    min_val = std::min(min_val, values[i]);
+  }
+  const T target = min_val + val;
+  for (int32_t i = 0; i < depth; ++i) {
+    // a failed swap reloads the counter, which may have reached the target
+    while (values[i] < target &&
+           !counter.replace(i, indices[i], values[i], target)) {
+    }
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::update(
+    const FlowKey<key_len> &flowkey, T val) {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  int32_t indices[depth];
+  for (int32_t i = 0; i < depth; ++i) {
+    indices[i] = reduce(hashed[i]);
+  }
+  raise(indices, val);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::updateBatch(
+    const Data::Record<key_len> *records, size_t n,
+    Data::CntMethod cnt_method) {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  uint64_t hashed[depth];
+  int32_t indices[window * depth];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the counters
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, depth, records[base + j].flowkey, hashed);
+      for (int32_t i = 0; i < depth; ++i) {
+        indices[j * depth + i] = reduce(hashed[i]);
+        counter.prefetch(i, indices[j * depth + i]);
+      }
+    }
+    // then update
+    for (size_t j = 0; j < m; ++j) {
+      raise(indices + j * depth,
+            cnt_method == Data::InLength ? records[base + j].length : 1);
+    }
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+T ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::query(
+    const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  T min_val = std::numeric_limits<T>::max();
+  for (int32_t i = 0; i < depth; ++i) {
+    min_val = std::min(min_val, counter.get(i, reduce(hashed[i])));
+  }
+  return min_val;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("depth", depth);
+  writer.put("width", width);
+  writer.put("seed", seed);
+  SnapshotWriter sub = writer.sub("counter");
+  counter.save(sub);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+size_t ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::size() const {
+  return sizeof(*this)            // instance
+         + sizeof(hash_t) * depth // hashing class
+         + counter.size();        // counter
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void ConcurrentCUSketch<key_len, T, hash_t, reduce_t>::clear() {
+  counter.clear();
+}
+
+} // namespace OmniSketch::Sketch
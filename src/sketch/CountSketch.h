@@ -8,34 +8,85 @@
  */
 #pragma once
 
+#include <common/counter.h>
 #include <common/hash.h>
+#include <common/reduce.h>
 #include <common/sketch.h>
+#include <common/topk.h>
+#include <common/utils.h>
 
 namespace OmniSketch::Sketch {
 /**
  * @brief Count Sketch
  *
- * @tparam key_len  length of flowkey
- * @tparam T        type of the counter
- * @tparam hash_t   hashing class
+ * @details Each row takes a single hashing class, whose hashed value gives both
+ * the index and the sign of a counter.
+ *
+ * @tparam key_len   length of flowkey
+ * @tparam T         type of the counter
+ * @tparam hash_t    hashing class
+ * @tparam reduce_t  reduction policy
+ * @tparam counter_t type of the counters stored, being `T` by default.
+ * Narrower integers save memory but saturate. They should be signed if `T` is,
+ * as counters go below zero.
  */
-template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash>
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod, typename counter_t = T>
 class CountSketch : public SketchBase<key_len, T> {
+  static_assert(IsValidCounter<T, counter_t, true>(),
+                "counter_t should be signed if T is");
+
 private:
   int32_t depth;
   int32_t width;
+  reduce_t reduce;
   hash_t *hash_fns;
-  T **counter;
+  uint64_t seed; // base seed of hashing classes
+  CounterArray<T, counter_t> counter;
+  TopK<key_len, T> topk; // flowkeys of the largest estimates
 
   CountSketch(const CountSketch &) = delete;
   CountSketch(CountSketch &&) = delete;
 
+  /**
+   * @brief Cast a sketch to be merged, checking its dimensions and seed
+   *
+   */
+  const CountSketch &mergeable(const SketchBase<key_len, T> &other) const;
+  /**
+   * @brief Change of a flowkey against another sketch, estimated row by row
+   *
+   */
+  T change(const CountSketch &other, const FlowKey<key_len> &flowkey) const;
+
+  /**
+   * @brief Absolute median of the `depth` signed counters of a flowkey
+   *
+   * @param values  signed counters, reordered in place
+   */
+  T median(T *values) const;
+
 public:
   /**
    * @brief Construct by specifying depth and width
    *
+   * @param depth_    depth of the sketch
+   * @param width_    width of the sketch
+   * @param escalate  whether to keep what saturated counters cannot hold in a
+   * side table
+   * @param top_k     # flowkeys of the largest estimates tracked during
+   * updates for getHeavyHitter(), or 0 not to track any
+   * @param seeds     seeds of hashing classes; sketches built with the same
+   * seeds hash identically
+   */
+  CountSketch(int32_t depth_, int32_t width_, bool escalate = false,
+              int32_t top_k = 0,
+              const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a sketch saved by save(), with counters used in place
+   *
    */
-  CountSketch(int32_t depth_, int32_t width_);
+  explicit CountSketch(const SnapshotReader &reader);
   /**
    * @brief Release the pointer
    *
@@ -46,11 +97,77 @@ public:
    *
    */
   void update(const FlowKey<key_len> &flowkey, T val) override;
+  /**
+   * @brief Update a batch of records
+   * @details A window of records is hashed and the counters they touch are
+   * prefetched before any of them is updated.
+   *
+   */
+  void updateBatch(const Data::Record<key_len> *records, size_t n,
+                   Data::CntMethod cnt_method) override;
   /**
    * @brief Query a flowkey
    *
    */
   T query(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Query a batch of flowkeys
+   * @details A window of flowkeys is hashed and the counters they read are
+   * prefetched before any of them is queried.
+   *
+   */
+  void queryBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                  T *out) const override;
+  /**
+   * @brief Heavy hitters among the flowkeys tracked
+   * @details Tracked flowkeys are queried afresh, and those of estimates no
+   * less than `threshold` are reported. Nothing is reported unless the sketch
+   * is constructed with a positive `top_k`.
+   *
+   */
+  Data::Estimation<key_len, T> getHeavyHitter(double threshold) const override;
+  /**
+   * @brief Heavy changers among the flowkeys tracked by either sketch
+   * @details The change of a flowkey is estimated from the counters of both
+   * sketches in one pass over the rows, without building a sketch of their
+   * difference. Nothing is reported unless the sketches are constructed with
+   * a positive `top_k`.
+   *
+   */
+  Data::Estimation<key_len, T>
+  getHeavyChanger(std::unique_ptr<SketchBase<key_len, T>> &ptr_sketch,
+                  double threshold) const override;
+  /**
+   * @brief Merge a sketch of the same dimensions and seeds
+   * @details Flowkeys tracked by either sketch are tracked afresh.
+   *
+   */
+  void merge(const SketchBase<key_len, T> &other) override;
+  /**
+   * @brief Subtract a sketch of the same dimensions and seeds
+   * @details Flowkeys tracked by either sketch are tracked afresh.
+   *
+   */
+  void subtract(const SketchBase<key_len, T> &other) override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<T, hash_t, reduce_t, counter_t>("CountSketch",
+                                                          key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed and the counters
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
   /**
    * @brief Get the size of the sketch
    *
@@ -73,65 +190,260 @@ public:
 
 namespace OmniSketch::Sketch {
 
-template <int32_t key_len, typename T, typename hash_t>
-CountSketch<key_len, T, hash_t>::CountSketch(int32_t depth_, int32_t width_)
-    : depth(depth_), width(Util::NextPrime(width_)) {
-
-  // The first depth hash functions: CM
-  // The last depth hash function: signed bit
-  hash_fns = new hash_t[depth * 2];
-  // Allocate continuous memory
-  counter = new T *[depth];
-  counter[0] = new T[depth * width](); // Init with zero
-  for (int32_t i = 1; i < depth; ++i) {
-    counter[i] = counter[i - 1] + width;
-  }
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+CountSketch<key_len, T, hash_t, reduce_t, counter_t>::CountSketch(
+    int32_t depth_, int32_t width_, bool escalate, int32_t top_k,
+    const Hash::SeedSequence &seeds)
+    : depth(depth_), width(reduce_t::adjust(width_)), reduce(width),
+      seed(seeds.seed()), counter(depth, width, escalate),
+      topk(top_k, true) { // estimates may fall on any update
+
+  // one hashing class per row, giving both the index and the sign
+  hash_fns = seeds.make<hash_t>(depth);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+CountSketch<key_len, T, hash_t, reduce_t, counter_t>::CountSketch(
+    const SnapshotReader &reader)
+    : depth(reader.get<int32_t>("depth")), width(reader.get<int32_t>("width")),
+      reduce(width), seed(reader.get<uint64_t>("seed")),
+      counter(depth, width, reader.sub("counter")),
+      topk(reader.sub("topk")) {
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(depth);
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-CountSketch<key_len, T, hash_t>::~CountSketch() {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+CountSketch<key_len, T, hash_t, reduce_t, counter_t>::~CountSketch() {
   delete[] hash_fns;
-  delete[] counter[0];
-  delete[] counter;
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-void CountSketch<key_len, T, hash_t>::update(const FlowKey<key_len> &flowkey,
-                                             T val) {
-  for (int i = 0; i < depth; ++i) {
-    int idx = hash_fns[i](flowkey) % width;
-    counter[i][idx] +=
-        val * (static_cast<int>(hash_fns[depth + i](flowkey) & 1) * 2 - 1);
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CountSketch<key_len, T, hash_t, reduce_t, counter_t>::update(
+    const FlowKey<key_len> &flowkey, T val) {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  // indices and signs of all rows first, free of branches
+  int32_t indices[depth], signs[depth];
+  for (int32_t i = 0; i < depth; ++i) {
+    indices[i] = reduce(hashed[i]);
+    signs[i] = Hash::Sign(hashed[i]);
+  }
+  for (int32_t i = 0; i < depth; ++i) {
+    counter.add(i, indices[i], val * signs[i]);
+  }
+  if (topk.enabled()) {
+    T values[depth];
+    for (int32_t i = 0; i < depth; ++i) {
+      values[i] = counter.get(i, indices[i]) * signs[i];
+    }
+    topk.offer(flowkey, median(values));
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CountSketch<key_len, T, hash_t, reduce_t, counter_t>::updateBatch(
+    const Data::Record<key_len> *records, size_t n,
+    Data::CntMethod cnt_method) {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  uint64_t hashed[depth];
+  int32_t indices[window * depth];
+  int32_t signs[window * depth];
+  T values[depth];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the counters
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, depth, records[base + j].flowkey, hashed);
+      for (int32_t i = 0; i < depth; ++i) {
+        indices[j * depth + i] = reduce(hashed[i]);
+        signs[j * depth + i] = Hash::Sign(hashed[i]);
+        counter.prefetch(i, indices[j * depth + i]);
+      }
+    }
+    // then update
+    for (size_t j = 0; j < m; ++j) {
+      const T val =
+          cnt_method == Data::InLength ? records[base + j].length : 1;
+      for (int32_t i = 0; i < depth; ++i) {
+        counter.add(i, indices[j * depth + i], val * signs[j * depth + i]);
+      }
+      if (topk.enabled()) {
+        for (int32_t i = 0; i < depth; ++i) {
+          values[i] =
+              counter.get(i, indices[j * depth + i]) * signs[j * depth + i];
+        }
+        topk.offer(records[base + j].flowkey, median(values));
+      }
+    }
   }
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-T CountSketch<key_len, T, hash_t>::query(
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+T CountSketch<key_len, T, hash_t, reduce_t, counter_t>::query(
     const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
   T values[depth];
   for (int i = 0; i < depth; ++i) {
-    int idx = hash_fns[i](flowkey) % width;
-    values[i] = counter[i][idx] *
-                (static_cast<int>(hash_fns[depth + i](flowkey) & 1) * 2 - 1);
+    int idx = reduce(hashed[i]);
+    values[i] = counter.get(i, idx) * Hash::Sign(hashed[i]);
   }
-  std::sort(values, values + depth);
-  if (!(depth & 1)) { // even
-    return std::abs((values[depth / 2 - 1] + values[depth / 2]) / 2);
-  } else { // odd
-    return std::abs(values[depth / 2]);
+  return median(values);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CountSketch<key_len, T, hash_t, reduce_t, counter_t>::queryBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, T *out) const {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  uint64_t hashed[depth];
+  int32_t indices[window * depth];
+  int32_t signs[window * depth];
+  T values[depth];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the counters
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, depth, flowkeys[base + j], hashed);
+      for (int32_t i = 0; i < depth; ++i) {
+        indices[j * depth + i] = reduce(hashed[i]);
+        signs[j * depth + i] = Hash::Sign(hashed[i]);
+        counter.prefetch(i, indices[j * depth + i], false);
+      }
+    }
+    // then query
+    for (size_t j = 0; j < m; ++j) {
+      for (int32_t i = 0; i < depth; ++i) {
+        values[i] =
+            counter.get(i, indices[j * depth + i]) * signs[j * depth + i];
+      }
+      out[base + j] = median(values);
+    }
   }
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-size_t CountSketch<key_len, T, hash_t>::size() const {
-  return sizeof(*this)                // instance
-         + sizeof(hash_t) * depth * 2 // hashing class
-         + sizeof(T) * depth * width; // counter
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+T CountSketch<key_len, T, hash_t, reduce_t, counter_t>::median(
+    T *values) const {
+  return std::abs(Util::Median(values, depth));
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+Data::Estimation<key_len, T>
+CountSketch<key_len, T, hash_t, reduce_t, counter_t>::getHeavyHitter(
+    double threshold) const {
+  Data::Estimation<key_len, T> heavy_hitters;
+  for (const auto &entry : topk.entries()) {
+    const T val = query(entry.flowkey);
+    if (val >= threshold) {
+      heavy_hitters[entry.flowkey] = val;
+    }
+  }
+  return heavy_hitters;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+Data::Estimation<key_len, T>
+CountSketch<key_len, T, hash_t, reduce_t, counter_t>::getHeavyChanger(
+    std::unique_ptr<SketchBase<key_len, T>> &ptr_sketch,
+    double threshold) const {
+  const auto &sketch = mergeable(*ptr_sketch);
+  Data::Estimation<key_len, T> heavy_changers;
+  for (const auto *tracker : {&topk, &sketch.topk}) {
+    for (const auto &entry : tracker->entries()) {
+      if (heavy_changers.count(entry.flowkey)) {
+        continue;
+      }
+      const T val = change(sketch, entry.flowkey);
+      if (val >= threshold) {
+        heavy_changers[entry.flowkey] = val;
+      }
+    }
+  }
+  return heavy_changers;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CountSketch<key_len, T, hash_t, reduce_t, counter_t>::merge(
+    const SketchBase<key_len, T> &other) {
+  const auto &sketch = mergeable(other);
+  counter.merge(sketch.counter);
+  topk.retrack(sketch.topk, [this](const auto &key) { return query(key); });
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CountSketch<key_len, T, hash_t, reduce_t, counter_t>::subtract(
+    const SketchBase<key_len, T> &other) {
+  const auto &sketch = mergeable(other);
+  counter.subtract(sketch.counter);
+  topk.retrack(sketch.topk, [this](const auto &key) { return query(key); });
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+const CountSketch<key_len, T, hash_t, reduce_t, counter_t> &
+CountSketch<key_len, T, hash_t, reduce_t, counter_t>::mergeable(
+    const SketchBase<key_len, T> &other) const {
+  const auto &sketch = MergeCast<CountSketch>(other);
+  CheckMergeable("depth", depth, sketch.depth);
+  CheckMergeable("width", width, sketch.width);
+  CheckMergeable("seed", seed, sketch.seed);
+  return sketch;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+T CountSketch<key_len, T, hash_t, reduce_t, counter_t>::change(
+    const CountSketch &other, const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+  T values[depth];
+  for (int i = 0; i < depth; ++i) {
+    int idx = reduce(hashed[i]);
+    values[i] = (counter.get(i, idx) - other.counter.get(i, idx)) *
+                Hash::Sign(hashed[i]);
+  }
+  return median(values);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CountSketch<key_len, T, hash_t, reduce_t, counter_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("depth", depth);
+  writer.put("width", width);
+  writer.put("seed", seed);
+  SnapshotWriter sub = writer.sub("counter");
+  counter.save(sub);
+  sub = writer.sub("topk");
+  topk.save(sub);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+size_t CountSketch<key_len, T, hash_t, reduce_t, counter_t>::size() const {
+  return sizeof(*this)            // instance
+         + sizeof(hash_t) * depth // hashing class
+         + counter.size()         // counter
+         + topk.size();           // top-k tracker
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-void CountSketch<key_len, T, hash_t>::clear() {
-  std::fill(counter[0], counter[0] + depth * width, 0);
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t,
+          typename counter_t>
+void CountSketch<key_len, T, hash_t, reduce_t, counter_t>::clear() {
+  counter.clear();
+  topk.clear();
 }
 
 } // namespace OmniSketch::Sketch
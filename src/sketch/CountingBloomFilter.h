@@ -8,17 +8,32 @@
  */
 #pragma once
 
+#include <common/bitset.h>
 #include <common/hash.h>
 #include <common/hierarchy.h>
+#include <common/reduce.h>
 
 namespace OmniSketch::Sketch {
 /**
  * @brief Counting Bloom Filter
  *
+ * @details Counters are kept in either of two modes.
+ * - By default, in a CounterHierarchy, whose short counters overflow into
+ * upper layers. It takes less memory, at the cost of lazy updates and, after
+ * an overflow, a decoding inside a look-up.
+ * - In the packed mode, as saturating 4-bit counters, two per byte. Every
+ * operation takes constant time, and a look-up tests its counters with no
+ * branch on them, by an AVX2 gather if there are many (see
+ * NibbleAllNonZero()). A counter that reaches 15 sticks there, as it can no
+ * longer tell how many flowkeys it holds, so a flowkey over it is never
+ * removed from it.
+ *
  * @tparam key_len  length of flowkey
  * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
  */
-template <int32_t key_len, typename hash_t = Hash::AwareHash>
+template <int32_t key_len, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
 class CountingBloomFilter : public SketchBase<key_len> {
   // for convenience
   using T = int64_t;
@@ -27,22 +42,69 @@ class CountingBloomFilter : public SketchBase<key_len> {
 private:
   int32_t ncnt;
   int32_t nhash;
+  reduce_t reduce;
   hash_t *hash_fns;
+  uint64_t seed; // base seed of hashing classes
+  bool packed;
   CH *counter;
+  /// 4-bit counters, followed by NibblePadding bytes, in the packed mode
+  uint8_t *nibble;
+  /// keeps nibbles mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
 
   CountingBloomFilter(const CountingBloomFilter &) = delete;
   CountingBloomFilter(CountingBloomFilter &&) = delete;
   CountingBloomFilter &operator=(CountingBloomFilter) = delete;
 
+  /**
+   * @brief # bytes of nibbles in the packed mode, with the padding
+   *
+   */
+  size_t nibbleBytes() const { return (ncnt + 1) / 2 + NibblePadding; }
+  /**
+   * @brief Increment a 4-bit counter, unless it is saturated
+   *
+   */
+  void increment(int32_t index) {
+    const int32_t shift = (index & 1) << 2;
+    uint8_t &byte = nibble[index >> 1];
+    if (((byte >> shift) & 0xf) != 0xf)
+      byte += 1 << shift;
+  }
+  /**
+   * @brief Decrement a 4-bit counter, unless it is zero or saturated
+   *
+   */
+  void decrement(int32_t index) {
+    const int32_t shift = (index & 1) << 2;
+    uint8_t &byte = nibble[index >> 1];
+    const int32_t value = (byte >> shift) & 0xf;
+    if (value && value != 0xf)
+      byte -= 1 << shift;
+  }
+
 public:
   /**
    * @brief Construct by specifying #counters, #hash and length of counters
    *
    * @param num_cnt    #counter
    * @param num_hash    #hash
-   * @param cnt_length  length of each counter
+   * @param cnt_length  length of each counter, ignored in the packed mode
+   * @param packed      whether counters are packed 4-bit ones instead of a
+   * CounterHierarchy
+   * @param seeds       seeds of hashing classes; filters built with the same
+   * seeds hash identically
    */
-  CountingBloomFilter(int32_t num_cnt, int32_t num_hash, int32_t cnt_length);
+  CountingBloomFilter(int32_t num_cnt, int32_t num_hash, int32_t cnt_length,
+                      bool packed = false,
+                      const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a filter saved by save()
+   * @details Counters are copied out of the snapshot, see CounterHierarchy,
+   * except that packed ones are used in place.
+   *
+   */
+  explicit CountingBloomFilter(const SnapshotReader &reader);
   /**
    * @brief Destructor
    *
@@ -61,12 +123,39 @@ public:
    *
    */
   bool lookup(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Look up a batch of flowkeys
+   * @details An overriding method. A window of flowkeys is hashed and the
+   * counters they read are prefetched before any of them is looked up.
+   *
+   */
+  void lookupBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                   bool *out) const override;
   /**
    * @brief Remove a flowkey from the bloom filter
    * @details A non-overriding method
    *
    */
   void remove(const FlowKey<key_len> &flowkey);
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<hash_t, reduce_t>("CountingBloomFilter", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed, the mode and the counters
+   * @details An overriding method
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
   /**
    * @brief Size of the sketch
    * @details An overriding method
@@ -89,31 +178,68 @@ public:
 
 namespace OmniSketch::Sketch {
 
-template <int32_t key_len, typename hash_t>
-CountingBloomFilter<key_len, hash_t>::CountingBloomFilter(int32_t num_cnt,
-                                                          int32_t num_hash,
-                                                          int32_t cnt_length)
-    : ncnt(Util::NextPrime(num_cnt)), nhash(num_hash) {
+template <int32_t key_len, typename hash_t, typename reduce_t>
+CountingBloomFilter<key_len, hash_t, reduce_t>::CountingBloomFilter(
+    int32_t num_cnt, int32_t num_hash, int32_t cnt_length, bool packed,
+    const Hash::SeedSequence &seeds)
+    : ncnt(reduce_t::adjust(num_cnt)), nhash(num_hash), reduce(ncnt),
+      seed(seeds.seed()), packed(packed), counter(nullptr), nibble(nullptr) {
   // hash functions
-  hash_fns = new hash_t[num_hash];
+  hash_fns = seeds.make<hash_t>(num_hash);
   // counter array
-  counter = new CH({static_cast<size_t>(ncnt)},
-                   {static_cast<size_t>(cnt_length)}, {});
+  if (packed) {
+    nibble = new uint8_t[nibbleBytes()](); // Init with zero
+  } else {
+    counter = new CH({static_cast<size_t>(ncnt)},
+                     {static_cast<size_t>(cnt_length)}, {});
+  }
 }
 
-template <int32_t key_len, typename hash_t>
-CountingBloomFilter<key_len, hash_t>::~CountingBloomFilter() {
+template <int32_t key_len, typename hash_t, typename reduce_t>
+CountingBloomFilter<key_len, hash_t, reduce_t>::CountingBloomFilter(
+    const SnapshotReader &reader)
+    : ncnt(reader.get<int32_t>("ncnt")), nhash(reader.get<int32_t>("nhash")),
+      reduce(ncnt), seed(reader.get<uint64_t>("seed")),
+      packed(reader.get<bool>("packed")), counter(nullptr), nibble(nullptr) {
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(nhash);
+  if (packed) {
+    nibble = reader.map<uint8_t>("nibble", nibbleBytes());
+    mapping = reader.handle();
+  } else {
+    counter = new CH(reader.sub("counter"));
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+CountingBloomFilter<key_len, hash_t, reduce_t>::~CountingBloomFilter() {
   delete[] hash_fns;
   delete counter;
+  if (!mapping)
+    delete[] nibble;
 }
 
-template <int32_t key_len, typename hash_t>
-void CountingBloomFilter<key_len, hash_t>::insert(
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CountingBloomFilter<key_len, hash_t, reduce_t>::insert(
     const FlowKey<key_len> &flowkey) {
+  uint64_t hashed[nhash];
+  hash_t::multiHash(hash_fns, nhash, flowkey, hashed);
+  if (packed) {
+    int32_t indices[nhash];
+    for (int32_t i = 0; i < nhash; ++i) {
+      indices[i] = reduce(hashed[i]);
+    }
+    // increment the buckets if there is a 0
+    if (!NibbleAllNonZero(nibble, indices, nhash)) {
+      for (int32_t i = 0; i < nhash; ++i) {
+        increment(indices[i]);
+      }
+    }
+    return;
+  }
   // if there is a 0
   int32_t i = 0;
   while (i < nhash) {
-    int32_t idx = hash_fns[i](flowkey) % ncnt;
+    int32_t idx = reduce(hashed[i]);
     if (counter->getCnt(idx) == 0)
       break;
     i++;
@@ -121,17 +247,26 @@ void CountingBloomFilter<key_len, hash_t>::insert(
   // increment the buckets
   if (i < nhash) {
     for (int32_t j = 0; j < nhash; ++j) {
-      counter->updateCnt(hash_fns[j](flowkey) % ncnt, 1);
+      counter->updateCnt(reduce(hashed[j]), 1);
     }
   }
 }
 
-template <int32_t key_len, typename hash_t>
-bool CountingBloomFilter<key_len, hash_t>::lookup(
+template <int32_t key_len, typename hash_t, typename reduce_t>
+bool CountingBloomFilter<key_len, hash_t, reduce_t>::lookup(
     const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[nhash];
+  hash_t::multiHash(hash_fns, nhash, flowkey, hashed);
+  if (packed) {
+    int32_t indices[nhash];
+    for (int32_t i = 0; i < nhash; ++i) {
+      indices[i] = reduce(hashed[i]);
+    }
+    return NibbleAllNonZero(nibble, indices, nhash);
+  }
   // if every counter is non-zero, return true
   for (int32_t i = 0; i < nhash; ++i) {
-    int32_t idx = hash_fns[i](flowkey) % ncnt;
+    int32_t idx = reduce(hashed[i]);
     if (counter->getCnt(idx) == 0) {
       return false;
     }
@@ -139,13 +274,64 @@ bool CountingBloomFilter<key_len, hash_t>::lookup(
   return true;
 }
 
-template <int32_t key_len, typename hash_t>
-void CountingBloomFilter<key_len, hash_t>::remove(
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CountingBloomFilter<key_len, hash_t, reduce_t>::lookupBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, bool *out) const {
+  constexpr size_t window = SketchBase<key_len>::BATCH_WINDOW;
+  uint64_t hashed[nhash];
+  int32_t indices[window * nhash];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the counters
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, nhash, flowkeys[base + j], hashed);
+      for (int32_t i = 0; i < nhash; ++i) {
+        indices[j * nhash + i] = reduce(hashed[i]);
+        if (packed)
+          __builtin_prefetch(nibble + (indices[j * nhash + i] >> 1), 0);
+        else
+          counter->prefetchCnt(indices[j * nhash + i]);
+      }
+    }
+    // then check the counters
+    if (packed) {
+      for (size_t j = 0; j < m; ++j) {
+        out[base + j] = NibbleAllNonZero(nibble, indices + j * nhash, nhash);
+      }
+      continue;
+    }
+    for (size_t j = 0; j < m; ++j) {
+      bool exist = true;
+      for (int32_t i = 0; i < nhash && exist; ++i) {
+        exist = counter->getCnt(indices[j * nhash + i]) != 0;
+      }
+      out[base + j] = exist;
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CountingBloomFilter<key_len, hash_t, reduce_t>::remove(
     const FlowKey<key_len> &flowkey) {
+  uint64_t hashed[nhash];
+  hash_t::multiHash(hash_fns, nhash, flowkey, hashed);
+  if (packed) {
+    int32_t indices[nhash];
+    for (int32_t i = 0; i < nhash; ++i) {
+      indices[i] = reduce(hashed[i]);
+    }
+    // decrement the buckets if there is no 0
+    if (NibbleAllNonZero(nibble, indices, nhash)) {
+      for (int32_t i = 0; i < nhash; ++i) {
+        decrement(indices[i]);
+      }
+    }
+    return;
+  }
   // if there is a 0
   int32_t i = 0;
   while (i < nhash) {
-    int32_t idx = hash_fns[i](flowkey) % ncnt;
+    int32_t idx = reduce(hashed[i]);
     if (counter->getCnt(idx) == 0)
       break;
     i++;
@@ -153,21 +339,39 @@ void CountingBloomFilter<key_len, hash_t>::remove(
   // decrement the buckets
   if (i == nhash) {
     for (int32_t j = 0; j < nhash; ++j) {
-      counter->updateCnt(hash_fns[j](flowkey) % ncnt, -1);
+      counter->updateCnt(reduce(hashed[j]), -1);
     }
   }
 }
 
-template <int32_t key_len, typename hash_t>
-size_t CountingBloomFilter<key_len, hash_t>::size() const {
-  return sizeof(*this)            // instance
-         + sizeof(hash_t) * nhash // hash functions
-         + counter->size();       // counter size
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CountingBloomFilter<key_len, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("ncnt", ncnt);
+  writer.put("nhash", nhash);
+  writer.put("seed", seed);
+  writer.put("packed", packed);
+  if (packed) {
+    writer.putBlob("nibble", nibble, nibbleBytes());
+    return;
+  }
+  SnapshotWriter sub = writer.sub("counter");
+  counter->save(sub);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+size_t CountingBloomFilter<key_len, hash_t, reduce_t>::size() const {
+  return sizeof(*this)                                // instance
+         + sizeof(hash_t) * nhash                     // hash functions
+         + (packed ? nibbleBytes() : counter->size()); // counter size
 }
 
-template <int32_t key_len, typename hash_t>
-void CountingBloomFilter<key_len, hash_t>::clear() {
-  counter->clear();
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CountingBloomFilter<key_len, hash_t, reduce_t>::clear() {
+  if (packed)
+    std::fill(nibble, nibble + nibbleBytes(), 0);
+  else
+    counter->clear();
 }
 
 } // namespace OmniSketch::Sketch
\ No newline at end of file
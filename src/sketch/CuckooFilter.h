@@ -0,0 +1,411 @@
+/**
+ * @file CuckooFilter.h
+ * @author dromniscience (you@domain.com)
+ * @brief Cuckoo Filter
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/hash.h>
+#include <common/reduce.h>
+#include <common/sketch.h>
+#include <algorithm>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief Cuckoo Filter with 16-bit fingerprints in 4-way buckets
+ *
+ * @details A flowkey is hashed once into a bucket `i1` and a non-zero 16-bit
+ * fingerprint `fp`, and may sit in `i1` or in its alternate bucket
+ * `i2 = (h(fp) - i1) mod n`. As `i1` is in turn the alternate of `i2`, a
+ * fingerprint is moved between its buckets without the flowkey, by which a
+ * full bucket makes room in cuckoo hashing. A bucket is a 64-bit word, so a
+ * look-up reads at most two cache lines, and compares the fingerprint against
+ * all slots of a bucket at once. Unlike a Bloom Filter, a flowkey can be
+ * removed.
+ *
+ * Each insertion stores a fingerprint, even if it is already there, so that
+ * flowkeys sharing both the buckets and the fingerprint each keep an entry,
+ * and removing one of them leaves the others found. Thus a flowkey should be
+ * inserted once, as by insertIfAbsent(), and only a flowkey inserted be
+ * removed. The false positive rate is about `8 / 2^16`.
+ *
+ * @tparam key_len  length of flowkey
+ * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
+ *
+ * @see B. Fan, D. G. Andersen, M. Kaminsky, M. D. Mitzenmacher, Cuckoo
+ * Filter: Practically Better Than Bloom, CoNEXT 2014.
+ */
+template <int32_t key_len, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
+class CuckooFilter : public SketchBase<key_len> {
+private:
+  /// # slots of a bucket
+  static constexpr int32_t slots = 4;
+  /// # evictions before an insertion gives up
+  static constexpr int32_t max_kicks = 500;
+  /// the lowest bit of each slot
+  static constexpr uint64_t low = 0x0001000100010001ULL;
+
+  /**
+   * @brief A fingerprint evicted by a failed insertion, kept aside
+   *
+   */
+  struct Victim {
+    int32_t index;
+    uint16_t fp;
+    bool used;
+  };
+
+  int32_t num_bucket;
+  reduce_t reduce;
+  hash_t hash_fn;
+  uint64_t seed; // base seed of hashing classes
+  uint64_t *bucket;
+  Victim victim;
+  /// picks slots to evict
+  uint64_t rng;
+  /// keeps buckets mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
+
+  CuckooFilter(const CuckooFilter &) = delete;
+  CuckooFilter(CuckooFilter &&) = delete;
+
+  /**
+   * @brief Whether any slot of a bucket holds the fingerprint
+   *
+   */
+  static bool has(uint64_t word, uint16_t fp) {
+    const uint64_t v = word ^ (low * fp);
+    return (v - low) & ~v & (low << 15);
+  }
+  /**
+   * @brief Fingerprint in a slot of a bucket
+   *
+   */
+  static uint16_t get(uint64_t word, int32_t slot) {
+    return word >> (16 * slot);
+  }
+  /**
+   * @brief Put a fingerprint into a slot of a bucket
+   *
+   */
+  static void set(uint64_t &word, int32_t slot, uint16_t fp) {
+    word = (word & ~(0xffffULL << (16 * slot))) |
+           (static_cast<uint64_t>(fp) << (16 * slot));
+  }
+  /**
+   * @brief Bucket and fingerprint of a hashed flowkey
+   *
+   */
+  void locate(uint64_t hashed, int32_t &index, uint16_t &fp) const {
+    index = reduce(hashed);
+    fp = Hash::Remix(hashed) >> 48;
+    fp += !fp; // 0 marks an empty slot
+  }
+  /**
+   * @brief The other bucket of a fingerprint in a bucket
+   *
+   */
+  int32_t alternate(int32_t index, uint16_t fp) const {
+    const int32_t h = reduce(Hash::Remix(fp));
+    return h >= index ? h - index : h + num_bucket - index;
+  }
+  /**
+   * @brief Put a fingerprint into an empty slot of a bucket, if any
+   *
+   * @return `true` if put; `false` if the bucket is full.
+   */
+  bool place(int32_t index, uint16_t fp) {
+    for (int32_t i = 0; i < slots; ++i) {
+      if (!get(bucket[index], i)) {
+        set(bucket[index], i, fp);
+        return true;
+      }
+    }
+    return false;
+  }
+  /**
+   * @brief Clear a slot holding the fingerprint in a bucket, if any
+   *
+   * @return `true` if cleared; `false` if none holds it.
+   */
+  bool erase(int32_t index, uint16_t fp) {
+    for (int32_t i = 0; i < slots; ++i) {
+      if (get(bucket[index], i) == fp) {
+        set(bucket[index], i, 0);
+        return true;
+      }
+    }
+    return false;
+  }
+  /**
+   * @brief Store a fingerprint in either of its buckets, evicting others if
+   * neither has room
+   *
+   */
+  void store(int32_t index, int32_t other, uint16_t fp);
+  /**
+   * @brief Whether a fingerprint is in either of its buckets or aside
+   *
+   */
+  bool contains(int32_t index, int32_t other, uint16_t fp) const {
+    return has(bucket[index], fp) | has(bucket[other], fp) |
+           (victim.used &&
+            (victim.index == index || victim.index == other) &&
+            victim.fp == fp);
+  }
+
+public:
+  /**
+   * @brief Construct by specifying # buckets
+   *
+   * @param num_bucket_ # 4-way buckets, thus 8 bytes each
+   * @param seeds       seeds of hashing classes; filters built with the same
+   * seeds hash identically
+   */
+  CuckooFilter(int32_t num_bucket_,
+               const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a filter saved by save(), with buckets used in place
+   *
+   */
+  explicit CuckooFilter(const SnapshotReader &reader);
+  /**
+   * @brief Release the pointer
+   *
+   */
+  ~CuckooFilter();
+  /**
+   * @brief Insert a flowkey into the filter
+   * @details An overriding method. If neither bucket has room, fingerprints
+   * are evicted to their alternate buckets in turn. Should that fail, the
+   * last one evicted is kept aside, and the next insertion that finds no room
+   * throws an `std::length_error`.
+   *
+   */
+  void insert(const FlowKey<key_len> &flowkey) override;
+  /**
+   * @brief Insert a flowkey unless it is looked up already
+   * @details A non-overriding method. A flowkey colliding with one inserted
+   * is not inserted either, and is removed along with that one.
+   *
+   */
+  void insertIfAbsent(const FlowKey<key_len> &flowkey);
+  /**
+   * @brief Look up a flowkey to see whether it exists
+   * @details An overriding method
+   *
+   */
+  bool lookup(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Look up a batch of flowkeys
+   * @details An overriding method. A window of flowkeys is hashed and both
+   * buckets of each are prefetched before any of them is looked up.
+   *
+   */
+  void lookupBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                   bool *out) const override;
+  /**
+   * @brief Remove a flowkey from the filter
+   * @details A non-overriding method. One entry of its fingerprint is
+   * cleared, and nothing is done if it is not found.
+   *
+   */
+  void remove(const FlowKey<key_len> &flowkey);
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<hash_t, reduce_t>("CuckooFilter", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the size, the seed, the buckets and the fingerprint aside
+   * @details An overriding method
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
+  /**
+   * @brief Size of the sketch
+   * @details An overriding method
+   */
+  size_t size() const override;
+  /**
+   * @brief Reset the filter
+   * @details A non-overriding method
+   */
+  void clear();
+};
+
+} // namespace OmniSketch::Sketch
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Sketch {
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+CuckooFilter<key_len, hash_t, reduce_t>::CuckooFilter(
+    int32_t num_bucket_, const Hash::SeedSequence &seeds)
+    : num_bucket(reduce_t::adjust(num_bucket_)), reduce(num_bucket),
+      hash_fn(seeds.get<hash_t>(0)), seed(seeds.seed()),
+      victim{0, 0, false}, rng(seed) {
+  bucket = new uint64_t[num_bucket](); // Init with zero
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+CuckooFilter<key_len, hash_t, reduce_t>::CuckooFilter(
+    const SnapshotReader &reader)
+    : num_bucket(reader.get<int32_t>("num_bucket")), reduce(num_bucket),
+      hash_fn(Hash::SeedSequence(reader.get<uint64_t>("seed")).get<hash_t>(0)),
+      seed(reader.get<uint64_t>("seed")),
+      bucket(reader.map<uint64_t>("bucket", num_bucket)),
+      victim(reader.get<Victim>("victim")), rng(seed),
+      mapping(reader.handle()) {}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+CuckooFilter<key_len, hash_t, reduce_t>::~CuckooFilter() {
+  if (!mapping)
+    delete[] bucket;
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CuckooFilter<key_len, hash_t, reduce_t>::store(int32_t index,
+                                                    int32_t other,
+                                                    uint16_t fp) {
+  if (place(index, fp) || place(other, fp))
+    return;
+  if (victim.used) {
+    throw std::length_error(
+        "Filter Full: Should hold at most " +
+        std::to_string(static_cast<int64_t>(num_bucket) * slots) +
+        " flowkeys, but got no room after " + std::to_string(max_kicks) +
+        " kicks instead.");
+  }
+  // evict a random slot in turn, starting from either bucket
+  rng = Hash::Remix(rng);
+  if (rng & slots)
+    index = other;
+  for (int32_t kick = 0; kick < max_kicks; ++kick) {
+    rng = Hash::Remix(rng);
+    const int32_t slot = rng & (slots - 1);
+    const uint16_t evicted = get(bucket[index], slot);
+    set(bucket[index], slot, fp);
+    fp = evicted;
+    index = alternate(index, fp);
+    if (place(index, fp))
+      return;
+  }
+  victim = {index, fp, true};
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CuckooFilter<key_len, hash_t, reduce_t>::insert(
+    const FlowKey<key_len> &flowkey) {
+  int32_t index;
+  uint16_t fp;
+  locate(hash_fn(flowkey), index, fp);
+  store(index, alternate(index, fp), fp);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CuckooFilter<key_len, hash_t, reduce_t>::insertIfAbsent(
+    const FlowKey<key_len> &flowkey) {
+  int32_t index;
+  uint16_t fp;
+  locate(hash_fn(flowkey), index, fp);
+  const int32_t other = alternate(index, fp);
+  if (!contains(index, other, fp))
+    store(index, other, fp);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+bool CuckooFilter<key_len, hash_t, reduce_t>::lookup(
+    const FlowKey<key_len> &flowkey) const {
+  int32_t index;
+  uint16_t fp;
+  locate(hash_fn(flowkey), index, fp);
+  return contains(index, alternate(index, fp), fp);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CuckooFilter<key_len, hash_t, reduce_t>::lookupBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, bool *out) const {
+  constexpr size_t window = SketchBase<key_len>::BATCH_WINDOW;
+  int32_t indices[window], others[window];
+  uint16_t fps[window];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch both buckets
+    for (size_t j = 0; j < m; ++j) {
+      locate(hash_fn(flowkeys[base + j]), indices[j], fps[j]);
+      others[j] = alternate(indices[j], fps[j]);
+      __builtin_prefetch(bucket + indices[j], 0);
+      __builtin_prefetch(bucket + others[j], 0);
+    }
+    // then compare the fingerprints
+    for (size_t j = 0; j < m; ++j) {
+      out[base + j] = contains(indices[j], others[j], fps[j]);
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CuckooFilter<key_len, hash_t, reduce_t>::remove(
+    const FlowKey<key_len> &flowkey) {
+  int32_t index;
+  uint16_t fp;
+  locate(hash_fn(flowkey), index, fp);
+  const int32_t other = alternate(index, fp);
+  if (victim.used && (victim.index == index || victim.index == other) &&
+      victim.fp == fp) {
+    victim.used = false;
+    return;
+  }
+  if (!erase(index, fp) && !erase(other, fp))
+    return;
+  // room has been made for the fingerprint aside
+  if (victim.used) {
+    victim.used = false;
+    if (!place(victim.index, victim.fp) &&
+        !place(alternate(victim.index, victim.fp), victim.fp)) {
+      victim.used = true;
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CuckooFilter<key_len, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("num_bucket", num_bucket);
+  writer.put("seed", seed);
+  writer.put("victim", victim);
+  writer.putBlob("bucket", bucket, sizeof(uint64_t) * num_bucket);
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+size_t CuckooFilter<key_len, hash_t, reduce_t>::size() const {
+  return sizeof(*this)                    // instance
+         + sizeof(uint64_t) * num_bucket; // bucket
+}
+
+template <int32_t key_len, typename hash_t, typename reduce_t>
+void CuckooFilter<key_len, hash_t, reduce_t>::clear() {
+  std::fill(bucket, bucket + num_bucket, 0);
+  victim.used = false;
+}
+
+} // namespace OmniSketch::Sketch
@@ -10,6 +10,7 @@
 #pragma once
 
 #include <common/hash.h>
+#include <common/reduce.h>
 #include <sketch/BloomFilter.h>
 
 namespace OmniSketch::Sketch {
@@ -19,8 +20,10 @@ namespace OmniSketch::Sketch {
  * @tparam key_len  length of flowkey
  * @tparam T        type of the counter
  * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
  */
-template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash>
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
 class FlowRadar : public SketchBase<key_len, T> {
 private:
   struct CountTableEntry {
@@ -34,11 +37,16 @@ private:
   const int32_t num_bit_hash;
   const int32_t num_count_table;
   const int32_t num_count_hash;
+  reduce_t reduce;
   int32_t num_flows;
 
   hash_t *hash_fns;
-  BloomFilter<key_len, hash_t> *flow_filter;
+  uint64_t seed; // base seed of hashing classes
+  BloomFilter<key_len, hash_t, reduce_t> *flow_filter;
+  Hash::HashContext filter_ctx; // positions in flow filter of current packet
   CountTableEntry *count_table;
+  /// keeps the count table mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
 
   FlowRadar(const FlowRadar &) = delete;
   FlowRadar(FlowRadar &&) = delete;
@@ -51,9 +59,20 @@ public:
    * @param flow_filter_hash Number of hash functions in flow filter
    * @param count_table_size Number of elements in count table
    * @param count_table_hash Number of hash functions in count table
+   * @param double_hashing   Whether flow filter derives its positions from two
+   * hash functions
+   * @param seeds            Seeds of hashing classes; sketches built with the
+   * same seeds hash identically
    */
   FlowRadar(int32_t flow_filter_size, int32_t flow_filter_hash,
-            int32_t count_table_size, int32_t count_table_hash);
+            int32_t count_table_size, int32_t count_table_hash,
+            bool double_hashing = false,
+            const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a Flow Radar saved by save(), with both tables used in place
+   *
+   */
+  explicit FlowRadar(const SnapshotReader &reader);
   /**
    * @brief Destructor
    *
@@ -64,6 +83,41 @@ public:
    *
    */
   void update(const FlowKey<key_len> &flowkey, T val) override;
+  /**
+   * @brief Update a batch of records
+   * @details A window of records is hashed and the bits of flow filter and
+   * the entries of count table they touch are prefetched before any of them
+   * is updated.
+   *
+   */
+  void updateBatch(const Data::Record<key_len> *records, size_t n,
+                   Data::CntMethod cnt_method) override;
+  /**
+   * @brief Merge a Flow Radar of the same dimensions and seeds
+   * @details Flow filters are merged bitwise and count tables entrywise.
+   * Decoding remains exact only if no flow has been seen by both, e.g., when
+   * packets are sharded by flowkeys.
+   *
+   */
+  void merge(const SketchBase<key_len, T> &other) override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<T, hash_t, reduce_t>("FlowRadar", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed, the flow filter and the count table
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
   /**
    * @brief Decode flowkey and its value
    *
@@ -91,41 +145,66 @@ public:
 
 namespace OmniSketch::Sketch {
 
-template <int32_t key_len, typename T, typename hash_t>
-FlowRadar<key_len, T, hash_t>::FlowRadar(int32_t flow_filter_size,
-                                         int32_t flow_filter_hash,
-                                         int32_t count_table_size,
-                                         int32_t count_table_hash)
-    : num_bitmap(Util::NextPrime(flow_filter_size)),
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+FlowRadar<key_len, T, hash_t, reduce_t>::FlowRadar(
+    int32_t flow_filter_size, int32_t flow_filter_hash,
+    int32_t count_table_size, int32_t count_table_hash, bool double_hashing,
+    const Hash::SeedSequence &seeds)
+    : num_bitmap(reduce_t::adjust(flow_filter_size)),
       num_bit_hash(flow_filter_hash),
-      num_count_table(Util::NextPrime(count_table_size)),
-      num_count_hash(count_table_hash), num_flows(0) {
-  hash_fns = new hash_t[num_count_hash];
-  // flow filter
-  flow_filter = new BloomFilter<key_len, hash_t>(num_bitmap, num_bit_hash);
+      num_count_table(reduce_t::adjust(count_table_size)),
+      num_count_hash(count_table_hash), reduce(num_count_table),
+      num_flows(0), seed(seeds.seed()) {
+  hash_fns = seeds.make<hash_t>(num_count_hash);
+  // flow filter, hashed independently of the count table
+  flow_filter = new BloomFilter<key_len, hash_t, reduce_t>(
+      num_bitmap, num_bit_hash, double_hashing, false, seeds.fork(1));
+  filter_ctx.resize(num_bit_hash);
   // count table
   count_table = new CountTableEntry[num_count_table]();
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-FlowRadar<key_len, T, hash_t>::~FlowRadar() {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+FlowRadar<key_len, T, hash_t, reduce_t>::FlowRadar(
+    const SnapshotReader &reader)
+    : num_bitmap(reader.get<int32_t>("num_bitmap")),
+      num_bit_hash(reader.get<int32_t>("num_bit_hash")),
+      num_count_table(reader.get<int32_t>("num_count_table")),
+      num_count_hash(reader.get<int32_t>("num_count_hash")),
+      reduce(num_count_table), num_flows(reader.get<int32_t>("num_flows")),
+      seed(reader.get<uint64_t>("seed")) {
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(num_count_hash);
+  flow_filter = new BloomFilter<key_len, hash_t, reduce_t>(
+      reader.sub("flow_filter"));
+  filter_ctx.resize(num_bit_hash);
+  count_table = reader.map<CountTableEntry>("count_table", num_count_table);
+  mapping = reader.handle();
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+FlowRadar<key_len, T, hash_t, reduce_t>::~FlowRadar() {
   delete[] hash_fns;
   delete flow_filter;
-  delete[] count_table;
+  if (!mapping)
+    delete[] count_table;
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-void FlowRadar<key_len, T, hash_t>::update(const FlowKey<key_len> &flowkey,
-                                           T val) {
-  bool exist = flow_filter->lookup(flowkey);
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void FlowRadar<key_len, T, hash_t, reduce_t>::update(
+    const FlowKey<key_len> &flowkey, T val) {
+  // hash only once for both lookup and insertion
+  flow_filter->hash(flowkey, filter_ctx);
+  bool exist = flow_filter->lookup(filter_ctx);
   // a new flow
   if (!exist) {
-    flow_filter->insert(flowkey);
+    flow_filter->insert(filter_ctx);
     num_flows++;
   }
 
+  uint64_t hashed[num_count_hash];
+  hash_t::multiHash(hash_fns, num_count_hash, flowkey, hashed);
   for (int32_t i = 0; i < num_count_hash; i++) {
-    int32_t index = hash_fns[i](flowkey) % num_count_table;
+    int32_t index = reduce(hashed[i]);
     // a new flow
     if (!exist) {
       count_table[index].flow_count++;
@@ -136,8 +215,84 @@ void FlowRadar<key_len, T, hash_t>::update(const FlowKey<key_len> &flowkey,
   }
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-Data::Estimation<key_len, T> FlowRadar<key_len, T, hash_t>::decode() {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void FlowRadar<key_len, T, hash_t, reduce_t>::updateBatch(
+    const Data::Record<key_len> *records, size_t n,
+    Data::CntMethod cnt_method) {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  std::vector<Hash::HashContext> ctx(std::min(window, n),
+                                     Hash::HashContext(num_bit_hash));
+  uint64_t hashed[num_count_hash];
+  int32_t indices[window * num_count_hash];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch both flow filter and count table
+    for (size_t j = 0; j < m; ++j) {
+      const auto &flowkey = records[base + j].flowkey;
+      flow_filter->hash(flowkey, ctx[j]);
+      flow_filter->prefetch(ctx[j]);
+      hash_t::multiHash(hash_fns, num_count_hash, flowkey, hashed);
+      for (int32_t i = 0; i < num_count_hash; ++i) {
+        indices[j * num_count_hash + i] = reduce(hashed[i]);
+        __builtin_prefetch(count_table + indices[j * num_count_hash + i], 1);
+      }
+    }
+    // then update in order, as a flow may recur in the window
+    for (size_t j = 0; j < m; ++j) {
+      const auto &flowkey = records[base + j].flowkey;
+      const T val =
+          cnt_method == Data::InLength ? records[base + j].length : 1;
+      bool exist = flow_filter->lookup(ctx[j]);
+      if (!exist) {
+        flow_filter->insert(ctx[j]);
+        num_flows++;
+      }
+      for (int32_t i = 0; i < num_count_hash; ++i) {
+        auto &entry = count_table[indices[j * num_count_hash + i]];
+        if (!exist) {
+          entry.flow_count++;
+          entry.flowXOR ^= flowkey;
+        }
+        entry.packet_count += val;
+      }
+    }
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void FlowRadar<key_len, T, hash_t, reduce_t>::merge(
+    const SketchBase<key_len, T> &other) {
+  const auto &sketch = MergeCast<FlowRadar>(other);
+  CheckMergeable("# count table", num_count_table, sketch.num_count_table);
+  CheckMergeable("# count hash", num_count_hash, sketch.num_count_hash);
+  CheckMergeable("seed", seed, sketch.seed);
+  // the flow filter checks its own dimensions before anything is merged
+  flow_filter->merge(*sketch.flow_filter);
+  for (int32_t i = 0; i < num_count_table; ++i) {
+    count_table[i].flowXOR ^= sketch.count_table[i].flowXOR;
+    count_table[i].flow_count += sketch.count_table[i].flow_count;
+    count_table[i].packet_count += sketch.count_table[i].packet_count;
+  }
+  num_flows += sketch.num_flows;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void FlowRadar<key_len, T, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("num_bitmap", num_bitmap);
+  writer.put("num_bit_hash", num_bit_hash);
+  writer.put("num_count_table", num_count_table);
+  writer.put("num_count_hash", num_count_hash);
+  writer.put("num_flows", num_flows);
+  writer.put("seed", seed);
+  SnapshotWriter sub = writer.sub("flow_filter");
+  flow_filter->save(sub);
+  writer.putBlob("count_table", count_table,
+                 sizeof(CountTableEntry) * num_count_table);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+Data::Estimation<key_len, T> FlowRadar<key_len, T, hash_t, reduce_t>::decode() {
   // an optimized implementation
   class CompareFlowCount {
   public:
@@ -169,8 +324,10 @@ Data::Estimation<key_len, T> FlowRadar<key_len, T, hash_t>::decode() {
 
     FlowKey<key_len> flowkey = count_table[index].flowXOR;
     T size = count_table[index].packet_count;
+    uint64_t hashed[num_count_hash];
+    hash_t::multiHash(hash_fns, num_count_hash, flowkey, hashed);
     for (int i = 0; i < num_count_hash; ++i) {
-      int l = hash_fns[i](flowkey) % num_count_table;
+      int l = reduce(hashed[i]);
       set.erase(count_table + l);
       count_table[l].flow_count--;
       count_table[l].packet_count -= size;
@@ -182,23 +339,22 @@ Data::Estimation<key_len, T> FlowRadar<key_len, T, hash_t>::decode() {
   return est;
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-size_t FlowRadar<key_len, T, hash_t>::size() const {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+size_t FlowRadar<key_len, T, hash_t, reduce_t>::size() const {
   return sizeof(*this)                                 // instance
          + num_count_hash * sizeof(hash_t)             // hashing class
          + num_count_table * (sizeof(T) * 2 + key_len) // count table
          + flow_filter->size();                        // flow filter
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-void FlowRadar<key_len, T, hash_t>::clear() {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void FlowRadar<key_len, T, hash_t, reduce_t>::clear() {
   // reset flow counter
   num_flows = 0;
   // reset flow filter
   flow_filter->clear();
-  // reset count table
-  delete[] count_table;
-  count_table = new CountTableEntry[num_count_table]();
+  // reset count table, which may be mapped from a snapshot
+  std::fill(count_table, count_table + num_count_table, CountTableEntry());
 }
 
 } // namespace OmniSketch::Sketch
\ No newline at end of file
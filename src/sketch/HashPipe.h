@@ -9,7 +9,9 @@
 #pragma once
 
 #include <common/hash.h>
+#include <common/reduce.h>
 #include <common/sketch.h>
+#include <unordered_set>
 
 namespace OmniSketch::Sketch {
 /**
@@ -18,8 +20,10 @@ namespace OmniSketch::Sketch {
  * @tparam key_len  length of flowkey
  * @tparam T        type of the counter
  * @tparam hash_t   hashing class
+ * @tparam reduce_t reduction policy
  */
-template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash>
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash,
+          typename reduce_t = Hash::PrimeMod>
 class HashPipe : public SketchBase<key_len, T> {
 private:
   class Entry {
@@ -29,19 +33,44 @@ private:
   };
   int32_t depth;
   int32_t width;
+  reduce_t reduce;
   hash_t *hash_fns;
+  uint64_t seed; // base seed of hashing classes
   Entry **slots;
+  /// keeps slots mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
 
   HashPipe(const HashPipe &) = delete;
   HashPipe(HashPipe &&) = delete;
   HashPipe &operator=(HashPipe) = delete;
 
+  /**
+   * @brief Update a flowkey whose slot in the first stage is known
+   *
+   */
+  void updateFrom(const FlowKey<key_len> &flowkey, T val, int32_t idx);
+  /**
+   * @brief Cast a sketch to be compared, checking its dimensions and seed
+   *
+   */
+  const HashPipe &comparable(const SketchBase<key_len, T> &other) const;
+
 public:
   /**
    * @brief Construct by specifying depth and width
    *
+   * @param depth_  depth of the sketch
+   * @param width_  width of the sketch
+   * @param seeds   seeds of hashing classes; sketches built with the same
+   * seeds hash identically
    */
-  HashPipe(int32_t depth_, int32_t width_);
+  HashPipe(int32_t depth_, int32_t width_,
+           const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a sketch saved by save(), with slots used in place
+   *
+   */
+  explicit HashPipe(const SnapshotReader &reader);
   /**
    * @brief Release the pointer
    *
@@ -52,17 +81,63 @@ public:
    *
    */
   void update(const FlowKey<key_len> &flowkey, T val) override;
+  /**
+   * @brief Update a batch of records
+   * @details A window of records is hashed and their slots in the first
+   * stage are prefetched before any of them is updated. Slots in later stages
+   * depend on which keys are evicted, and are thus not prefetched.
+   *
+   */
+  void updateBatch(const Data::Record<key_len> *records, size_t n,
+                   Data::CntMethod cnt_method) override;
   /**
    * @brief Query a flowkey
    *
    */
   T query(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Query a batch of flowkeys
+   * @details A window of flowkeys is hashed and their slots in all stages
+   * are prefetched before any of them is queried.
+   *
+   */
+  void queryBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                  T *out) const override;
   /**
    * @brief Get Heavy Hitter
    * @param threshold A flowkey is a HH iff its counter `>= threshold`
    *
    */
   Data::Estimation<key_len, T> getHeavyHitter(double threshold) const override;
+  /**
+   * @brief Get Heavy Changer
+   * @details Flowkeys in the slots of either sketch are candidates. Both
+   * sketches hash identically, so a candidate is hashed once and its slots in
+   * both are compared stage by stage.
+   * @param threshold A flowkey is a HC iff its change `>= threshold`
+   *
+   */
+  Data::Estimation<key_len, T>
+  getHeavyChanger(std::unique_ptr<SketchBase<key_len, T>> &ptr_sketch,
+                  double threshold) const override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<T, hash_t, reduce_t>("HashPipe", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the dimensions, the seed and the slots
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
   /**
    * @brief Get sketch size
    *
@@ -85,11 +160,13 @@ public:
 
 namespace OmniSketch::Sketch {
 
-template <int32_t key_len, typename T, typename hash_t>
-HashPipe<key_len, T, hash_t>::HashPipe(int32_t depth_, int32_t width_)
-    : depth(depth_), width(Util::NextPrime(width_)) {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+HashPipe<key_len, T, hash_t, reduce_t>::HashPipe(
+    int32_t depth_, int32_t width_, const Hash::SeedSequence &seeds)
+    : depth(depth_), width(reduce_t::adjust(width_)), reduce(width),
+      seed(seeds.seed()) {
 
-  hash_fns = new hash_t[depth];
+  hash_fns = seeds.make<hash_t>(depth);
   // Allocate continuous memory
   slots = new Entry *[depth];
   slots[0] = new Entry[depth * width](); // Init with zero
@@ -98,18 +175,39 @@ HashPipe<key_len, T, hash_t>::HashPipe(int32_t depth_, int32_t width_)
   }
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-HashPipe<key_len, T, hash_t>::~HashPipe() {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+HashPipe<key_len, T, hash_t, reduce_t>::HashPipe(const SnapshotReader &reader)
+    : depth(reader.get<int32_t>("depth")), width(reader.get<int32_t>("width")),
+      reduce(width), seed(reader.get<uint64_t>("seed")) {
+
+  hash_fns = Hash::SeedSequence(seed).make<hash_t>(depth);
+  // Stages are continuous in the snapshot as well
+  slots = new Entry *[depth];
+  slots[0] = reader.map<Entry>("slots", static_cast<size_t>(depth) * width);
+  for (int32_t i = 1; i < depth; ++i) {
+    slots[i] = slots[i - 1] + width;
+  }
+  mapping = reader.handle();
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+HashPipe<key_len, T, hash_t, reduce_t>::~HashPipe() {
   delete[] hash_fns;
-  delete[] slots[0];
+  if (!mapping)
+    delete[] slots[0];
   delete[] slots;
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-void HashPipe<key_len, T, hash_t>::update(const FlowKey<key_len> &flowkey,
-                                          T val) {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void HashPipe<key_len, T, hash_t, reduce_t>::update(
+    const FlowKey<key_len> &flowkey, T val) {
+  updateFrom(flowkey, val, reduce(hash_fns[0](flowkey)));
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void HashPipe<key_len, T, hash_t, reduce_t>::updateFrom(
+    const FlowKey<key_len> &flowkey, T val, int32_t idx) {
   // The first stage
-  int idx = hash_fns[0](flowkey) % width;
   FlowKey<key_len> empty_key;
   FlowKey<key_len> c_key;
   T c_val;
@@ -131,7 +229,7 @@ void HashPipe<key_len, T, hash_t>::update(const FlowKey<key_len> &flowkey,
   }
   // Later stages
   for (int i = 1; i < depth; ++i) {
-    idx = hash_fns[i](c_key) % width;
+    idx = reduce(hash_fns[i](c_key));
     if (slots[i][idx].flowkey == c_key) {
       slots[i][idx].val += c_val;
       return;
@@ -150,11 +248,36 @@ void HashPipe<key_len, T, hash_t>::update(const FlowKey<key_len> &flowkey,
   }
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-T HashPipe<key_len, T, hash_t>::query(const FlowKey<key_len> &flowkey) const {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void HashPipe<key_len, T, hash_t, reduce_t>::updateBatch(
+    const Data::Record<key_len> *records, size_t n,
+    Data::CntMethod cnt_method) {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  int32_t indices[window];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the slots in the first stage
+    for (size_t j = 0; j < m; ++j) {
+      indices[j] = reduce(hash_fns[0](records[base + j].flowkey));
+      __builtin_prefetch(slots[0] + indices[j], 1);
+    }
+    // then update
+    for (size_t j = 0; j < m; ++j) {
+      const T val =
+          cnt_method == Data::InLength ? records[base + j].length : 1;
+      updateFrom(records[base + j].flowkey, val, indices[j]);
+    }
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+T HashPipe<key_len, T, hash_t, reduce_t>::query(
+    const FlowKey<key_len> &flowkey) const {
+  uint64_t hashed[depth];
+  hash_t::multiHash(hash_fns, depth, flowkey, hashed);
   T ret = 0;
   for (int i = 0; i < depth; ++i) {
-    int idx = hash_fns[i](flowkey) % width;
+    int idx = reduce(hashed[i]);
     if (slots[i][idx].flowkey == flowkey) {
       ret += slots[i][idx].val;
     }
@@ -162,9 +285,39 @@ T HashPipe<key_len, T, hash_t>::query(const FlowKey<key_len> &flowkey) const {
   return ret;
 }
 
-template <int32_t key_len, typename T, typename hash_t>
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void HashPipe<key_len, T, hash_t, reduce_t>::queryBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, T *out) const {
+  constexpr size_t window = SketchBase<key_len, T>::BATCH_WINDOW;
+  uint64_t hashed[depth];
+  int32_t indices[window * depth];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the slots
+    for (size_t j = 0; j < m; ++j) {
+      hash_t::multiHash(hash_fns, depth, flowkeys[base + j], hashed);
+      for (int32_t i = 0; i < depth; ++i) {
+        indices[j * depth + i] = reduce(hashed[i]);
+        __builtin_prefetch(slots[i] + indices[j * depth + i], 0);
+      }
+    }
+    // then query
+    for (size_t j = 0; j < m; ++j) {
+      T ret = 0;
+      for (int32_t i = 0; i < depth; ++i) {
+        const Entry &entry = slots[i][indices[j * depth + i]];
+        if (entry.flowkey == flowkeys[base + j]) {
+          ret += entry.val;
+        }
+      }
+      out[base + j] = ret;
+    }
+  }
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
 Data::Estimation<key_len, T>
-HashPipe<key_len, T, hash_t>::getHeavyHitter(double threshold) const {
+HashPipe<key_len, T, hash_t, reduce_t>::getHeavyHitter(double threshold) const {
   Data::Estimation<key_len, T> heavy_hitters;
   std::set<FlowKey<key_len>> checked;
   for (int i = 0; i < depth; ++i) {
@@ -183,15 +336,74 @@ HashPipe<key_len, T, hash_t>::getHeavyHitter(double threshold) const {
   return heavy_hitters;
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-size_t HashPipe<key_len, T, hash_t>::size() const {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+Data::Estimation<key_len, T>
+HashPipe<key_len, T, hash_t, reduce_t>::getHeavyChanger(
+    std::unique_ptr<SketchBase<key_len, T>> &ptr_sketch,
+    double threshold) const {
+  const auto &sketch = comparable(*ptr_sketch);
+  Data::Estimation<key_len, T> heavy_changers;
+  std::unordered_set<FlowKey<key_len>> checked;
+  checked.reserve(depth * width * 2);
+  uint64_t hashed[depth];
+  for (const auto *pipe : {this, &sketch}) {
+    for (int i = 0; i < depth; ++i) {
+      for (int j = 0; j < width; ++j) {
+        const auto &flowkey = pipe->slots[i][j].flowkey;
+        if (!checked.insert(flowkey).second) {
+          continue;
+        }
+        hash_t::multiHash(hash_fns, depth, flowkey, hashed);
+        T mine = 0, theirs = 0;
+        for (int k = 0; k < depth; ++k) {
+          int idx = reduce(hashed[k]);
+          if (slots[k][idx].flowkey == flowkey) {
+            mine += slots[k][idx].val;
+          }
+          if (sketch.slots[k][idx].flowkey == flowkey) {
+            theirs += sketch.slots[k][idx].val;
+          }
+        }
+        // not to wrap around on unsigned counters
+        const T diff = mine > theirs ? mine - theirs : theirs - mine;
+        if (diff >= threshold) {
+          heavy_changers[flowkey] = diff;
+        }
+      }
+    }
+  }
+  return heavy_changers;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+const HashPipe<key_len, T, hash_t, reduce_t> &
+HashPipe<key_len, T, hash_t, reduce_t>::comparable(
+    const SketchBase<key_len, T> &other) const {
+  const auto &sketch = MergeCast<HashPipe>(other);
+  CheckMergeable("depth", depth, sketch.depth);
+  CheckMergeable("width", width, sketch.width);
+  CheckMergeable("seed", seed, sketch.seed);
+  return sketch;
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void HashPipe<key_len, T, hash_t, reduce_t>::save(
+    SnapshotWriter &writer) const {
+  writer.put("depth", depth);
+  writer.put("width", width);
+  writer.put("seed", seed);
+  writer.putBlob("slots", slots[0], sizeof(Entry) * depth * width);
+}
+
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+size_t HashPipe<key_len, T, hash_t, reduce_t>::size() const {
   return sizeof(*this)                    // instance
          + sizeof(hash_t) * depth         // hashing class
          + sizeof(Entry) * depth * width; // slots
 }
 
-template <int32_t key_len, typename T, typename hash_t>
-void HashPipe<key_len, T, hash_t>::clear() {
+template <int32_t key_len, typename T, typename hash_t, typename reduce_t>
+void HashPipe<key_len, T, hash_t, reduce_t>::clear() {
   FlowKey<key_len> empty_key;
   for (int i = 0; i < depth; ++i) {
     for (int j = 0; j < width; ++j) {
@@ -0,0 +1,286 @@
+/**
+ * @file XorFilter.h
+ * @author dromniscience (you@domain.com)
+ * @brief Xor Filter
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/hash.h>
+#include <common/sketch.h>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+
+namespace OmniSketch::Sketch {
+/**
+ * @brief Static filter answering by the xor of three fingerprints
+ *
+ * @details The filter is built once from a set of flowkeys by insertBatch().
+ * Each flowkey is mapped to one slot in each of three segments, and the
+ * fingerprints in the slots are assigned such that their xor is the
+ * fingerprint of the flowkey. This is solved by peeling a 3-hypergraph, and
+ * takes about `1.23 * 8 * sizeof(fp_t)` bits per flowkey, retried with
+ * another seed in the rare case it fails. A look-up thus reads three slots
+ * and takes no branch, with a false positive rate of `2^-(8 * sizeof(fp_t))`.
+ * Flowkeys can neither be inserted one by one nor removed.
+ *
+ * @tparam key_len  length of flowkey
+ * @tparam hash_t   hashing class
+ * @tparam fp_t     type of fingerprints, an unsigned integer
+ *
+ * @see T. M. Graf, D. Lemire, Xor Filters: Faster and Smaller Than Bloom and
+ * Cuckoo Filters, ACM JEA 2020.
+ */
+template <int32_t key_len, typename hash_t = Hash::AwareHash,
+          typename fp_t = uint8_t>
+class XorFilter : public SketchBase<key_len> {
+private:
+  static_assert(std::is_unsigned_v<fp_t>, "fp_t should be unsigned");
+
+  int32_t segment;
+  hash_t hash_fn;
+  uint64_t seed; // base seed of hashing classes
+  /// seed mixed into hashed values, found by building
+  uint64_t mix;
+  fp_t *fingerprint;
+  /// keeps fingerprints mapped from a snapshot alive, if so
+  std::shared_ptr<const void> mapping;
+
+  XorFilter(const XorFilter &) = delete;
+  XorFilter(XorFilter &&) = delete;
+
+  /**
+   * @brief Slot of a mixed hashed value in the `i`-th segment
+   *
+   */
+  int32_t slot(uint64_t h, int32_t i) const {
+    const uint32_t r = (h << (21 * i)) | (h >> ((64 - 21 * i) & 63));
+    return (static_cast<uint64_t>(r) * segment >> 32) + i * segment;
+  }
+  /**
+   * @brief Fingerprint of a mixed hashed value
+   *
+   */
+  static fp_t fingerprintOf(uint64_t h) { return h ^ (h >> 32); }
+
+public:
+  /**
+   * @brief Construct an empty filter
+   *
+   * @param seeds seeds of hashing classes; filters built with the same seeds
+   * from the same flowkeys are the same
+   */
+  XorFilter(const Hash::SeedSequence &seeds = Hash::SeedSequence());
+  /**
+   * @brief Load a filter saved by save(), with fingerprints used in place
+   *
+   */
+  explicit XorFilter(const SnapshotReader &reader);
+  /**
+   * @brief Release the pointer
+   *
+   */
+  ~XorFilter();
+  /**
+   * @brief Build the filter from a batch of records
+   * @details An overriding method. Whatever the filter held is replaced by
+   * the distinct flowkeys of the batch.
+   *
+   */
+  void insertBatch(const Data::Record<key_len> *records, size_t n) override;
+  /**
+   * @brief Look up a flowkey to see whether it exists
+   * @details An overriding method
+   *
+   */
+  bool lookup(const FlowKey<key_len> &flowkey) const override;
+  /**
+   * @brief Look up a batch of flowkeys
+   * @details An overriding method. A window of flowkeys is hashed and their
+   * slots are prefetched before any of them is looked up.
+   *
+   */
+  void lookupBatch(const FlowKey<key_len> *flowkeys, size_t n,
+                   bool *out) const override;
+  /**
+   * @brief Name of the type, with the template arguments
+   *
+   */
+  static std::string typeName() {
+    return SketchTypeName<hash_t, fp_t>("XorFilter", key_len);
+  }
+  /**
+   * @brief Name of the type recorded in snapshots
+   * @details An overriding method
+   *
+   */
+  std::string type() const override { return typeName(); }
+  /**
+   * @brief Save the size, the seeds and the fingerprints
+   * @details An overriding method
+   *
+   */
+  void save(SnapshotWriter &writer) const override;
+  /**
+   * @brief Size of the sketch
+   * @details An overriding method
+   */
+  size_t size() const override;
+};
+
+} // namespace OmniSketch::Sketch
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Sketch {
+
+template <int32_t key_len, typename hash_t, typename fp_t>
+XorFilter<key_len, hash_t, fp_t>::XorFilter(const Hash::SeedSequence &seeds)
+    : segment(0), hash_fn(seeds.get<hash_t>(0)), seed(seeds.seed()),
+      mix(seed), fingerprint(nullptr) {}
+
+template <int32_t key_len, typename hash_t, typename fp_t>
+XorFilter<key_len, hash_t, fp_t>::XorFilter(const SnapshotReader &reader)
+    : segment(reader.get<int32_t>("segment")),
+      hash_fn(Hash::SeedSequence(reader.get<uint64_t>("seed")).get<hash_t>(0)),
+      seed(reader.get<uint64_t>("seed")), mix(reader.get<uint64_t>("mix")),
+      fingerprint(reader.map<fp_t>("fingerprint", 3 * segment)),
+      mapping(reader.handle()) {}
+
+template <int32_t key_len, typename hash_t, typename fp_t>
+XorFilter<key_len, hash_t, fp_t>::~XorFilter() {
+  if (!mapping)
+    delete[] fingerprint;
+}
+
+template <int32_t key_len, typename hash_t, typename fp_t>
+void XorFilter<key_len, hash_t, fp_t>::insertBatch(
+    const Data::Record<key_len> *records, size_t n) {
+  // distinct flowkeys, told apart by their hashed values
+  std::vector<uint64_t> keys(n);
+  for (size_t i = 0; i < n; ++i) {
+    keys[i] = hash_fn(records[i].flowkey);
+  }
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  if (!mapping)
+    delete[] fingerprint;
+  mapping.reset();
+  segment = (32 + static_cast<int64_t>(1.23 * keys.size())) / 3;
+  fingerprint = new fp_t[3 * segment]();
+
+  /// xor of the mixed hashed values in a slot and # of them
+  struct Cell {
+    uint64_t mask;
+    uint32_t count;
+  };
+  std::vector<Cell> cells(3 * segment);
+  std::vector<int32_t> queue;
+  /// peeled mixed hashed values and the slots they are peeled from
+  std::vector<std::pair<uint64_t, int32_t>> stack;
+  for (mix = Hash::Remix(seed);; mix = Hash::Remix(mix)) {
+    std::fill(cells.begin(), cells.end(), Cell{0, 0});
+    for (uint64_t key : keys) {
+      const uint64_t h = Hash::Remix(key + mix);
+      for (int32_t i = 0; i < 3; ++i) {
+        Cell &cell = cells[slot(h, i)];
+        cell.mask ^= h;
+        cell.count++;
+      }
+    }
+    // peel slots of a single key until none is left
+    queue.clear();
+    stack.clear();
+    for (int32_t i = 0; i < 3 * segment; ++i) {
+      if (cells[i].count == 1)
+        queue.push_back(i);
+    }
+    while (!queue.empty()) {
+      const int32_t idx = queue.back();
+      queue.pop_back();
+      if (cells[idx].count != 1)
+        continue;
+      const uint64_t h = cells[idx].mask;
+      stack.emplace_back(h, idx);
+      for (int32_t i = 0; i < 3; ++i) {
+        Cell &cell = cells[slot(h, i)];
+        cell.mask ^= h;
+        if (--cell.count == 1)
+          queue.push_back(slot(h, i));
+      }
+    }
+    if (stack.size() == keys.size())
+      break;
+  }
+  // assign fingerprints in the reverse order of peeling
+  for (auto iter = stack.rbegin(); iter != stack.rend(); ++iter) {
+    const uint64_t h = iter->first;
+    fingerprint[iter->second] = 0;
+    fingerprint[iter->second] = fingerprintOf(h) ^ fingerprint[slot(h, 0)] ^
+                                fingerprint[slot(h, 1)] ^
+                                fingerprint[slot(h, 2)];
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename fp_t>
+bool XorFilter<key_len, hash_t, fp_t>::lookup(
+    const FlowKey<key_len> &flowkey) const {
+  if (!segment)
+    return false;
+  const uint64_t h = Hash::Remix(hash_fn(flowkey) + mix);
+  return fingerprintOf(h) == (fingerprint[slot(h, 0)] ^
+                              fingerprint[slot(h, 1)] ^
+                              fingerprint[slot(h, 2)]);
+}
+
+template <int32_t key_len, typename hash_t, typename fp_t>
+void XorFilter<key_len, hash_t, fp_t>::lookupBatch(
+    const FlowKey<key_len> *flowkeys, size_t n, bool *out) const {
+  if (!segment) {
+    std::fill(out, out + n, false);
+    return;
+  }
+  constexpr size_t window = SketchBase<key_len>::BATCH_WINDOW;
+  uint64_t hashed[window];
+  for (size_t base = 0; base < n; base += window) {
+    const size_t m = std::min(window, n - base);
+    // hash the whole window and prefetch the slots
+    for (size_t j = 0; j < m; ++j) {
+      hashed[j] = Hash::Remix(hash_fn(flowkeys[base + j]) + mix);
+      for (int32_t i = 0; i < 3; ++i) {
+        __builtin_prefetch(fingerprint + slot(hashed[j], i), 0);
+      }
+    }
+    // then compare the fingerprints
+    for (size_t j = 0; j < m; ++j) {
+      const uint64_t h = hashed[j];
+      out[base + j] = fingerprintOf(h) == (fingerprint[slot(h, 0)] ^
+                                           fingerprint[slot(h, 1)] ^
+                                           fingerprint[slot(h, 2)]);
+    }
+  }
+}
+
+template <int32_t key_len, typename hash_t, typename fp_t>
+void XorFilter<key_len, hash_t, fp_t>::save(SnapshotWriter &writer) const {
+  writer.put("segment", segment);
+  writer.put("seed", seed);
+  writer.put("mix", mix);
+  writer.putBlob("fingerprint", fingerprint, sizeof(fp_t) * 3 * segment);
+}
+
+template <int32_t key_len, typename hash_t, typename fp_t>
+size_t XorFilter<key_len, hash_t, fp_t>::size() const {
+  return sizeof(*this)                 // instance
+         + sizeof(fp_t) * 3 * segment; // fingerprint
+}
+
+} // namespace OmniSketch::Sketch
@@ -0,0 +1,191 @@
+/**
+ * @file BlockedBloomFilterTest.h
+ * @author dromniscience (you@domain.com)
+ * @brief Testing Blocked Bloom Filter
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/test.h>
+#include <sketch/BlockedBloomFilter.h>
+
+#define BBF_PARA_PATH "BBF.para"
+#define BBF_TEST_PATH "BBF.test"
+#define BBF_DATA_PATH "BBF.data"
+
+namespace OmniSketch::Test {
+/**
+ * @brief Testing class for Blocked Bloom Filter
+ *
+ */
+template <int32_t key_len, typename hash_t = Hash::AwareHash>
+class BlockedBloomFilterTest : public TestBase<key_len> {
+  using TestBase<key_len>::config_file;
+
+public:
+  /**
+   * @brief Constructor
+   * @details Names from left to right are
+   * - show name
+   * - config file
+   * - path to the node that contains metrics of interest (concatenated with
+   * '.')
+   */
+  BlockedBloomFilterTest(const std::string_view config_file)
+      : TestBase<key_len>("Blocked Bloom Filter", config_file,
+                          BBF_TEST_PATH) {}
+
+  /**
+   * @brief Test Blocked Bloom Filter
+   * @details An overriden method
+   */
+  void runTest() override;
+};
+
+} // namespace OmniSketch::Test
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Test {
+
+template <int32_t key_len, typename hash_t>
+void BlockedBloomFilterTest<key_len, hash_t>::runTest() {
+  /**
+   * @brief shorthand for convenience
+   *
+   */
+  using StreamData = Data::StreamData<key_len>;
+
+  /// Part I.
+  ///   Parse the config file
+  ///
+  /// Step i.  First we list the variables to parse, namely:
+  ///
+  int32_t nblock, nhash; // sketch config
+  std::string data_file; // data config
+  toml::array arr;       // shortly we will convert it to format
+  /// Step ii. Open the config file
+  Util::ConfigParser parser(config_file);
+  if (!parser.succeed()) {
+    return;
+  }
+  /// Step iii. Set the working node of the parser.
+  parser.setWorkingNode(BBF_PARA_PATH);
+  /// Step iv. Parse num_block and num_hash
+  if (!parser.parseConfig(nblock, "num_block"))
+    return;
+  if (!parser.parseConfig(nhash, "num_hash"))
+    return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
+  /// Step v. Ready to read data configurations
+  parser.setWorkingNode(BBF_DATA_PATH);
+  /// Step vi. Parse data and format
+  if (!parser.parseConfig(data_file, "data"))
+    return;
+  if (!parser.parseConfig(arr, "format"))
+    return;
+  Data::DataFormat format(arr); // conver from toml::array to Data::DataFormat
+  /// [Optional] User-defined rules
+  ///
+  /// In BBF, we still have an parameter to control how much it samples. It is
+  /// in [BBF.test] node.
+  ///
+  /// Step vii. Parse other testing configurations.
+  double sample;
+  parser.setWorkingNode(BBF_TEST_PATH);
+  if (!parser.parseConfig(sample, "sample"))
+    return;
+  if (sample <= 0. || sample > 1.) {
+    throw std::out_of_range(
+        "Sample Rate Out Of Range: Should be in (0,1], but got " +
+        std::to_string(sample) + " instead.");
+  }
+
+  /// Part II.
+  ///   Prepare sketch and data
+  ///
+  /// Step i. Get the ground truth
+  ///
+  ///       1. read data
+  StreamData data(data_file,
+                  format); // specifying both data file and data format
+  if (!data.succeed())
+    return;
+  ///       2. find ending point of the sampling
+  auto data_ptr = data.diff(static_cast<std::size_t>(sample * data.size()));
+  ///       3. use the whole stream as the ground truth, but only a $sample
+  ///       fraction as the sample
+  Data::GndTruth<key_len> gnd_truth, sample_truth;
+  gnd_truth.getGroundTruth(data.begin(), data.end(),
+                           Data::CntMethod::InPacket); // all flows
+  sample_truth.getGroundTruth(
+      data.begin(), data_ptr,
+      Data::CntMethod::InPacket); // first $sample fraction of records
+  ///       4. [optional] show data info
+  fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
+             gnd_truth.size(), data_file);
+
+  for (const auto &reduce_name : reduce_names) {
+    /// Step ii. Initialize a sketch with the hashing class and the reduction
+    /// policy
+    std::unique_ptr<Sketch::SketchBase<key_len>> ptr, batch_ptr;
+    DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+      DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+        using hash_fn = typename decltype(hash_tag)::type;
+        using reduce_fn = typename decltype(reduce_tag)::type;
+        using sketch_t =
+            Sketch::BlockedBloomFilter<key_len, hash_fn, reduce_fn>;
+        ptr.reset(new sketch_t(nblock, nhash, seeds));
+        batch_ptr.reset(new sketch_t(nblock, nhash, seeds));
+      });
+    });
+    if (!ptr) // unknown hashing class or reduction policy
+      return;
+    /// remember that the left ptr must point to the base class in order to
+    /// call the methods in it
+
+    /// Step iii. Insert the samples and then look up all the flows
+    ///
+    ///        1. insert the sampled records, and into its twin by batches
+    this->testInsert(ptr, data.begin(),
+                     data_ptr); // metrics of interest are in config file
+    this->testInsertBatch(batch_ptr, data.begin(), data_ptr);
+    ///        2. look up all the flows, one by one and by a batch
+    this->testLookup(ptr, gnd_truth,
+                     sample_truth); // metrics of interest are in config file
+    this->testLookupBatch(ptr, gnd_truth, sample_truth);
+    ///        3. test size
+    this->testSize(ptr);
+    ///        4. show metrics
+    if (!reduce_name.empty())
+      fmt::print("Reduction: {}\n", reduce_name);
+    this->show();
+  }
+
+  return;
+}
+
+} // namespace OmniSketch::Test
+
+#undef BBF_PARA_PATH
+#undef BBF_TEST_PATH
+#undef BBF_DATA_PATH
+
+// Driver instance:
+//      AUTHOR: dromniscience
+//      CONFIG: sketch_config.toml  # with respect to the `src/` directory
+//    TEMPLATE: <13, Hash::AwareHash>
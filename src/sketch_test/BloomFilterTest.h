@@ -81,6 +81,20 @@ void BloomFilterTest<key_len, hash_t>::runTest() {
     return;
   if (!parser.parseConfig(nhash, "num_hash"))
     return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  std::vector<std::string> probe_names; // [optional] probing modes
+  if (!parser.parseConfig(probe_names, "probe", false))
+    probe_names = {""}; // defaults to independent hashing
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
+  std::vector<int32_t> threads; // [optional] # threads sharing a filter
+  parser.parseConfig(threads, "threads", false);
   /// Step v. Ready to read data configurations
   parser.setWorkingNode(BF_DATA_PATH);
   /// Step vi. Parse data and format
@@ -108,13 +122,7 @@ void BloomFilterTest<key_len, hash_t>::runTest() {
   /// Part II.
   ///   Prepare sketch and data
   ///
-  /// Step i. Initialize a sketch
-  std::unique_ptr<Sketch::SketchBase<key_len>> ptr(
-      new Sketch::BloomFilter<key_len, hash_t>(nbit, nhash));
-  /// remember that the left ptr must point to the base class in order to call
-  /// the methods in it
-
-  /// Step ii. Get the ground truth
+  /// Step i. Get the ground truth
   ///
   ///       1. read data
   StreamData data(data_file,
@@ -135,18 +143,60 @@ void BloomFilterTest<key_len, hash_t>::runTest() {
   fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
              gnd_truth.size(), data_file);
 
-  /// Step iii. Insert the samples and then look up all the flows
-  ///
-  ///        1. insert the sampled records
-  this->testInsert(ptr, data.begin(),
-                   data_ptr); // metrics of interest are in config file
-  ///        2. look up all the flows
-  this->testLookup(ptr, gnd_truth,
-                   sample_truth); // metrics of interest are in config file
-  ///        3. test size
-  this->testSize(ptr);
-  ///        4. show metrics
-  this->show();
+  for (const auto &reduce_name : reduce_names) {
+    for (const auto &probe_name : probe_names) {
+      bool double_hashing;
+      if (!ParseProbe(probe_name, double_hashing))
+        return;
+      /// Step ii. Initialize a sketch with the hashing class, the reduction
+      /// policy and the probing mode
+      std::unique_ptr<Sketch::SketchBase<key_len>> ptr, batch_ptr;
+      std::function<Sketch::SketchBase<key_len> *(bool)> make_sketch;
+      DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+        DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+          using hash_fn = typename decltype(hash_tag)::type;
+          using reduce_fn = typename decltype(reduce_tag)::type;
+          using sketch_t = Sketch::BloomFilter<key_len, hash_fn, reduce_fn>;
+          make_sketch = [=](bool concurrent) -> Sketch::SketchBase<key_len> * {
+            return new sketch_t(nbit, nhash, double_hashing, concurrent,
+                                seeds);
+          };
+        });
+      });
+      if (!make_sketch) // unknown hashing class or reduction policy
+        return;
+      ptr.reset(make_sketch(false));
+      batch_ptr.reset(make_sketch(false));
+      /// remember that the left ptr must point to the base class in order to
+      /// call the methods in it
+
+      /// Step iii. Insert the samples and then look up all the flows
+      ///
+      ///        1. insert the sampled records, and into its twin by batches
+      this->testInsert(ptr, data.begin(),
+                       data_ptr); // metrics of interest are in config file
+      this->testInsertBatch(batch_ptr, data.begin(), data_ptr);
+      ///        2. look up all the flows, one by one and by a batch
+      this->testLookup(ptr, gnd_truth,
+                       sample_truth); // metrics of interest are in config file
+      this->testLookupBatch(ptr, gnd_truth, sample_truth);
+      ///        3. insert the sampled records into a fresh concurrent filter by
+      ///        each # threads
+      for (int32_t num_threads : threads) {
+        std::unique_ptr<Sketch::SketchBase<key_len>> shared(make_sketch(true));
+        this->testConcurrentInsert(shared, data.begin(), data_ptr,
+                                   num_threads);
+      }
+      ///        4. test size
+      this->testSize(ptr);
+      ///        5. show metrics
+      if (!reduce_name.empty())
+        fmt::print("Reduction: {}\n", reduce_name);
+      if (!probe_name.empty())
+        fmt::print("Probing: {}\n", probe_name);
+      this->show();
+    }
+  }
 
   return;
 }
@@ -85,6 +85,15 @@ void CHCMSketchTest<key_len, no_layer, T, hash_t>::runTest() {
     return;
   if (!parser.parseConfig(width, "width"))
     return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
   /// Step v. Move to the data node
   parser.setWorkingNode(CHCM_DATA_PATH);
   /// Step vi. Parse data and format
@@ -117,14 +126,7 @@ void CHCMSketchTest<key_len, no_layer, T, hash_t>::runTest() {
   /// Part II.
   ///   Prepare sketch and data
   ///
-  /// Step i. Initialize a sketch
-  std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr(
-      new Sketch::CHCMSketch<key_len, no_layer, T, hash_t>(
-          depth, width, cnt_no_ratio, width_cnt, no_hash));
-  /// remember that the left ptr must point to the base class in order to call
-  /// the methods in it
-
-  /// Step ii. Get ground truth
+  /// Step i. Get ground truth
   ///
   ///       1. read data
   StreamData data(data_file, format); // specify both data file and data format
@@ -135,17 +137,40 @@ void CHCMSketchTest<key_len, no_layer, T, hash_t>::runTest() {
   ///       2. [optional] show data info
   fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
              gnd_truth.size(), data_file);
-  /// Step iii. Insert the samples and then look up all the flows
-  ///
-  ///        1. update records into the sketch
-  this->testUpdate(ptr, data.begin(), data.end(),
-                   cnt_method); // metrics of interest are in config file
-  ///        2. query for all the flowkeys
-  this->testQuery(ptr, gnd_truth); // metrics of interest are in config file
-  ///        3. size
-  this->testSize(ptr);
-  ///        3. show metrics
-  this->show();
+
+  for (const auto &reduce_name : reduce_names) {
+    /// Step ii. Initialize a sketch with the hashing class and the reduction
+    /// policy
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr;
+    DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+      DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+        using hash_fn = typename decltype(hash_tag)::type;
+        using reduce_fn = typename decltype(reduce_tag)::type;
+        ptr.reset(
+            new Sketch::CHCMSketch<key_len, no_layer, T, hash_fn, reduce_fn>(
+                depth, width, cnt_no_ratio, width_cnt, no_hash, seeds));
+      });
+    });
+    if (!ptr) // unknown hashing class or reduction policy
+      return;
+    /// remember that the left ptr must point to the base class in order to
+    /// call the methods in it
+
+    /// Step iii. Insert the samples and then look up all the flows
+    ///
+    ///        1. update records into the sketch
+    this->testUpdate(ptr, data.begin(), data.end(),
+                     cnt_method); // metrics of interest are in config file
+    ///        2. query for all the flowkeys, one by one and by a batch
+    this->testQuery(ptr, gnd_truth); // metrics of interest are in config file
+    this->testQueryBatch(ptr, gnd_truth);
+    ///        3. size
+    this->testSize(ptr);
+    ///        4. show metrics
+    if (!reduce_name.empty())
+      fmt::print("Reduction: {}\n", reduce_name);
+    this->show();
+  }
 
   return;
 }
@@ -84,6 +84,23 @@ void CUSketchTest<key_len, T, hash_t>::runTest() {
     return;
   if (!parser.parseConfig(width, "width"))
     return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  std::string counter_name; // [optional] type of counters stored, defaults to T
+  parser.parseConfig(counter_name, "counter", false);
+  bool escalate = false; // [optional] whether saturated counters escalate
+  parser.parseConfig(escalate, "escalate", false);
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
+  std::vector<int32_t> threads; // [optional] # threads of sharded updates
+  parser.parseConfig(threads, "threads", false);
+  int32_t top_k = 0; // [optional] # flowkeys tracked for heavy hitters
+  parser.parseConfig(top_k, "top_k", false);
   /// Step v. Move to the data node
   parser.setWorkingNode(CU_DATA_PATH);
   /// Step vi. Parse data and format
@@ -102,38 +119,98 @@ void CUSketchTest<key_len, T, hash_t>::runTest() {
   if (!method.compare("InPacket")) {
     cnt_method = Data::InPacket;
   }
+  /// Step viii. Parse heavy hitters, only if flowkeys are tracked
+  double num_heavy_hitter;
+  Data::HXMethod hx_method = Data::TopK;
+  if (top_k > 0) {
+    if (!parser.parseConfig(num_heavy_hitter, "threshold_heavy_hitter"))
+      return;
+    if (!parser.parseConfig(method, "hx_method"))
+      return;
+    if (!method.compare("Percentile")) {
+      hx_method = Data::Percentile;
+    }
+  }
 
   /// Part II.
   ///   Prepare sketch and data
   ///
-  /// Step i. Initialize a sketch
-  std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr(
-      new Sketch::CUSketch<key_len, T, hash_t>(depth, width));
-  /// remember that the left ptr must point to the base class in order to call
-  /// the methods in it
-
-  /// Step ii. Get ground truth
+  /// Step i. Get ground truth
   ///
   ///       1. read data
   StreamData data(data_file, format); // specify both data file and data format
   if (!data.succeed())
     return;
-  Data::GndTruth<key_len, T> gnd_truth;
+  Data::GndTruth<key_len, T> gnd_truth, gnd_truth_heavy_hitters;
   gnd_truth.getGroundTruth(data.begin(), data.end(), cnt_method);
+  if (top_k > 0)
+    gnd_truth_heavy_hitters.getHeavyHitter(gnd_truth, num_heavy_hitter,
+                                           hx_method);
   ///       2. [optional] show data info
   fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
              gnd_truth.size(), data_file);
-  /// Step iii. Insert the samples and then look up all the flows
-  ///
-  ///        1. update records into the sketch
-  this->testUpdate(ptr, data.begin(), data.end(),
-                   cnt_method); // metrics of interest are in config file
-  ///        2. query for all the flowkeys
-  this->testQuery(ptr, gnd_truth); // metrics of interest are in config file
-  ///        3. size
-  this->testSize(ptr);
-  ///        3. show metrics
-  this->show();
+
+  for (const auto &reduce_name : reduce_names) {
+    /// Step ii. Initialize a sketch with the hashing class and the reduction
+    /// policy
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr, batch_ptr;
+    std::function<Sketch::SketchBase<key_len, T> *()> make_sketch;
+    DispatchSketch<hash_t, T>(
+        hash_name, reduce_name, counter_name,
+        [&](auto hash_tag, auto reduce_tag, auto counter_tag) {
+          using hash_fn = typename decltype(hash_tag)::type;
+          using reduce_fn = typename decltype(reduce_tag)::type;
+          using counter_fn = typename decltype(counter_tag)::type;
+          using sketch_t =
+              Sketch::CUSketch<key_len, T, hash_fn, reduce_fn, counter_fn>;
+          // replicas hash identically, so that they can be merged
+          make_sketch = [=]() -> Sketch::SketchBase<key_len, T> * {
+            return new sketch_t(depth, width, escalate, top_k, seeds);
+          };
+          ptr.reset(make_sketch());
+          batch_ptr.reset(make_sketch());
+        });
+    if (!ptr) // unknown name, or counter type under other hash or policy
+      return;
+    /// remember that the left ptr must point to the base class in order to
+    /// call the methods in it
+
+    /// Step iii. Insert the samples and then look up all the flows
+    ///
+    ///        1. update records into the sketch, and into its twin by
+    ///           batches
+    this->testUpdate(ptr, data.begin(), data.end(),
+                     cnt_method); // metrics of interest are in config file
+    this->testUpdateBatch(batch_ptr, data.begin(), data.end(), cnt_method);
+    ///        2. update records by several threads into replicas, which are
+    ///           then merged
+    for (int32_t num_threads : threads) {
+      std::unique_ptr<Sketch::SketchBase<key_len, T>> sharded_ptr;
+      this->testShardedUpdate(sharded_ptr, make_sketch, data.begin(),
+                              data.end(), cnt_method, num_threads);
+    }
+    ///        3. query for all the flowkeys, one by one and by a batch
+    this->testQuery(ptr, gnd_truth); // metrics of interest are in config file
+    this->testQueryBatch(ptr, gnd_truth);
+    ///        4. [optional] heavy hitters among the flowkeys tracked
+    if (top_k > 0) {
+      if (hx_method == Data::TopK) {
+        this->testHeavyHitter(ptr, gnd_truth_heavy_hitters.min(),
+                              gnd_truth_heavy_hitters);
+      } else {
+        // gnd_truth_heavy_hitter: >, yet the sketch: >=
+        this->testHeavyHitter(
+            ptr, std::floor(gnd_truth.totalValue() * num_heavy_hitter + 1),
+            gnd_truth_heavy_hitters);
+      }
+    }
+    ///        5. size
+    this->testSize(ptr);
+    ///        6. show metrics
+    if (!reduce_name.empty())
+      fmt::print("Reduction: {}\n", reduce_name);
+    this->show();
+  }
 
   return;
 }
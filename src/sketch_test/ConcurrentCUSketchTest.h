@@ -0,0 +1,192 @@
+/**
+ * @file ConcurrentCUSketchTest.h
+ * @author dromniscience (you@domain.com)
+ * @brief Test Concurrent CU Sketch
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/test.h>
+#include <sketch/CUSketch.h>
+#include <sketch/ConcurrentCUSketch.h>
+
+#define CCU_PARA_PATH "CCU.para"
+#define CCU_TEST_PATH "CCU.test"
+#define CCU_DATA_PATH "CCU.data"
+
+namespace OmniSketch::Test {
+
+/**
+ * @brief Testing class for Concurrent CU Sketch
+ *
+ */
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash>
+class ConcurrentCUSketchTest : public TestBase<key_len, T> {
+  using TestBase<key_len, T>::config_file;
+
+public:
+  /**
+   * @brief Constructor
+   * @details Names from left to right are
+   * - show name
+   * - config file
+   * - path to the node that contains metrics of interest (concatenated with
+   * '.')
+   */
+  ConcurrentCUSketchTest(const std::string_view config_file)
+      : TestBase<key_len, T>("Concurrent CU", config_file, CCU_TEST_PATH) {}
+
+  /**
+   * @brief Test Concurrent CU Sketch
+   * @details An overriden method
+   */
+  void runTest() override;
+};
+
+} // namespace OmniSketch::Test
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Test {
+
+template <int32_t key_len, typename T, typename hash_t>
+void ConcurrentCUSketchTest<key_len, T, hash_t>::runTest() {
+  /**
+   * @brief shorthand for convenience
+   *
+   */
+  using StreamData = Data::StreamData<key_len>;
+
+  /// Part I.
+  ///   Parse the config file
+  ///
+  /// Step i.  First we list the variables to parse, namely:
+  ///
+  int32_t depth, width;  // sketch config
+  std::string data_file; // data config
+  toml::array arr;       // shortly we will convert it to format
+  /// Step ii. Open the config file
+  Util::ConfigParser parser(config_file);
+  if (!parser.succeed()) {
+    return;
+  }
+  /// Step iii. Set the working node of the parser.
+  parser.setWorkingNode(
+      CCU_PARA_PATH); // do not forget to to enclose it with braces
+  /// Step iv. Parse num_bits and num_hash
+  if (!parser.parseConfig(depth, "depth"))
+    return;
+  if (!parser.parseConfig(width, "width"))
+    return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
+  std::vector<int32_t> threads; // [optional] # threads sharing the sketch
+  if (!parser.parseConfig(threads, "threads", false) || threads.empty())
+    threads = {1};
+  /// Step v. Move to the data node
+  parser.setWorkingNode(CCU_DATA_PATH);
+  /// Step vi. Parse data and format
+  if (!parser.parseConfig(data_file, "data"))
+    return;
+  if (!parser.parseConfig(arr, "format"))
+    return;
+  Data::DataFormat format(arr); // conver from toml::array to Data::DataFormat
+  /// [Optional] User-defined rules
+  ///
+  /// Step vii. Parse Cnt Method.
+  std::string method;
+  Data::CntMethod cnt_method = Data::InLength;
+  if (!parser.parseConfig(method, "cnt_method"))
+    return;
+  if (!method.compare("InPacket")) {
+    cnt_method = Data::InPacket;
+  }
+
+  /// Part II.
+  ///   Prepare sketch and data
+  ///
+  /// Step i. Get ground truth
+  ///
+  ///       1. read data
+  StreamData data(data_file, format); // specify both data file and data format
+  if (!data.succeed())
+    return;
+  Data::GndTruth<key_len, T> gnd_truth;
+  gnd_truth.getGroundTruth(data.begin(), data.end(), cnt_method);
+  ///       2. [optional] show data info
+  fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
+             gnd_truth.size(), data_file);
+
+  for (const auto &reduce_name : reduce_names) {
+    /// Step ii. Initialize a sketch with the hashing class and the reduction
+    /// policy
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr, base_ptr;
+    std::function<Sketch::SketchBase<key_len, T> *()> make_sketch;
+    DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+      DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+        using hash_fn = typename decltype(hash_tag)::type;
+        using reduce_fn = typename decltype(reduce_tag)::type;
+        using sketch_t =
+            Sketch::ConcurrentCUSketch<key_len, T, hash_fn, reduce_fn>;
+        make_sketch = [=]() -> Sketch::SketchBase<key_len, T> * {
+          return new sketch_t(depth, width, seeds);
+        };
+        // the single-threaded baseline
+        base_ptr.reset(new Sketch::CUSketch<key_len, T, hash_fn, reduce_fn>(
+            depth, width, false, 0, seeds));
+      });
+    });
+    if (!make_sketch) // unknown hashing class or reduction policy
+      return;
+    /// remember that the left ptr must point to the base class in order to
+    /// call the methods in it
+
+    /// Step iii. Insert the samples and then look up all the flows
+    ///
+    ///        1. update records into the baseline by batches, and into a
+    ///           fresh sketch by each # threads
+    this->testUpdateBatch(base_ptr, data.begin(), data.end(), cnt_method);
+    for (int32_t num_threads : threads) {
+      ptr.reset(make_sketch());
+      this->testConcurrentUpdate(ptr, data.begin(), data.end(), cnt_method,
+                                 num_threads);
+    }
+    ///        2. query for all the flowkeys, in the baseline by a batch and
+    ///           in the last sketch one by one
+    this->testQueryBatch(base_ptr, gnd_truth);
+    this->testQuery(ptr, gnd_truth); // metrics of interest are in config file
+    ///        3. size
+    this->testSize(ptr);
+    ///        4. show metrics
+    if (!reduce_name.empty())
+      fmt::print("Reduction: {}\n", reduce_name);
+    fmt::print("Baseline: UpdBatch and QryBatch by CUSketch on one thread\n");
+    this->show();
+  }
+
+  return;
+}
+
+} // namespace OmniSketch::Test
+
+#undef CCU_PARA_PATH
+#undef CCU_TEST_PATH
+#undef CCU_DATA_PATH
+
+// Driver instance:
+//      AUTHOR: dromniscience
+//      CONFIG: sketch_config.toml  # with respect to the `src/` directory
+//    TEMPLATE: <13, int32_t, Hash::AwareHash>
\ No newline at end of file
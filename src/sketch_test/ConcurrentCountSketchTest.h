@@ -0,0 +1,187 @@
+/**
+ * @file ConcurrentCountSketchTest.h
+ * @author dromniscience (you@domain.com)
+ * @brief Test Concurrent Count Sketch
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#pragma once
+
+#include <common/test.h>
+#include <sketch/ConcurrentCountSketch.h>
+
+#define CCS_PARA_PATH "CCM.para"
+#define CCS_TEST_PATH "CCM.test"
+#define CCS_DATA_PATH "CCM.data"
+
+namespace OmniSketch::Test {
+
+/**
+ * @brief Testing class for Concurrent Count Sketch
+ *
+ */
+template <int32_t key_len, typename T, typename hash_t = Hash::AwareHash>
+class ConcurrentCountSketchTest : public TestBase<key_len, T> {
+  using TestBase<key_len, T>::config_file;
+
+public:
+  /**
+   * @brief Constructor
+   * @details Names from left to right are
+   * - show name
+   * - config file
+   * - path to the node that contains metrics of interest (concatenated with
+   * '.')
+   */
+  ConcurrentCountSketchTest(const std::string_view config_file)
+      : TestBase<key_len, T>("Concurrent CS", config_file, CCS_TEST_PATH) {}
+
+  /**
+   * @brief Test Concurrent Count Sketch
+   * @details An overriden method
+   */
+  void runTest() override;
+};
+
+} // namespace OmniSketch::Test
+
+//-----------------------------------------------------------------------------
+//
+///                        Implementation of templated methods
+//
+//-----------------------------------------------------------------------------
+
+namespace OmniSketch::Test {
+
+template <int32_t key_len, typename T, typename hash_t>
+void ConcurrentCountSketchTest<key_len, T, hash_t>::runTest() {
+  /**
+   * @brief shorthand for convenience
+   *
+   */
+  using StreamData = Data::StreamData<key_len>;
+
+  /// Part I.
+  ///   Parse the config file
+  ///
+  /// Step i.  First we list the variables to parse, namely:
+  ///
+  int32_t depth, width;  // sketch config
+  std::string data_file; // data config
+  toml::array arr;       // shortly we will convert it to format
+  /// Step ii. Open the config file
+  Util::ConfigParser parser(config_file);
+  if (!parser.succeed()) {
+    return;
+  }
+  /// Step iii. Set the working node of the parser.
+  parser.setWorkingNode(
+      CCS_PARA_PATH); // do not forget to to enclose it with braces
+  /// Step iv. Parse num_bits and num_hash
+  if (!parser.parseConfig(depth, "depth"))
+    return;
+  if (!parser.parseConfig(width, "width"))
+    return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
+  int32_t buffer_size = 0; // [optional] # slots of write-combining buffers
+  parser.parseConfig(buffer_size, "buffer_size", false);
+  int32_t flush_interval = 1024; // [optional] # records between flushes
+  parser.parseConfig(flush_interval, "flush_interval", false);
+  std::vector<int32_t> threads; // [optional] # threads sharing the sketch
+  if (!parser.parseConfig(threads, "threads", false) || threads.empty())
+    threads = {1};
+  /// Step v. Move to the data node
+  parser.setWorkingNode(CCS_DATA_PATH);
+  /// Step vi. Parse data and format
+  if (!parser.parseConfig(data_file, "data"))
+    return;
+  if (!parser.parseConfig(arr, "format"))
+    return;
+  Data::DataFormat format(arr); // conver from toml::array to Data::DataFormat
+  /// [Optional] User-defined rules
+  ///
+  /// Step vii. Parse Cnt Method.
+  std::string method;
+  Data::CntMethod cnt_method = Data::InLength;
+  if (!parser.parseConfig(method, "cnt_method"))
+    return;
+  if (!method.compare("InPacket")) {
+    cnt_method = Data::InPacket;
+  }
+
+  /// Part II.
+  ///   Prepare sketch and data
+  ///
+  /// Step i. Get ground truth
+  ///
+  ///       1. read data
+  StreamData data(data_file, format); // specify both data file and data format
+  if (!data.succeed())
+    return;
+  Data::GndTruth<key_len, T> gnd_truth;
+  gnd_truth.getGroundTruth(data.begin(), data.end(), cnt_method);
+  ///       2. [optional] show data info
+  fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
+             gnd_truth.size(), data_file);
+
+  for (const auto &reduce_name : reduce_names) {
+    /// Step ii. Initialize a sketch with the hashing class and the reduction
+    /// policy
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr;
+    std::function<Sketch::SketchBase<key_len, T> *()> make_sketch;
+    DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+      DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+        using hash_fn = typename decltype(hash_tag)::type;
+        using reduce_fn = typename decltype(reduce_tag)::type;
+        using sketch_t =
+            Sketch::ConcurrentCountSketch<key_len, T, hash_fn, reduce_fn>;
+        make_sketch = [=]() -> Sketch::SketchBase<key_len, T> * {
+          return new sketch_t(depth, width, buffer_size, flush_interval, seeds);
+        };
+      });
+    });
+    if (!make_sketch) // unknown hashing class or reduction policy
+      return;
+    /// remember that the left ptr must point to the base class in order to
+    /// call the methods in it
+
+    /// Step iii. Insert the samples and then look up all the flows
+    ///
+    ///        1. update records into a fresh sketch by each # threads
+    for (int32_t num_threads : threads) {
+      ptr.reset(make_sketch());
+      this->testConcurrentUpdate(ptr, data.begin(), data.end(), cnt_method,
+                                 num_threads);
+    }
+    ///        2. query for all the flowkeys in the last sketch
+    this->testQuery(ptr, gnd_truth); // metrics of interest are in config file
+    ///        3. size
+    this->testSize(ptr);
+    ///        4. show metrics
+    if (!reduce_name.empty())
+      fmt::print("Reduction: {}\n", reduce_name);
+    this->show();
+  }
+
+  return;
+}
+
+} // namespace OmniSketch::Test
+
+#undef CCS_PARA_PATH
+#undef CCS_TEST_PATH
+#undef CCS_DATA_PATH
+
+// Driver instance:
+//      AUTHOR: dromniscience
+//      CONFIG: sketch_config.toml  # with respect to the `src/` directory
+//    TEMPLATE: <13, int32_t, Hash::AwareHash>
\ No newline at end of file
@@ -76,6 +76,18 @@ void CountingBloomFilterTest<key_len, hash_t>::runTest() {
     return;
   if (!parser.parseConfig(nbit, "cnt_length"))
     return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  std::vector<std::string> mode_names; // [optional] modes of counters
+  if (!parser.parseConfig(mode_names, "mode", false))
+    mode_names = {""}; // defaults to Hierarchy
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
 
   parser.setWorkingNode(CBF_DATA_PATH);
   if (!parser.parseConfig(data_file, "data"))
@@ -94,9 +106,6 @@ void CountingBloomFilterTest<key_len, hash_t>::runTest() {
         std::to_string(sample) + " instead.");
   }
 
-  std::unique_ptr<Sketch::SketchBase<key_len>> ptr(
-      new Sketch::CountingBloomFilter<key_len, hash_t>(ncnt, nhash, nbit));
-
   StreamData data(data_file, format);
   if (!data.succeed())
     return;
@@ -112,12 +121,46 @@ void CountingBloomFilterTest<key_len, hash_t>::runTest() {
   fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
              gnd_truth.size(), data_file);
 
-  this->testInsert(ptr, data.begin(),
-                   data_ptr); // metrics of interest are in config file
-  this->testLookup(ptr, gnd_truth,
-                   sample_truth); // metrics of interest are in config file
-  this->testSize(ptr);
-  this->show();
+  for (const auto &reduce_name : reduce_names) {
+    for (const auto &mode_name : mode_names) {
+      bool packed;
+      if (mode_name.empty() || mode_name == "Hierarchy") {
+        packed = false;
+      } else if (mode_name == "Packed") {
+        packed = true;
+      } else {
+        LOG(ERROR,
+            fmt::format("Unknown mode of counters \"{}\": Should be either "
+                        "\"Hierarchy\" or \"Packed\".",
+                        mode_name));
+        return;
+      }
+      std::unique_ptr<Sketch::SketchBase<key_len>> ptr;
+      DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+        DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+          using hash_fn = typename decltype(hash_tag)::type;
+          using reduce_fn = typename decltype(reduce_tag)::type;
+          ptr.reset(
+              new Sketch::CountingBloomFilter<key_len, hash_fn, reduce_fn>(
+                  ncnt, nhash, nbit, packed, seeds));
+        });
+      });
+      if (!ptr) // unknown hashing class or reduction policy
+        return;
+
+      this->testInsert(ptr, data.begin(),
+                       data_ptr); // metrics of interest are in config file
+      this->testLookup(ptr, gnd_truth,
+                       sample_truth); // metrics of interest are in config file
+      this->testLookupBatch(ptr, gnd_truth, sample_truth);
+      this->testSize(ptr);
+      if (!reduce_name.empty())
+        fmt::print("Reduction: {}\n", reduce_name);
+      if (!mode_name.empty())
+        fmt::print("Mode: {}\n", mode_name);
+      this->show();
+    }
+  }
 
   return;
 }
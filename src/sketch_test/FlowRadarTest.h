@@ -79,6 +79,18 @@ void FlowRadarTest<key_len, T, hash_t>::runTest() {
     return;
   if (!parser.parseConfig(count_table_hash, "count_table_hash"))
     return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  std::vector<std::string> probe_names; // [optional] probing modes
+  if (!parser.parseConfig(probe_names, "probe", false))
+    probe_names = {""}; // defaults to independent hashing
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
 
   // prepare data
   parser.setWorkingNode(FR_DATA_PATH);
@@ -95,16 +107,41 @@ void FlowRadarTest<key_len, T, hash_t>::runTest() {
   fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
              gnd_truth.size(), data_file);
 
-  std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr(
-      new Sketch::FlowRadar<key_len, T, hash_t>(
-          flow_filter_bit, flow_filter_hash, count_table_num,
-          count_table_hash));
-
-  this->testSize(ptr);
-  this->testUpdate(ptr, data.begin(), data.end(), Data::InPacket);
-  this->testDecode(ptr, gnd_truth);
-  // show
-  this->show();
+  for (const auto &reduce_name : reduce_names) {
+    for (const auto &probe_name : probe_names) {
+      bool double_hashing;
+      if (!ParseProbe(probe_name, double_hashing))
+        return;
+      std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr, batch_ptr;
+      DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+        DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+          using hash_fn = typename decltype(hash_tag)::type;
+          using reduce_fn = typename decltype(reduce_tag)::type;
+          using sketch_t = Sketch::FlowRadar<key_len, T, hash_fn, reduce_fn>;
+          ptr.reset(new sketch_t(flow_filter_bit, flow_filter_hash,
+                                 count_table_num, count_table_hash,
+                                 double_hashing, seeds));
+          batch_ptr.reset(new sketch_t(flow_filter_bit, flow_filter_hash,
+                                       count_table_num, count_table_hash,
+                                       double_hashing, seeds));
+        });
+      });
+      if (!ptr) // unknown hashing class or reduction policy
+        return;
+
+      this->testSize(ptr);
+      this->testUpdate(ptr, data.begin(), data.end(), Data::InPacket);
+      this->testUpdateBatch(batch_ptr, data.begin(), data.end(),
+                            Data::InPacket);
+      this->testDecode(ptr, gnd_truth);
+      // show
+      if (!reduce_name.empty())
+        fmt::print("Reduction: {}\n", reduce_name);
+      if (!probe_name.empty())
+        fmt::print("Probing: {}\n", probe_name);
+      this->show();
+    }
+  }
 
   return;
 }
@@ -85,6 +85,15 @@ void HashPipeTest<key_len, T, hash_t>::runTest() {
     return;
   if (!parser.parseConfig(width, "width"))
     return;
+  std::string hash_name; // [optional] hashing class, defaults to hash_t
+  parser.parseConfig(hash_name, "hash", false);
+  std::vector<std::string> reduce_names; // [optional] reduction policies
+  if (!parser.parseConfig(reduce_names, "reduce", false))
+    reduce_names = {""}; // defaults to Hash::PrimeMod
+  size_t seed; // [optional] seed of hashing classes, drawn afresh if absent
+  const Hash::SeedSequence seeds = parser.parseConfig(seed, "seed", false)
+                                       ? Hash::SeedSequence(seed)
+                                       : Hash::SeedSequence();
   /// Step v. To know about the data, we  switch to [HP.data].
   parser.setWorkingNode(HP_DATA_PATH);
   /// Step vi. Parse data and format
@@ -103,6 +112,8 @@ void HashPipeTest<key_len, T, hash_t>::runTest() {
   if (!method.compare("Percentile")) {
     hx_method = Data::Percentile;
   }
+  double num_heavy_changer = 0.0; // [optional] heavy changers, if positive
+  parser.parseConfig(num_heavy_changer, "threshold_heavy_changer", false);
   Data::CntMethod cnt_method = Data::InLength;
   if (!parser.parseConfig(method, "cnt_method"))
     return;
@@ -113,13 +124,7 @@ void HashPipeTest<key_len, T, hash_t>::runTest() {
   /// Part II.
   ///   Prepare sketch and data
   ///
-  /// Step i. Initialize a sketch
-  std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr(
-      new Sketch::HashPipe<key_len, T, hash_t>(depth, width));
-  /// remember that the left ptr must point to the base class in order to call
-  /// the methods in it
-
-  /// Step ii. Get ground truth
+  /// Step i. Get ground truth
   ///
   ///       1. read data
   StreamData data(data_file, format); // specify both data file and data format
@@ -132,25 +137,86 @@ void HashPipeTest<key_len, T, hash_t>::runTest() {
   ///       2. [optional] show data info
   fmt::print("DataSet: {:d} records with {:d} keys ({})\n", data.size(),
              gnd_truth.size(), data_file);
-  /// Step iii. Insert the samples and then look up all the flows
-  ///
-  ///        1. update records into the sketch
-  this->testUpdate(ptr, data.begin(), data.end(),
-                   cnt_method); // metrics of interest are in config file
-  ///        2. query for all the flowkeys
-  if (hx_method == Data::TopK) {
-    this->testHeavyHitter(
-        ptr, gnd_truth_heavy_hitters.min(),
-        gnd_truth_heavy_hitters); // metrics of interest are in config file
-  } else {
-    this->testHeavyHitter(
-        ptr, std::floor(gnd_truth.totalValue() * num_heavy_hitter + 1),
-        gnd_truth_heavy_hitters); // gnd_truth_heavy_hitter: >, yet HashPipe: >=
+  ///       3. [optional] get heavy changers between two halves of the data,
+  ///          with their threshold in absolute value
+  const auto mid = data.diff(data.size() / 2);
+  Data::GndTruth<key_len, T> gnd_truth_heavy_changers;
+  double threshold_heavy_changer = 0.0;
+  if (num_heavy_changer > 0) {
+    Data::GndTruth<key_len, T> gnd_truth_1, gnd_truth_2;
+    gnd_truth_1.getGroundTruth(data.begin(), mid, cnt_method);
+    gnd_truth_2.getGroundTruth(mid, data.end(), cnt_method);
+    if (hx_method == Data::Percentile) {
+      // gnd_truth_heavy_changer: >, yet the sketch: >=
+      Data::GndTruth<key_len, T> deviation;
+      deviation.getHeavyChanger(gnd_truth_1, gnd_truth_2, 0.0,
+                                Data::Percentile);
+      threshold_heavy_changer =
+          std::floor(deviation.totalValue() * num_heavy_changer + 1);
+    }
+    gnd_truth_heavy_changers.getHeavyChanger(std::move(gnd_truth_1),
+                                             std::move(gnd_truth_2),
+                                             num_heavy_changer, hx_method);
+    if (hx_method == Data::TopK)
+      threshold_heavy_changer = gnd_truth_heavy_changers.min();
+  }
+
+  for (const auto &reduce_name : reduce_names) {
+    /// Step ii. Initialize a sketch with the hashing class and the reduction
+    /// policy
+    std::unique_ptr<Sketch::SketchBase<key_len, T>> ptr, batch_ptr, ptr_1,
+        ptr_2;
+    DispatchHash<hash_t>(hash_name, [&](auto hash_tag) {
+      DispatchReduce<Hash::PrimeMod>(reduce_name, [&](auto reduce_tag) {
+        using hash_fn = typename decltype(hash_tag)::type;
+        using reduce_fn = typename decltype(reduce_tag)::type;
+        using sketch_t = Sketch::HashPipe<key_len, T, hash_fn, reduce_fn>;
+        ptr.reset(new sketch_t(depth, width, seeds));
+        batch_ptr.reset(new sketch_t(depth, width, seeds));
+        // replicas summarizing either half hash identically
+        ptr_1.reset(new sketch_t(depth, width, seeds));
+        ptr_2.reset(new sketch_t(depth, width, seeds));
+      });
+    });
+    if (!ptr) // unknown hashing class or reduction policy
+      return;
+    /// remember that the left ptr must point to the base class in order to
+    /// call the methods in it
+
+    /// Step iii. Insert the samples and then look up all the flows
+    ///
+    ///        1. update records into the sketch, and into its twin by
+    ///           batches
+    this->testUpdate(ptr, data.begin(), data.end(),
+                     cnt_method); // metrics of interest are in config file
+    this->testUpdateBatch(batch_ptr, data.begin(), data.end(), cnt_method);
+    ///        2. query for all the flowkeys
+    if (hx_method == Data::TopK) {
+      this->testHeavyHitter(
+          ptr, gnd_truth_heavy_hitters.min(),
+          gnd_truth_heavy_hitters); // metrics of interest are in config file
+    } else {
+      // gnd_truth_heavy_hitter: >, yet HashPipe: >=
+      this->testHeavyHitter(
+          ptr, std::floor(gnd_truth.totalValue() * num_heavy_hitter + 1),
+          gnd_truth_heavy_hitters);
+    }
+    this->testQueryBatch(ptr, gnd_truth);
+    ///        3. [optional] heavy changers between replicas summarizing
+    ///           either half of the data
+    if (num_heavy_changer > 0) {
+      ptr_1->updateBatch(&*data.begin(), mid - data.begin(), cnt_method);
+      ptr_2->updateBatch(&*mid, data.end() - mid, cnt_method);
+      this->testHeavyChanger(ptr_1, ptr_2, threshold_heavy_changer,
+                             gnd_truth_heavy_changers);
+    }
+    ///        4. size
+    this->testSize(ptr);
+    ///        5. show metrics
+    if (!reduce_name.empty())
+      fmt::print("Reduction: {}\n", reduce_name);
+    this->show();
   }
-  ///        3. size
-  this->testSize(ptr);
-  ///        3. show metrics
-  this->show();
 
   return;
 }
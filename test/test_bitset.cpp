@@ -0,0 +1,125 @@
+/**
+ * @file test_bitset.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Test kernels on blocks and arrays of bits
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "test_factory.h"
+#include <common/bitset.h>
+#include <vector>
+
+#define LOOP_TIMES_BITSET 1000
+#define WORDS_BITSET 101
+#define NIBBLES_BITSET 37
+
+/**
+ * @cond TEST
+ * @brief Test setting and testing bits of a split block against a plain loop
+ *
+ */
+void TestSplitBlock() {
+  using namespace OmniSketch::Sketch;
+
+  for (int i = 0; i < LOOP_TIMES_BITSET; ++i) {
+    const uint32_t h = rand();
+    const int32_t k = rand() % SplitBlock::words + 1;
+    // one bit in each of the first k words, by the top 5 bits
+    SplitBlock expected{};
+    for (int32_t j = 0; j < k; ++j) {
+      expected.word[j] = 1U << ((h * SplitBlockSalt[j]) >> 27);
+    }
+    SplitBlock block{};
+    VERIFY(!SplitBlockTest(block, h, k));
+    SplitBlockSet(block, h, k);
+    for (int32_t j = 0; j < SplitBlock::words; ++j) {
+      VERIFY(block.word[j] == expected.word[j]);
+    }
+    VERIFY(SplitBlockTest(block, h, k));
+    // any bit missing fails the test
+    const int32_t j = rand() % k;
+    block.word[j] = 0;
+    VERIFY(!SplitBlockTest(block, h, k));
+    // while bits of other keys do not matter
+    for (auto &word : block.word) {
+      word |= rand();
+    }
+    block.word[j] |= expected.word[j];
+    VERIFY(SplitBlockTest(block, h, k));
+  }
+}
+
+/**
+ * @brief Test combining and counting words against a plain loop
+ *
+ */
+void TestWords() {
+  using namespace OmniSketch::Sketch;
+
+  for (int i = 0; i < LOOP_TIMES_BITSET / 10; ++i) {
+    // long enough for both vectors and the scalar tail
+    const size_t n = rand() % (WORDS_BITSET * 2);
+    std::vector<uint64_t> a(n), b(n), both(n), either(n);
+    size_t cnt = 0;
+    for (size_t j = 0; j < n; ++j) {
+      a[j] = (static_cast<uint64_t>(rand()) << 32) ^ rand();
+      b[j] = (static_cast<uint64_t>(rand()) << 32) ^ rand();
+      both[j] = a[j] & b[j];
+      either[j] = a[j] | b[j];
+      for (uint64_t w = a[j]; w; w >>= 1) {
+        cnt += w & 1;
+      }
+    }
+    VERIFY(PopCount(a.data(), n) == cnt);
+    std::vector<uint64_t> c = a;
+    BitwiseAnd(c.data(), b.data(), n);
+    VERIFY(c == both);
+    c = a;
+    BitwiseOr(c.data(), b.data(), n);
+    VERIFY(c == either);
+  }
+}
+
+/**
+ * @brief Test testing packed nibbles against a plain loop
+ *
+ */
+void TestNibbles() {
+  using namespace OmniSketch::Sketch;
+
+  for (int i = 0; i < LOOP_TIMES_BITSET; ++i) {
+    // nibbles in the last byte read into the padding
+    std::vector<uint8_t> arr((NIBBLES_BITSET + 1) / 2 + NibblePadding);
+    std::vector<uint8_t> value(NIBBLES_BITSET);
+    for (int32_t j = 0; j < NIBBLES_BITSET; ++j) {
+      value[j] = rand() % 16;
+      arr[j / 2] |= value[j] << (j % 2 * 4);
+    }
+    for (auto iter = arr.end() - NibblePadding; iter != arr.end(); ++iter) {
+      *iter = rand(); // must not be read as nibbles
+    }
+    // both fewer and more than a vector of nibbles, possibly repeated
+    const int32_t k = rand() % 20 + 1;
+    std::vector<int32_t> idx(k);
+    bool expected = true;
+    for (auto &index : idx) {
+      index = rand() % NIBBLES_BITSET;
+      expected &= value[index] != 0;
+    }
+    VERIFY(NibbleAllNonZero(arr.data(), idx.data(), k) == expected);
+  }
+}
+
+/**
+ * @brief Bitset test
+ *
+ */
+OMNISKETCH_DECLARE_TEST(bitset) {
+  for (int i = 0; i < g_repeat; ++i) {
+    TestSplitBlock();
+    TestWords();
+    TestNibbles();
+  }
+}
+/** @endcond */
@@ -0,0 +1,114 @@
+/**
+ * @file test_concurrent.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Test sketches updated by threads at the same time
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "test_factory.h"
+#include <cstdio>
+#include <map>
+#include <sketch/CMSketch.h>
+#include <sketch/ConcurrentCUSketch.h>
+#include <thread>
+#include <vector>
+
+#define THREADS_CONCURRENT 4
+#define LOOP_TIMES_CONCURRENT 20000
+#define KEYS_CONCURRENT 1000
+#define DEPTH_CONCURRENT 4
+#define WIDTH_CONCURRENT 101
+
+/**
+ * @cond TEST
+ * @brief Counters of a sketch, read out of its snapshot
+ *
+ */
+template <typename sketch_t>
+std::vector<int32_t> CountersOf(const sketch_t &sketch) {
+  using namespace OmniSketch::Sketch;
+
+  char name[L_tmpnam];
+  std::tmpnam(name);
+  SnapshotWriter writer;
+  sketch.save(writer);
+  writer.write(name, "counters");
+  SnapshotReader reader(name);
+  const size_t n = static_cast<size_t>(reader.get<int32_t>("depth")) *
+                   reader.get<int32_t>("width");
+  const int32_t *counter =
+      reader.sub("counter").template map<int32_t>("counter", n);
+  std::vector<int32_t> vec(counter, counter + n);
+  std::remove(name);
+  return vec;
+}
+
+/**
+ * @brief Test concurrent conservative updates against a Count Min Sketch of
+ * the same stream
+ *
+ */
+void TestConcurrentCU() {
+  using namespace OmniSketch;
+
+  std::vector<FlowKey<13>> keys(KEYS_CONCURRENT);
+  for (auto &key : keys) {
+    key = FlowKey<13>(rand(), rand(), rand(), rand(), rand());
+  }
+  // updates of each thread, with few counters to contend for
+  std::vector<std::vector<std::pair<int32_t, int32_t>>> stream(
+      THREADS_CONCURRENT);
+  for (auto &updates : stream) {
+    for (int i = 0; i < LOOP_TIMES_CONCURRENT; ++i) {
+      updates.emplace_back(rand() % KEYS_CONCURRENT, rand() % 5 + 1);
+    }
+  }
+
+  const Hash::SeedSequence seeds(rand());
+  Sketch::ConcurrentCUSketch<13, int32_t> cu(DEPTH_CONCURRENT,
+                                             WIDTH_CONCURRENT, seeds);
+  std::vector<std::thread> threads;
+  for (const auto &updates : stream) {
+    threads.emplace_back([&cu, &keys, &updates] {
+      for (const auto &[key, val] : updates) {
+        cu.update(keys[key], val);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  Sketch::CMSketch<13, int32_t> cm(DEPTH_CONCURRENT, WIDTH_CONCURRENT, false,
+                                   0, seeds);
+  std::map<int32_t, int32_t> truth;
+  for (const auto &updates : stream) {
+    for (const auto &[key, val] : updates) {
+      cm.update(keys[key], val);
+      truth[key] += val;
+    }
+  }
+  // every counter is at most that of Count Min
+  const std::vector<int32_t> cu_cnt = CountersOf(cu), cm_cnt = CountersOf(cm);
+  VERIFY(cu_cnt.size() == cm_cnt.size());
+  for (size_t i = 0; i < cu_cnt.size(); ++i) {
+    VERIFY(cu_cnt[i] <= cm_cnt[i]);
+  }
+  // while no flowkey is underestimated
+  for (const auto &[key, val] : truth) {
+    VERIFY(cu.query(keys[key]) >= val);
+    VERIFY(cu.query(keys[key]) <= cm.query(keys[key]));
+  }
+}
+
+/**
+ * @brief Concurrent test
+ *
+ */
+OMNISKETCH_DECLARE_TEST(concurrent) {
+  for (int i = 0; i < g_repeat; ++i) {
+    TestConcurrentCU();
+  }
+}
+/** @endcond */
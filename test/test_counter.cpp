@@ -0,0 +1,235 @@
+/**
+ * @file test_counter.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Test arrays of counters
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "test_factory.h"
+#include <common/counter.h>
+#include <limits>
+#include <vector>
+
+#define LOOP_TIMES_COUNTER 1000
+#define MAX_ROWS_COUNTER 19
+#define WIDTH_COUNTER 101
+
+/**
+ * @cond TEST
+ * @brief Test gathering minimum against a plain loop
+ *
+ */
+template <typename counter_t> void TestGatherMin() {
+  using OmniSketch::Sketch::GatherMin;
+
+  // with room for the gather to read past the end
+  std::vector<counter_t> base(WIDTH_COUNTER + 3);
+  for (int i = 0; i < LOOP_TIMES_COUNTER; ++i) {
+    for (auto &cnt : base) {
+      cnt = static_cast<counter_t>(rand());
+    }
+    for (int32_t n = 1; n <= MAX_ROWS_COUNTER; ++n) {
+      std::vector<int32_t> pos(n);
+      counter_t expected = std::numeric_limits<counter_t>::max();
+      for (auto &p : pos) {
+        p = rand() % WIDTH_COUNTER;
+        expected = std::min(expected, base[p]);
+      }
+      VERIFY(GatherMin(base.data(), pos.data(), n) == expected);
+    }
+  }
+}
+
+/**
+ * @brief Test saturating addition and subtraction against a plain loop
+ *
+ */
+template <typename counter_t> void TestSaturatingArith() {
+  using OmniSketch::Sketch::SaturatingAdd;
+  using OmniSketch::Sketch::SaturatingSub;
+  constexpr int64_t hi = std::numeric_limits<counter_t>::max();
+  constexpr int64_t lo = std::numeric_limits<counter_t>::lowest();
+
+  for (int i = 0; i < LOOP_TIMES_COUNTER / 10; ++i) {
+    // long enough for both vectors and the scalar tail
+    const size_t n = rand() % (WIDTH_COUNTER * 2);
+    std::vector<counter_t> a(n), b(n), sum(n), diff(n);
+    for (size_t j = 0; j < n; ++j) {
+      // bounds are picked often, so that saturation takes place
+      a[j] = rand() % 8 ? static_cast<counter_t>(rand()) : counter_t(hi);
+      b[j] = rand() % 8 ? static_cast<counter_t>(rand()) : counter_t(lo);
+      sum[j] = static_cast<counter_t>(
+          std::clamp(static_cast<int64_t>(a[j]) + b[j], lo, hi));
+      diff[j] = static_cast<counter_t>(
+          std::clamp(static_cast<int64_t>(a[j]) - b[j], lo, hi));
+    }
+    std::vector<counter_t> c = a;
+    SaturatingAdd(c.data(), b.data(), n);
+    VERIFY(c == sum);
+    c = a;
+    SaturatingSub(c.data(), b.data(), n);
+    VERIFY(c == diff);
+  }
+}
+
+/**
+ * @brief Test counters that merely saturate
+ *
+ */
+template <typename counter_t> void TestSaturation() {
+  using OmniSketch::Sketch::CounterArray;
+  constexpr int64_t hi = std::numeric_limits<counter_t>::max();
+  constexpr int64_t lo = std::numeric_limits<counter_t>::lowest();
+
+  CounterArray<int64_t, counter_t> counter(2, WIDTH_COUNTER);
+  counter.add(0, 1, hi);
+  VERIFY(counter.get(0, 1) == hi);
+  counter.add(0, 1, 1);
+  VERIFY(counter.get(0, 1) == hi);
+  counter.add(0, 1, -1);
+  VERIFY(counter.get(0, 1) == hi - 1);
+  counter.set(1, 7, lo - 5);
+  VERIFY(counter.get(1, 7) == lo);
+  counter.add(1, 7, 2);
+  VERIFY(counter.get(1, 7) == lo + 2);
+  // never touch other counters
+  VERIFY(counter.get(0, 0) == 0 && counter.get(1, 1) == 0);
+  VERIFY(counter.size() == 2 * WIDTH_COUNTER * sizeof(counter_t));
+  // minimum
+  int32_t cols[2] = {1, 7};
+  VERIFY(counter.min(cols) == lo + 2);
+  counter.clear();
+  VERIFY(counter.min(cols) == 0);
+}
+
+/**
+ * @brief Test counters that escalate to the side table against plain
+ * counters
+ *
+ */
+template <typename counter_t> void TestEscalation() {
+  using OmniSketch::Sketch::CounterArray;
+  constexpr int32_t depth = 3, width = 5;
+  constexpr int64_t hi = std::numeric_limits<counter_t>::max();
+
+  CounterArray<int64_t, counter_t> counter(depth, width, true);
+  CounterArray<int64_t> plain(depth, width);
+  for (int i = 0; i < LOOP_TIMES_COUNTER; ++i) {
+    const int32_t row = rand() % depth, col = rand() % width;
+    // mostly increments, but large enough to saturate and come back, and
+    // below zero even for unsigned counters
+    const int64_t val = rand() % (hi / 2 + 2) - hi / 8;
+    if (rand() % 4) {
+      counter.add(row, col, val);
+      plain.add(row, col, val);
+    } else {
+      counter.set(row, col, val * 3);
+      plain.set(row, col, val * 3);
+    }
+    for (int32_t r = 0; r < depth; ++r) {
+      for (int32_t c = 0; c < width; ++c) {
+        VERIFY(counter.get(r, c) == plain.get(r, c));
+      }
+    }
+    int32_t cols[depth];
+    for (auto &c : cols) {
+      c = rand() % width;
+    }
+    VERIFY(counter.min(cols) == plain.min(cols));
+  }
+  VERIFY(counter.size() >= depth * width * sizeof(counter_t));
+
+  // merge and subtract, with or without the side table on the other side
+  CounterArray<int64_t, counter_t> other(depth, width, rand() % 2);
+  CounterArray<int64_t> other_plain(depth, width);
+  for (int32_t r = 0; r < depth; ++r) {
+    for (int32_t c = 0; c < width; ++c) {
+      const int64_t val = rand() % (hi + 1);
+      other.set(r, c, val);
+      other_plain.set(r, c, val);
+    }
+  }
+  counter.merge(other);
+  plain.merge(other_plain);
+  for (int32_t r = 0; r < depth; ++r) {
+    for (int32_t c = 0; c < width; ++c) {
+      VERIFY(counter.get(r, c) == plain.get(r, c));
+    }
+  }
+  counter.subtract(other);
+  plain.subtract(other_plain);
+  for (int32_t r = 0; r < depth; ++r) {
+    for (int32_t c = 0; c < width; ++c) {
+      VERIFY(counter.get(r, c) == plain.get(r, c));
+    }
+  }
+}
+
+/**
+ * @brief Test values below zero in unsigned counters of signed values
+ *
+ */
+template <typename counter_t> void TestUnsignedBelowZero() {
+  using OmniSketch::Sketch::CounterArray;
+
+  // merely saturating at zero
+  CounterArray<int64_t, counter_t> counter(2, WIDTH_COUNTER);
+  counter.add(1, 3, -5);
+  VERIFY(counter.get(1, 3) == 0);
+  counter.add(1, 3, 7);
+  VERIFY(counter.get(1, 3) == 7);
+
+  // escalating what is below zero
+  CounterArray<int64_t, counter_t> escalated(2, WIDTH_COUNTER, true);
+  escalated.add(1, 3, -5);
+  VERIFY(escalated.get(1, 3) == -5);
+  int32_t cols[2] = {0, 3};
+  VERIFY(escalated.min(cols) == -5);
+  escalated.add(1, 3, 7);
+  VERIFY(escalated.get(1, 3) == 2);
+  VERIFY(escalated.min(cols) == 0);
+  // and so is a difference below zero
+  CounterArray<int64_t, counter_t> other(2, WIDTH_COUNTER);
+  other.add(1, 3, 9);
+  escalated.subtract(other);
+  VERIFY(escalated.get(1, 3) == -7);
+  escalated.merge(other);
+  VERIFY(escalated.get(1, 3) == 2);
+  // never touch other counters
+  VERIFY(escalated.get(0, 3) == 0 && escalated.get(1, 4) == 0);
+}
+
+/**
+ * @brief Counter test
+ *
+ */
+OMNISKETCH_DECLARE_TEST(counter) {
+  for (int i = 0; i < g_repeat; ++i) {
+    TestGatherMin<uint8_t>();
+    TestGatherMin<int8_t>();
+    TestGatherMin<uint16_t>();
+    TestGatherMin<int16_t>();
+    TestGatherMin<uint32_t>();
+    TestGatherMin<int32_t>();
+    TestSaturatingArith<uint8_t>();
+    TestSaturatingArith<int8_t>();
+    TestSaturatingArith<uint16_t>();
+    TestSaturatingArith<int16_t>();
+    TestSaturatingArith<uint32_t>();
+    TestSaturatingArith<int32_t>();
+    TestSaturation<uint8_t>();
+    TestSaturation<int8_t>();
+    TestSaturation<uint16_t>();
+    TestSaturation<int16_t>();
+    TestSaturation<uint32_t>();
+    TestSaturation<int32_t>();
+    TestEscalation<int8_t>();
+    TestEscalation<int16_t>();
+    TestEscalation<uint8_t>();
+    TestEscalation<uint16_t>();
+    TestUnsignedBelowZero<uint8_t>();
+    TestUnsignedBelowZero<uint16_t>();
+  }
+}
+/** @endcond */
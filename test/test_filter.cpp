@@ -0,0 +1,165 @@
+/**
+ * @file test_filter.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Test Cuckoo and Xor filters
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "test_factory.h"
+#include <algorithm>
+#include <memory>
+#include <sketch/CuckooFilter.h>
+#include <sketch/XorFilter.h>
+#include <unordered_set>
+#include <vector>
+
+#define KEYS_FILTER 6000
+#define BUCKETS_FILTER 2003
+#define FULL_BUCKETS_FILTER 101
+
+/**
+ * @cond TEST
+ * @brief Distinct random flowkeys
+ *
+ */
+std::vector<OmniSketch::FlowKey<13>> DistinctKeys(size_t n) {
+  using namespace OmniSketch;
+
+  std::unordered_set<FlowKey<13>> keys;
+  while (keys.size() < n) {
+    keys.insert(FlowKey<13>(rand(), rand(), rand(), rand(), rand()));
+  }
+  return std::vector<FlowKey<13>>(keys.begin(), keys.end());
+}
+
+/**
+ * @brief Test that no flowkey inserted and not removed is missed
+ *
+ */
+void TestCuckooRemove() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  CuckooFilter<13> filter(BUCKETS_FILTER, Hash::SeedSequence(rand()));
+  const auto keys = DistinctKeys(KEYS_FILTER);
+  for (const auto &key : keys) {
+    filter.insert(key);
+  }
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    filter.remove(keys[i]);
+  }
+  for (size_t i = 1; i < keys.size(); i += 2) {
+    VERIFY(filter.lookup(keys[i]));
+  }
+  // a flowkey inserted twice keeps an entry after one removal, as do
+  // colliding flowkeys
+  filter.insert(keys[1]);
+  filter.remove(keys[1]);
+  VERIFY(filter.lookup(keys[1]));
+  filter.insertIfAbsent(keys[0]);
+  VERIFY(filter.lookup(keys[0]));
+  bool out[KEYS_FILTER];
+  filter.lookupBatch(keys.data(), keys.size(), out);
+  for (size_t i = 1; i < keys.size(); i += 2) {
+    VERIFY(out[i]);
+  }
+}
+
+/**
+ * @brief Test a full filter, whose last evicted fingerprint is kept aside
+ * and put back once a removal makes room
+ *
+ */
+void TestCuckooVictim() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  CuckooFilter<13> filter(FULL_BUCKETS_FILTER, Hash::SeedSequence(rand()));
+  // more than it can hold
+  const auto keys = DistinctKeys(4 * FULL_BUCKETS_FILTER + 1);
+  size_t inserted = 0;
+  try {
+    for (const auto &key : keys) {
+      filter.insert(key);
+      inserted++;
+    }
+    SET_FAILURE_FLAG;
+  } catch (const std::length_error &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+  // the one that threw is not inserted
+  for (size_t i = 0; i < inserted; ++i) {
+    VERIFY(filter.lookup(keys[i]));
+  }
+  // remove one by one, with the fingerprint aside put back on the way
+  for (size_t i = 0; i < inserted / 2; ++i) {
+    filter.remove(keys[i]);
+    for (size_t j = i + 1; j < inserted; ++j) {
+      VERIFY(filter.lookup(keys[j]));
+    }
+  }
+  // room is made again
+  try {
+    for (size_t i = 0; i < inserted / 4; ++i) {
+      filter.insert(keys[i]);
+    }
+  } catch (const std::length_error &exp) {
+    VERIFY_NO_EXCEPTION(exp);
+  }
+  for (size_t i = 0; i < inserted / 4; ++i) {
+    VERIFY(filter.lookup(keys[i]));
+  }
+  filter.clear();
+  filter.insert(keys[0]);
+  VERIFY(filter.lookup(keys[0]));
+}
+
+/**
+ * @brief Test an Xor Filter built from `n` flowkeys
+ *
+ */
+void TestXor(size_t n) {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  const auto keys = DistinctKeys(n);
+  // each flowkey twice, which is built from once
+  std::vector<Data::Record<13>> records;
+  for (const auto &key : keys) {
+    records.push_back({key, 0, 0});
+    records.push_back({key, 0, 0});
+  }
+  const Hash::SeedSequence seeds(rand());
+  XorFilter<13> filter(seeds);
+  VERIFY(!filter.lookup(FlowKey<13>(rand(), rand(), rand(), rand(), rand())));
+  filter.insertBatch(records.data(), records.size());
+  for (const auto &key : keys) {
+    VERIFY(filter.lookup(key));
+  }
+  std::unique_ptr<bool[]> out(new bool[n]);
+  filter.lookupBatch(keys.data(), n, out.get());
+  VERIFY(std::all_of(out.get(), out.get() + n, [](bool b) { return b; }));
+  // about 1.23 bytes per flowkey
+  VERIFY(filter.size() <= sizeof(filter) + 1.23 * n + 32);
+  // rebuilt from the other half
+  filter.insertBatch(records.data() + n, n);
+  for (size_t i = n / 2; i < n; ++i) {
+    VERIFY(filter.lookup(keys[i]));
+  }
+}
+
+/**
+ * @brief Filter test
+ *
+ */
+OMNISKETCH_DECLARE_TEST(filter) {
+  for (int i = 0; i < g_repeat; ++i) {
+    TestCuckooRemove();
+    TestCuckooVictim();
+    TestXor(0);
+    TestXor(1);
+    TestXor(KEYS_FILTER);
+  }
+}
+/** @endcond */
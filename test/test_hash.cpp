@@ -0,0 +1,218 @@
+/**
+ * @file test_hash.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Test hashing classes
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "test_factory.h"
+#include <algorithm>
+#include <common/hash.h>
+#include <vector>
+
+#define LOOP_TIMES_HASH 1000
+#define NUM_ROWS_HASH 11
+#define MAX_BATCH_HASH 67
+
+/**
+ * @cond TEST
+ * @brief Test multi-row hashing against row-by-row hashing
+ *
+ */
+template <typename hash_t> void TestMultiHash() {
+  using namespace OmniSketch;
+
+  hash_t hash_fns[NUM_ROWS_HASH];
+  uint64_t hashed[NUM_ROWS_HASH];
+  for (int i = 0; i < LOOP_TIMES_HASH; ++i) {
+    FlowKey<13> key_13(rand(), rand(), rand(), rand(), rand());
+    FlowKey<8> key_8(rand(), rand());
+    FlowKey<4> key_4(rand());
+
+    for (int32_t num = 0; num <= NUM_ROWS_HASH; ++num) {
+      hash_t::multiHash(hash_fns, num, key_13, hashed);
+      for (int32_t j = 0; j < num; ++j) {
+        VERIFY(hashed[j] == hash_fns[j](key_13));
+      }
+    }
+    hash_t::multiHash(hash_fns, NUM_ROWS_HASH, key_8, hashed);
+    for (int32_t j = 0; j < NUM_ROWS_HASH; ++j) {
+      VERIFY(hashed[j] == hash_fns[j](key_8));
+    }
+    hash_t::multiHash(hash_fns, NUM_ROWS_HASH, key_4, hashed);
+    for (int32_t j = 0; j < NUM_ROWS_HASH; ++j) {
+      VERIFY(hashed[j] == hash_fns[j](key_4));
+    }
+  }
+}
+
+/**
+ * @brief Test batch hashing against one-by-one hashing
+ *
+ */
+template <typename hash_t, int32_t key_len> void TestHashBatch() {
+  using namespace OmniSketch;
+
+  hash_t hash_fn;
+  std::vector<FlowKey<key_len>> keys;
+  std::vector<uint64_t> hashed;
+  for (size_t n = 0; n <= MAX_BATCH_HASH; ++n) {
+    // random bytes, including those above 0x7f
+    keys.resize(n);
+    for (auto &key : keys) {
+      for (int32_t j = 0; j < key_len; ++j) {
+        int8_t byte = static_cast<int8_t>(rand());
+        key.copy(j, &byte, 1);
+      }
+    }
+    hashed.assign(n + 1, 0xdeadbeef);
+    hash_fn.hashBatch(keys.data(), n, hashed.data());
+    for (size_t i = 0; i < n; ++i) {
+      VERIFY(hashed[i] == hash_fn(keys[i]));
+    }
+    // never write past the end
+    VERIFY(hashed[n] == 0xdeadbeef);
+  }
+}
+
+/**
+ * @brief Test a statically dispatched hashing class against its virtual
+ * counterpart
+ *
+ */
+template <typename static_t, typename hash_t> void TestStaticHash() {
+  using namespace OmniSketch;
+
+  hash_t hash_fns[NUM_ROWS_HASH];
+  std::vector<static_t> static_fns(hash_fns, hash_fns + NUM_ROWS_HASH);
+  uint64_t hashed[NUM_ROWS_HASH];
+  for (int i = 0; i < LOOP_TIMES_HASH; ++i) {
+    FlowKey<13> key_13(rand(), rand(), rand(), rand(), rand());
+    FlowKey<8> key_8(rand(), rand());
+    FlowKey<4> key_4(rand());
+    size_t val = rand();
+    auto bytes = reinterpret_cast<const uint8_t *>(key_13.cKey());
+
+    for (int32_t j = 0; j < NUM_ROWS_HASH; ++j) {
+      VERIFY(static_fns[j](key_13) == hash_fns[j](key_13));
+      VERIFY(static_fns[j](key_8) == hash_fns[j](key_8));
+      VERIFY(static_fns[j](key_4) == hash_fns[j](key_4));
+      VERIFY(static_fns[j](val) == hash_fns[j](val));
+      VERIFY(static_fns[j](bytes, 7) == hash_fns[j](bytes, 7));
+    }
+    static_t::multiHash(static_fns.data(), NUM_ROWS_HASH, key_13, hashed);
+    for (int32_t j = 0; j < NUM_ROWS_HASH; ++j) {
+      VERIFY(hashed[j] == hash_fns[j](key_13));
+    }
+  }
+}
+
+/**
+ * @brief Test against reference values published along with the algorithms
+ *
+ */
+void TestReferenceValues() {
+  using namespace OmniSketch::Hash;
+
+  auto bytes = [](const char *str) {
+    return reinterpret_cast<const uint8_t *>(str);
+  };
+  const char *fox = "The quick brown fox jumps over the lazy dog";
+
+  VERIFY(XXHash64(0)(bytes(""), 0) == 0xEF46DB3751D8E999ULL);
+  VERIFY(XXHash64(0)(bytes("abc"), 3) == 0x44BC2CF5AD770999ULL);
+  VERIFY(XXHash64(0)(bytes(fox), 43) == 0x0B242D361FDA71BCULL);
+  VERIFY(MurmurHash3(0)(bytes(""), 0) == 0);
+  VERIFY(MurmurHash3(0)(bytes("hello"), 5) == 0xCBD8A7B341BD9B02ULL);
+  VERIFY(MurmurHash3(0)(bytes(fox), 43) == 0xE34BBC7BBC071B6CULL);
+  VERIFY(CRC32C(0)(bytes("123456789"), 9) == 0xE3069283U);
+  VERIFY(CRC32C(0)(bytes(fox), 43) == 0x22620404U);
+  // the first outputs of splitmix64 seeded with 0
+  VERIFY(Remix(0x9E3779B97F4A7C15ULL) == 0xE220A8397B1DCDAFULL);
+  VERIFY(Remix(0x3C6EF372FE94F82AULL) == 0x6E789E6AA1B965F4ULL);
+}
+
+/**
+ * @brief Test that hashing classes built with the same seed hash identically
+ *
+ */
+template <typename hash_t> void TestSeed() {
+  using namespace OmniSketch;
+
+  const uint64_t seed = (static_cast<uint64_t>(rand()) << 32) ^ rand();
+  hash_t a(seed), b(seed), c(seed + 1);
+  bool differ = false;
+  for (int i = 0; i < LOOP_TIMES_HASH; ++i) {
+    FlowKey<13> key(rand(), rand(), rand(), rand(), rand());
+    VERIFY(a(key) == b(key));
+    differ |= a(key) != c(key);
+  }
+  VERIFY(differ);
+  // so are those made from the same SeedSequence
+  Hash::SeedSequence seeds(seed);
+  hash_t *x = seeds.make<hash_t>(NUM_ROWS_HASH);
+  std::vector<hash_t> y = seeds.makeVector<hash_t>(NUM_ROWS_HASH);
+  FlowKey<13> key(rand(), rand(), rand(), rand(), rand());
+  for (int32_t j = 0; j < NUM_ROWS_HASH; ++j) {
+    VERIFY(x[j](key) == y[j](key));
+    VERIFY(x[j](key) == hash_t(seeds[j])(key));
+  }
+  delete[] x;
+}
+
+/**
+ * @brief Test derivation of seeds
+ *
+ */
+void TestSeedSequence() {
+  using OmniSketch::Hash::SeedSequence;
+
+  const uint64_t seed = rand();
+  SeedSequence seeds(seed);
+  VERIFY(seeds.seed() == seed);
+  VERIFY(seeds[0] == SeedSequence(seed)[0]);
+  VERIFY(seeds.fork(1).seed() == SeedSequence(seed).fork(1).seed());
+  // seeds in a sequence and in forked sequences all differ
+  std::vector<uint64_t> drawn;
+  for (size_t i = 0; i < NUM_ROWS_HASH; ++i) {
+    drawn.push_back(seeds[i]);
+    drawn.push_back(seeds.fork(0)[i]);
+    drawn.push_back(seeds.fork(1)[i]);
+  }
+  std::sort(drawn.begin(), drawn.end());
+  VERIFY(std::unique(drawn.begin(), drawn.end()) == drawn.end());
+  // default-constructed ones differ
+  VERIFY(SeedSequence().seed() != SeedSequence().seed());
+}
+
+/**
+ * @brief Hash test
+ *
+ */
+OMNISKETCH_DECLARE_TEST(hash) {
+  using namespace OmniSketch::Hash;
+  for (int i = 0; i < g_repeat; ++i) {
+    TestMultiHash<AwareHash>();
+    TestHashBatch<AwareHash, 4>();
+    TestHashBatch<AwareHash, 8>();
+    TestHashBatch<AwareHash, 13>();
+    TestStaticHash<StaticAwareHash, AwareHash>();
+    TestMultiHash<StaticAwareHash>();
+    TestHashBatch<StaticAwareHash, 13>();
+    TestReferenceValues();
+    TestMultiHash<XXHash64>();
+    TestMultiHash<MurmurHash3>();
+    TestMultiHash<CRC32C>();
+    TestMultiHash<TabulationHash>();
+    TestHashBatch<TabulationHash, 13>();
+    TestSeedSequence();
+    TestSeed<AwareHash>();
+    TestSeed<StaticAwareHash>();
+    TestSeed<XXHash64>();
+    TestSeed<MurmurHash3>();
+    TestSeed<CRC32C>();
+    TestSeed<TabulationHash>();
+  }
+}
+/** @endcond */
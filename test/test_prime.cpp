@@ -7,9 +7,11 @@
  *
  */
 #include "test_factory.h"
+#include <algorithm>
 #include <common/utils.h>
 
 #define LOOP_TIMES_PRIME 6
+#define LOOP_TIMES_MEDIAN 1000
 
 /**
  * @cond TEST
@@ -137,6 +139,28 @@ void TestMangle() {
   }
 }
 
+/**
+ * @brief Test Median() against sorting, on all numbers of values up to 9
+ *
+ */
+void TestMedian() {
+  using OmniSketch::Util::Median;
+
+  for (int32_t n = 1; n <= 9; ++n) {
+    for (int i = 0; i < LOOP_TIMES_MEDIAN; i++) {
+      int64_t values[9], sorted[9];
+      for (int32_t j = 0; j < n; ++j) {
+        // few distinct values, so that ties are common
+        values[j] = sorted[j] = rand() % 7 - 3;
+      }
+      std::sort(sorted, sorted + n);
+      const int64_t median = (n & 1) ? sorted[n / 2]
+                                     : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+      VERIFY(Median(values, n) == median);
+    }
+  }
+}
+
 /**
  * @brief Prime test
  *
@@ -145,6 +169,7 @@ OMNISKETCH_DECLARE_TEST(prime) {
   for (int i = 0; i < g_repeat; ++i) {
     TestIsPrime();
     TestNextPrime();
+    TestMedian();
   }
 }
 /** @endcond */
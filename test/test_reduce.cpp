@@ -0,0 +1,145 @@
+/**
+ * @file test_reduce.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Test reduction policies
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "test_factory.h"
+#include <common/reduce.h>
+#include <vector>
+
+#define LOOP_TIMES_REDUCE 10000
+
+/**
+ * @cond TEST
+ * @brief A random 64-bit hashed value
+ *
+ */
+uint64_t RandomHashed() {
+  return (static_cast<uint64_t>(rand()) << 33) ^
+         (static_cast<uint64_t>(rand()) << 11) ^ rand();
+}
+
+/**
+ * @brief Widths to test against, both small and large
+ *
+ */
+std::vector<int32_t> TestWidths() {
+  return {1, 2, 3, 7, 64, 1000, 80001, 1 << 20, 12340033, 1 << 30};
+}
+
+/**
+ * @brief Test that indices lie in range
+ *
+ */
+template <typename reduce_t> void TestRange() {
+  for (int32_t w : TestWidths()) {
+    const int32_t width = reduce_t::adjust(w);
+    VERIFY(width >= w);
+    const reduce_t reduce(width);
+    for (int i = 0; i < LOOP_TIMES_REDUCE; ++i) {
+      const int32_t index = reduce(RandomHashed());
+      VERIFY(index >= 0 && index < width);
+    }
+    // extremes
+    VERIFY(reduce(0) >= 0 && reduce(0) < width);
+    VERIFY(reduce(UINT64_MAX) >= 0 && reduce(UINT64_MAX) < width);
+  }
+}
+
+/**
+ * @brief Test policies that are expected to compute a remainder
+ *
+ */
+void TestRemainder() {
+  using namespace OmniSketch::Hash;
+  using OmniSketch::Util::NextPrime;
+
+  for (int32_t w : TestWidths()) {
+    VERIFY(PrimeMod::adjust(w) == NextPrime(w));
+    VERIFY(Mod::adjust(w) == w);
+    VERIFY(Reciprocal::adjust(w) == w);
+    const PrimeMod prime_mod(NextPrime(w));
+    const Mod mod(w);
+    const Reciprocal reciprocal(w);
+    for (int i = 0; i < LOOP_TIMES_REDUCE; ++i) {
+      const uint64_t hashed = RandomHashed();
+      VERIFY(prime_mod(hashed) == static_cast<int32_t>(hashed % NextPrime(w)));
+      VERIFY(mod(hashed) == static_cast<int32_t>(hashed % w));
+      VERIFY(reciprocal(hashed) == static_cast<int32_t>(Fold(hashed) % w));
+    }
+  }
+}
+
+/**
+ * @brief Test rounding of Pow2
+ *
+ */
+void TestPow2() {
+  using OmniSketch::Hash::Pow2;
+
+  try {
+    VERIFY(Pow2::adjust(1) == 1);
+    VERIFY(Pow2::adjust(2) == 2);
+    VERIFY(Pow2::adjust(3) == 4);
+    VERIFY(Pow2::adjust(80001) == 131072);
+    VERIFY(Pow2::adjust(1 << 30) == 1 << 30);
+  } catch (const std::out_of_range &exp) {
+    VERIFY_NO_EXCEPTION(exp);
+  }
+  // invalid argument
+  try {
+    VERIFY(Pow2::adjust(0));
+    SET_FAILURE_FLAG;
+  } catch (const std::out_of_range &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+  try {
+    VERIFY(Pow2::adjust((1 << 30) + 1));
+    SET_FAILURE_FLAG;
+  } catch (const std::out_of_range &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+}
+
+/**
+ * @brief Test that hashed values spread evenly over a small width
+ *
+ */
+template <typename reduce_t> void TestUniformity() {
+  const int32_t width = reduce_t::adjust(16);
+  const reduce_t reduce(width);
+  std::vector<int32_t> count(width);
+  for (int i = 0; i < LOOP_TIMES_REDUCE * width; ++i) {
+    count[reduce(RandomHashed())]++;
+  }
+  for (int32_t c : count) {
+    // 10% off the expectation is far beyond 10 sigma
+    VERIFY(c > LOOP_TIMES_REDUCE * 0.9 && c < LOOP_TIMES_REDUCE * 1.1);
+  }
+}
+
+/**
+ * @brief Reduce test
+ *
+ */
+OMNISKETCH_DECLARE_TEST(reduce) {
+  using namespace OmniSketch::Hash;
+  for (int i = 0; i < g_repeat; ++i) {
+    TestRange<PrimeMod>();
+    TestRange<Mod>();
+    TestRange<Lemire>();
+    TestRange<Pow2>();
+    TestRange<Reciprocal>();
+    TestRemainder();
+    TestPow2();
+    TestUniformity<PrimeMod>();
+    TestUniformity<Mod>();
+    TestUniformity<Lemire>();
+    TestUniformity<Pow2>();
+    TestUniformity<Reciprocal>();
+  }
+}
+/** @endcond */
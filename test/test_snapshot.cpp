@@ -0,0 +1,391 @@
+/**
+ * @file test_snapshot.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Test binary snapshots
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "test_factory.h"
+#include <common/counter.h>
+#include <cstdio>
+#include <sketch/BlockedBloomFilter.h>
+#include <sketch/CHCMSketch.h>
+#include <sketch/CMSketch.h>
+#include <sketch/ConcurrentCMSketch.h>
+#include <sketch/CountingBloomFilter.h>
+#include <sketch/CuckooFilter.h>
+#include <sketch/FlowRadar.h>
+#include <sketch/HashPipe.h>
+#include <vector>
+
+#define LOOP_TIMES_SNAPSHOT 1000
+#define DEPTH_SNAPSHOT 4
+#define WIDTH_SNAPSHOT 1009
+#define KEYS_SNAPSHOT 100
+
+/**
+ * @cond TEST
+ * @brief Test sections and scopes of a snapshot
+ *
+ */
+void TestSection() {
+  using namespace OmniSketch::Sketch;
+
+  char name[L_tmpnam];
+  std::tmpnam(name);
+
+  std::vector<int32_t> vec(rand() % WIDTH_SNAPSHOT);
+  for (auto &v : vec) {
+    v = rand();
+  }
+  const double val = rand() / 3.0;
+  {
+    SnapshotWriter writer;
+    writer.put("val", val);
+    writer.putVector("vec", vec);
+    SnapshotWriter sub = writer.sub("sub");
+    sub.putBlob("blob", vec.data(), sizeof(int32_t) * vec.size());
+    try {
+      writer.put("val", val);
+      SET_FAILURE_FLAG;
+    } catch (const std::invalid_argument &exp) {
+      VERIFY_EXCEPTION(exp);
+    }
+    writer.write(name, "type");
+  }
+  SnapshotReader reader(name);
+  VERIFY(reader.type() == "type");
+  VERIFY(reader.get<double>("val") == val);
+  VERIFY(reader.getVector<int32_t>("vec") == vec);
+  VERIFY(reader.has("sub.blob") && !reader.has("blob"));
+  const int32_t *blob = reader.sub("sub").map<int32_t>("blob", vec.size());
+  VERIFY(reinterpret_cast<uintptr_t>(blob) % 64 == 0);
+  VERIFY(std::equal(vec.begin(), vec.end(), blob));
+  // missing or of a wrong size
+  try {
+    reader.get<double>("none");
+    SET_FAILURE_FLAG;
+  } catch (const std::invalid_argument &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+  try {
+    reader.get<int32_t>("val");
+    SET_FAILURE_FLAG;
+  } catch (const std::invalid_argument &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+  std::remove(name);
+  // not a snapshot at all
+  try {
+    SnapshotReader removed(name);
+    SET_FAILURE_FLAG;
+  } catch (const std::runtime_error &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+}
+
+/**
+ * @brief Test counters loaded in place against those saved
+ *
+ */
+template <typename counter_t> void TestCounterArray() {
+  using namespace OmniSketch::Sketch;
+
+  char name[L_tmpnam];
+  std::tmpnam(name);
+
+  CounterArray<int64_t, counter_t> counter(DEPTH_SNAPSHOT, WIDTH_SNAPSHOT,
+                                           true);
+  for (int i = 0; i < LOOP_TIMES_SNAPSHOT; ++i) {
+    // large enough for narrow counters to escalate
+    counter.add(rand() % DEPTH_SNAPSHOT, rand() % WIDTH_SNAPSHOT,
+                rand() % 100000);
+  }
+  {
+    SnapshotWriter writer;
+    counter.save(writer);
+    writer.write(name, "counter");
+  }
+  {
+    CounterArray<int64_t, counter_t> loaded(DEPTH_SNAPSHOT, WIDTH_SNAPSHOT,
+                                            SnapshotReader(name));
+    for (int32_t r = 0; r < DEPTH_SNAPSHOT; ++r) {
+      for (int32_t c = 0; c < WIDTH_SNAPSHOT; ++c) {
+        VERIFY(loaded.get(r, c) == counter.get(r, c));
+      }
+    }
+    // updated as usual, without writing through to the file
+    loaded.add(0, 0, 1);
+    VERIFY(loaded.get(0, 0) == counter.get(0, 0) + 1);
+  }
+  CounterArray<int64_t, counter_t> reloaded(DEPTH_SNAPSHOT, WIDTH_SNAPSHOT,
+                                            SnapshotReader(name));
+  VERIFY(reloaded.get(0, 0) == counter.get(0, 0));
+  std::remove(name);
+}
+
+/**
+ * @brief Test a sketch saved and loaded as a whole
+ *
+ */
+void TestSketch() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+  using CM = CMSketch<4, int64_t>;
+  using Other = CMSketch<4, int32_t>;
+  using OtherHash = CMSketch<4, int64_t, Hash::XXHash64>;
+
+  char name[L_tmpnam];
+  std::tmpnam(name);
+
+  CM sketch(DEPTH_SNAPSHOT, WIDTH_SNAPSHOT);
+  for (int i = 0; i < LOOP_TIMES_SNAPSHOT; ++i) {
+    sketch.update(FlowKey<4>(rand() % 100), rand() % 100);
+  }
+  // named the same by any compiler, even if saved through the base
+  const SketchBase<4, int64_t> &base = sketch;
+  SaveSnapshot(base, name);
+  VERIFY(SnapshotReader(name).type() ==
+         "CMSketch<4,int64_t,AwareHash,PrimeMod,int64_t>");
+  auto loaded = LoadSnapshot<CM>(name);
+  for (int i = 0; i < 100; ++i) {
+    VERIFY(loaded->query(FlowKey<4>(i)) == sketch.query(FlowKey<4>(i)));
+  }
+  // hashed identically, thus mergeable
+  loaded->merge(sketch);
+  VERIFY(loaded->query(FlowKey<4>(0)) == 2 * sketch.query(FlowKey<4>(0)));
+  // not of the type saved
+  try {
+    LoadSnapshot<Other>(name);
+    SET_FAILURE_FLAG;
+  } catch (const std::invalid_argument &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+  try {
+    LoadSnapshot<OtherHash>(name);
+    SET_FAILURE_FLAG;
+  } catch (const std::invalid_argument &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+  std::remove(name);
+}
+
+/**
+ * @brief Save a sketch and load it back
+ *
+ */
+template <typename sketch_t>
+std::unique_ptr<sketch_t> RoundTrip(const sketch_t &sketch) {
+  using namespace OmniSketch::Sketch;
+
+  char name[L_tmpnam];
+  std::tmpnam(name);
+  SaveSnapshot(sketch, name);
+  auto loaded = LoadSnapshot<sketch_t>(name);
+  // whatever is mapped outlives the file
+  std::remove(name);
+  return loaded;
+}
+
+/**
+ * @brief Test that a loaded sketch answers queries as the saved one does,
+ * both before and after the same updates
+ *
+ */
+template <typename sketch_t> void TestQueryRoundTrip(sketch_t &sketch) {
+  using namespace OmniSketch;
+
+  for (int i = 0; i < LOOP_TIMES_SNAPSHOT; ++i) {
+    sketch.update(FlowKey<4>(rand() % KEYS_SNAPSHOT), rand() % 1000);
+  }
+  auto loaded = RoundTrip(sketch);
+  for (int i = 0; i < KEYS_SNAPSHOT; ++i) {
+    VERIFY(loaded->query(FlowKey<4>(i)) == sketch.query(FlowKey<4>(i)));
+  }
+  for (int i = 0; i < LOOP_TIMES_SNAPSHOT; ++i) {
+    const FlowKey<4> flowkey(rand() % KEYS_SNAPSHOT);
+    const int64_t val = rand() % 1000;
+    sketch.update(flowkey, val);
+    loaded->update(flowkey, val);
+  }
+  for (int i = 0; i < KEYS_SNAPSHOT; ++i) {
+    VERIFY(loaded->query(FlowKey<4>(i)) == sketch.query(FlowKey<4>(i)));
+  }
+}
+
+/**
+ * @brief Test that a loaded filter looks up flowkeys as the saved one does,
+ * both before and after the same insertions
+ *
+ */
+template <typename sketch_t> void TestLookupRoundTrip(sketch_t &sketch) {
+  using namespace OmniSketch;
+
+  for (int i = 0; i < KEYS_SNAPSHOT; ++i) {
+    sketch.insert(FlowKey<4>(rand() % (2 * KEYS_SNAPSHOT)));
+  }
+  auto loaded = RoundTrip(sketch);
+  for (int i = 0; i < 2 * KEYS_SNAPSHOT; ++i) {
+    VERIFY(loaded->lookup(FlowKey<4>(i)) == sketch.lookup(FlowKey<4>(i)));
+  }
+  for (int i = 0; i < KEYS_SNAPSHOT; ++i) {
+    const FlowKey<4> flowkey(rand() % (2 * KEYS_SNAPSHOT));
+    sketch.insert(flowkey);
+    loaded->insert(flowkey);
+  }
+  for (int i = 0; i < 2 * KEYS_SNAPSHOT; ++i) {
+    VERIFY(loaded->lookup(FlowKey<4>(i)) == sketch.lookup(FlowKey<4>(i)));
+  }
+}
+
+/**
+ * @brief Test Blocked Bloom Filter
+ *
+ */
+void TestBlockedBloomFilter() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  // few enough blocks for lookups to differ
+  BlockedBloomFilter<4> bbf(KEYS_SNAPSHOT / 10, 4, Hash::SeedSequence(rand()));
+  TestLookupRoundTrip(bbf);
+}
+
+/**
+ * @brief Test Cuckoo Filter, saved when full with a fingerprint aside
+ *
+ */
+void TestCuckooFilter() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  CuckooFilter<4> cf(KEYS_SNAPSHOT, Hash::SeedSequence(rand()));
+  int32_t inserted = 0;
+  try {
+    for (; inserted < 8 * KEYS_SNAPSHOT; ++inserted) {
+      cf.insert(FlowKey<4>(inserted));
+    }
+    SET_FAILURE_FLAG;
+  } catch (const std::length_error &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+  auto loaded = RoundTrip(cf);
+  for (int i = 0; i < 8 * KEYS_SNAPSHOT; ++i) {
+    VERIFY(loaded->lookup(FlowKey<4>(i)) == cf.lookup(FlowKey<4>(i)));
+  }
+  // still full, since the fingerprint aside is loaded
+  try {
+    loaded->insert(FlowKey<4>(inserted));
+    SET_FAILURE_FLAG;
+  } catch (const std::length_error &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+  // and put back once room is made
+  for (int i = 0; i < inserted; i += 2) {
+    cf.remove(FlowKey<4>(i));
+    loaded->remove(FlowKey<4>(i));
+  }
+  for (int i = 0; i < 8 * KEYS_SNAPSHOT; ++i) {
+    VERIFY(loaded->lookup(FlowKey<4>(i)) == cf.lookup(FlowKey<4>(i)));
+  }
+  for (int i = 1; i < inserted; i += 2) {
+    VERIFY(loaded->lookup(FlowKey<4>(i)));
+  }
+}
+
+/**
+ * @brief Test sketches whose slots, CH or atomic counters are saved
+ *
+ */
+void TestCounterSketches() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  const Hash::SeedSequence seeds(rand());
+  HashPipe<4, int64_t> hp(DEPTH_SNAPSHOT, WIDTH_SNAPSHOT, seeds);
+  TestQueryRoundTrip(hp);
+  // counters large enough to overflow into upper layers of CH
+  CHCMSketch<4, 2, int64_t> chcm(DEPTH_SNAPSHOT, WIDTH_SNAPSHOT, 0.3, {10, 7},
+                                 {3}, seeds);
+  TestQueryRoundTrip(chcm);
+  ConcurrentCMSketch<4, int64_t> ccm(DEPTH_SNAPSHOT, WIDTH_SNAPSHOT, 0, 1024,
+                                     seeds);
+  TestQueryRoundTrip(ccm);
+}
+
+/**
+ * @brief Test Flow Radar, whose flow filter is a nested Bloom Filter
+ *
+ */
+void TestFlowRadar() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  FlowRadar<4, int64_t> fr(20 * WIDTH_SNAPSHOT, 5, 2 * WIDTH_SNAPSHOT, 3, false,
+                           Hash::SeedSequence(rand()));
+  for (int i = 0; i < LOOP_TIMES_SNAPSHOT; ++i) {
+    fr.update(FlowKey<4>(i % KEYS_SNAPSHOT), rand() % 1000);
+  }
+  auto loaded = RoundTrip(fr);
+  // a flow seen before is told apart from a new one by the flow filter
+  for (FlowKey<4> flowkey : {FlowKey<4>(0), FlowKey<4>(KEYS_SNAPSHOT)}) {
+    fr.update(flowkey, 1);
+    loaded->update(flowkey, 1);
+  }
+  const auto est = fr.decode(), loaded_est = loaded->decode();
+  VERIFY(est.size() == KEYS_SNAPSHOT + 1);
+  VERIFY(loaded_est.size() == est.size());
+  for (const auto &kv : est) {
+    VERIFY(loaded_est.count(kv.get_left()) &&
+           loaded_est.at(kv.get_left()) == kv.get_right());
+  }
+}
+
+/**
+ * @brief Test Counting Bloom Filter of counters in CH, or of packed 4-bit
+ * counters
+ *
+ */
+void TestCountingBloomFilter(bool packed) {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  CountingBloomFilter<4> cbf(WIDTH_SNAPSHOT, 3, 4, packed,
+                             Hash::SeedSequence(rand()));
+  for (int i = 0; i < LOOP_TIMES_SNAPSHOT; ++i) {
+    cbf.insert(FlowKey<4>(rand() % KEYS_SNAPSHOT));
+  }
+  auto loaded = RoundTrip(cbf);
+  for (int i = 0; i < 2 * KEYS_SNAPSHOT; ++i) {
+    VERIFY(loaded->lookup(FlowKey<4>(i)) == cbf.lookup(FlowKey<4>(i)));
+  }
+  for (int i = 0; i < KEYS_SNAPSHOT; i += 2) {
+    cbf.remove(FlowKey<4>(i));
+    loaded->remove(FlowKey<4>(i));
+  }
+  for (int i = 0; i < 2 * KEYS_SNAPSHOT; ++i) {
+    VERIFY(loaded->lookup(FlowKey<4>(i)) == cbf.lookup(FlowKey<4>(i)));
+  }
+}
+
+/**
+ * @brief Snapshot test
+ *
+ */
+OMNISKETCH_DECLARE_TEST(snapshot) {
+  for (int i = 0; i < g_repeat; ++i) {
+    TestSection();
+    TestCounterArray<int64_t>();
+    TestCounterArray<uint8_t>();
+    TestCounterArray<int16_t>();
+    TestSketch();
+    TestCounterSketches();
+    TestFlowRadar();
+    TestCountingBloomFilter(false);
+    TestCountingBloomFilter(true);
+    TestBlockedBloomFilter();
+    TestCuckooFilter();
+  }
+}
+/** @endcond */
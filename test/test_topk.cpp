@@ -0,0 +1,242 @@
+/**
+ * @file test_topk.cpp
+ * @author dromniscience (you@domain.com)
+ * @brief Test top-k tracker and heavy changers
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "test_factory.h"
+#include <algorithm>
+#include <common/topk.h>
+#include <map>
+#include <sketch/CMSketch.h>
+#include <sketch/HashPipe.h>
+
+#define LOOP_TIMES_TOPK 10000
+#define K_TOPK 16
+#define KEYS_TOPK 100
+#define DEPTH_TOPK 3
+#define WIDTH_TOPK 1009
+
+/**
+ * @cond TEST
+ * @brief Test tracked flowkeys against a brute force, in the cash register
+ * model
+ *
+ */
+void TestCashRegister() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  TopK<4, int64_t> topk(K_TOPK);
+  std::map<int32_t, int64_t> estimates;
+  for (int i = 0; i < LOOP_TIMES_TOPK; ++i) {
+    const int32_t key = rand() % KEYS_TOPK;
+    estimates[key] += rand() % 100;
+    topk.offer(FlowKey<4>(key), estimates[key]);
+  }
+  // offered estimates only grow, so the largest ones are all tracked
+  std::vector<int64_t> largest, tracked;
+  for (const auto &kv : estimates) {
+    largest.push_back(kv.second);
+  }
+  std::sort(largest.rbegin(), largest.rend());
+  largest.resize(K_TOPK);
+  for (const auto &entry : topk.entries()) {
+    VERIFY(entry.val == estimates[entry.flowkey.getIp()]);
+    tracked.push_back(entry.val);
+  }
+  std::sort(tracked.rbegin(), tracked.rend());
+  VERIFY(tracked == largest);
+}
+
+/**
+ * @brief Test invariants of the tracker, in the turnstile model
+ *
+ */
+void TestTurnstile() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  TopK<4, int64_t> topk(K_TOPK, true);
+  std::map<int32_t, int64_t> estimates;
+  for (int i = 0; i < LOOP_TIMES_TOPK; ++i) {
+    const int32_t key = rand() % KEYS_TOPK;
+    estimates[key] += rand() % 100 - 40;
+    topk.offer(FlowKey<4>(key), estimates[key]);
+  }
+  VERIFY(topk.entries().size() == K_TOPK);
+  std::vector<int32_t> keys;
+  for (const auto &entry : topk.entries()) {
+    keys.push_back(entry.flowkey.getIp());
+  }
+  std::sort(keys.begin(), keys.end());
+  VERIFY(std::unique(keys.begin(), keys.end()) == keys.end());
+  // tracked afresh
+  TopK<4, int64_t> other(K_TOPK);
+  topk.retrack(other, [&](const FlowKey<4> &flowkey) {
+    return estimates[flowkey.getIp()];
+  });
+  for (const auto &entry : topk.entries()) {
+    VERIFY(entry.val == estimates[entry.flowkey.getIp()]);
+  }
+  // disabled
+  TopK<4, int64_t> disabled;
+  disabled.offer(FlowKey<4>(0), 1);
+  VERIFY(!disabled.enabled() && disabled.entries().empty());
+  try {
+    TopK<4, int64_t> negative(-1);
+    SET_FAILURE_FLAG;
+  } catch (const std::out_of_range &exp) {
+    VERIFY_EXCEPTION(exp);
+  }
+}
+
+/**
+ * @brief Test a tracked flowkey whose estimate falls below the minimum
+ *
+ */
+void TestFallBelowMinimum() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  TopK<4, int64_t> topk(K_TOPK), other(K_TOPK, true);
+  for (int32_t key = 0; key < K_TOPK; ++key) {
+    topk.offer(FlowKey<4>(key), 100 + key);
+  }
+  // the cash register model turns down an offer below the minimum by a single
+  // comparison, tracked or not
+  topk.offer(FlowKey<4>(K_TOPK - 1), 10);
+  for (const auto &entry : topk.entries()) {
+    if (entry.flowkey.getIp() == K_TOPK - 1)
+      VERIFY(entry.val == 100 + K_TOPK - 1);
+  }
+  // estimates may fall once tracked afresh along with a tracker where they may
+  topk.retrack(other, [](const FlowKey<4> &flowkey) {
+    return 100 + flowkey.getIp();
+  });
+  // the largest one falls below all others, and is refreshed nonetheless
+  topk.offer(FlowKey<4>(K_TOPK - 1), 10);
+  bool refreshed = false;
+  for (const auto &entry : topk.entries()) {
+    if (entry.flowkey.getIp() == K_TOPK - 1)
+      refreshed = entry.val == 10;
+  }
+  VERIFY(refreshed);
+  // thus is the minimum, evicted by the next flowkey above it
+  topk.offer(FlowKey<4>(K_TOPK), 50);
+  for (const auto &entry : topk.entries()) {
+    VERIFY(entry.flowkey.getIp() != K_TOPK - 1);
+    if (entry.flowkey.getIp() == K_TOPK)
+      VERIFY(entry.val == 50);
+  }
+  // while an untracked one not above the minimum is still turned down
+  topk.offer(FlowKey<4>(K_TOPK + 1), 50);
+  for (const auto &entry : topk.entries()) {
+    VERIFY(entry.flowkey.getIp() != K_TOPK + 1);
+  }
+  VERIFY(topk.entries().size() == K_TOPK);
+}
+
+/**
+ * @brief Test heavy changers of sketches on unsigned counters, found in
+ * either direction of change
+ *
+ */
+void TestUnsignedHeavyChanger() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  const Hash::SeedSequence seeds(rand());
+  std::unique_ptr<SketchBase<13, uint32_t>> cm_before(
+      new CMSketch<13, uint32_t>(DEPTH_TOPK, WIDTH_TOPK, false, K_TOPK, seeds));
+  std::unique_ptr<SketchBase<13, uint32_t>> cm_after(
+      new CMSketch<13, uint32_t>(DEPTH_TOPK, WIDTH_TOPK, false, K_TOPK, seeds));
+  std::unique_ptr<SketchBase<13, uint32_t>> hp_before(
+      new HashPipe<13, uint32_t>(DEPTH_TOPK, WIDTH_TOPK, seeds));
+  std::unique_ptr<SketchBase<13, uint32_t>> hp_after(
+      new HashPipe<13, uint32_t>(DEPTH_TOPK, WIDTH_TOPK, seeds));
+  // one flowkey grows and another one shrinks
+  const FlowKey<13> growing(rand(), rand(), rand(), rand(), rand());
+  const FlowKey<13> shrinking(rand(), rand(), rand(), rand(), rand());
+  for (auto *ptr : {&cm_before, &hp_before}) {
+    (*ptr)->update(growing, 100);
+    (*ptr)->update(shrinking, 1000);
+  }
+  for (auto *ptr : {&cm_after, &hp_after}) {
+    (*ptr)->update(growing, 1000);
+    (*ptr)->update(shrinking, 100);
+  }
+  for (auto &[before, after] :
+       {std::tie(cm_before, cm_after), std::tie(hp_before, hp_after)}) {
+    const auto changers = after->getHeavyChanger(before, 500);
+    VERIFY(changers.size() == 2);
+    VERIFY(changers.count(growing) && changers.at(growing) >= 900);
+    VERIFY(changers.count(shrinking) && changers.at(shrinking) >= 900);
+  }
+}
+
+/**
+ * @brief Test that noise of opposite signs in the rows of CM cancels out in
+ * the change of a flowkey, being unsigned counters or not
+ * @details The flowkey stays the same, while another flowkey colliding with it
+ * only in the first row is removed and another one colliding with it only in
+ * the second row is added. Row differences are then -100, +100 and 0, whose
+ * absolute median is 0 though the median of absolute ones is 100.
+ *
+ */
+void TestNoisyRowChange() {
+  using namespace OmniSketch;
+  using namespace OmniSketch::Sketch;
+
+  const Hash::SeedSequence seeds(rand());
+  const auto hash_fns = seeds.makeVector<Hash::AwareHash>(DEPTH_TOPK);
+  const Hash::PrimeMod reduce(Hash::PrimeMod::adjust(WIDTH_TOPK));
+  auto index = [&](const FlowKey<13> &flowkey, int32_t row) {
+    return reduce(hash_fns[row](flowkey));
+  };
+  // a flowkey colliding with `steady` in `row` only
+  const FlowKey<13> steady(rand(), rand(), rand(), rand(), rand());
+  auto colliding = [&](int32_t row) {
+    while (true) {
+      const FlowKey<13> flowkey(rand(), rand(), rand(), rand(), rand());
+      bool only = true;
+      for (int32_t i = 0; i < DEPTH_TOPK; ++i) {
+        only &= (index(flowkey, i) == index(steady, i)) == (i == row);
+      }
+      if (only) {
+        return flowkey;
+      }
+    }
+  };
+  const FlowKey<13> removed = colliding(0), added = colliding(1);
+
+  std::unique_ptr<SketchBase<13, uint32_t>> before(
+      new CMSketch<13, uint32_t>(DEPTH_TOPK, WIDTH_TOPK, false, K_TOPK, seeds));
+  std::unique_ptr<SketchBase<13, uint32_t>> after(
+      new CMSketch<13, uint32_t>(DEPTH_TOPK, WIDTH_TOPK, false, K_TOPK, seeds));
+  before->update(steady, 1000);
+  before->update(removed, 100);
+  after->update(steady, 1000);
+  after->update(added, 100);
+  const auto changers = after->getHeavyChanger(before, 50);
+  VERIFY(!changers.count(steady));
+  VERIFY(changers.count(removed) && changers.at(removed) == 100);
+  VERIFY(changers.count(added) && changers.at(added) == 100);
+}
+
+/**
+ * @brief Top-k test
+ *
+ */
+OMNISKETCH_DECLARE_TEST(topk) {
+  for (int i = 0; i < g_repeat; ++i) {
+    TestCashRegister();
+    TestTurnstile();
+    TestFallBelowMinimum();
+    TestUnsignedHeavyChanger();
+    TestNoisyRowChange();
+  }
+}
+/** @endcond */